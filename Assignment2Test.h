@@ -6,7 +6,16 @@
 #include <string>
 #include <cstdlib>
 #include <sstream>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
 #include <utility>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 
 #include "PriorityQueue.h"
 
@@ -30,6 +39,45 @@ public:
 
 static Management management;
 
+/*
+ * Allocator that counts how many allocations it has made, used to check
+ * that reserved queues do not reallocate.
+ */
+template <typename T> struct CountingAllocator {
+
+  typedef T value_type;
+
+  static int allocations;
+
+  CountingAllocator(){}
+
+  template <typename U> CountingAllocator(const CountingAllocator<U>&){}
+
+  T* allocate(std::size_t n){
+
+    allocations++;
+    return std::allocator<T>().allocate(n);
+
+  }
+
+  void deallocate(T* p, std::size_t n){
+
+    std::allocator<T>().deallocate(p, n);
+
+  }
+
+  template <typename U> bool operator==(const CountingAllocator<U>&) const { return true; }
+  template <typename U> bool operator!=(const CountingAllocator<U>&) const { return false; }
+
+};
+
+template <typename T> int CountingAllocator<T>::allocations = 0;
+
+// Padded to a cache line, like the concurrent queues' per-thread records
+struct alignas(64) CacheLine {
+  int value = 7;
+};
+
 class Assignment2Tests : public CxxTest::TestSuite{
   
 private:
@@ -92,18 +140,17 @@ private:
   /*
    * Prints a priority queue for debugging purposes, or just to look at it.
    */
-  template <typename X> void print_priority_queue(PriorityQueue<X> pq){
-
-    typename std::vector<X> elements = pq.get_all_elements();
-    std::vector<int> priorities = pq.get_all_priorities();
+  template <typename X> void print_priority_queue(const PriorityQueue<X>& pq){
 
     std::cout << "\n[";
-    for (int i = 0; i < elements.size() - 1; i++){
+    const char* separator = "";
+    for (std::pair<int, const X&> entry : pq.entries()){
 
-      std::cout << "(" << priorities[i] << ", " << elements[i] << "), ";
+      std::cout << separator << "(" << entry.first << ", " << entry.second << ")";
+      separator = ", ";
 
     }
-    std::cout << "(" << priorities[elements.size()-1] << ", " << elements[elements.size()-1] << ")]" << std::endl;
+    std::cout << "]" << std::endl;
 
   }
 
@@ -755,4 +802,1455 @@ public:
 
   }
   
+  void testRemoveFrontInPriorityOrder(){
+
+    PriorityQueue<int> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%100, rand()%100);
+
+    }
+
+    int last = 0;
+
+    while (!pq.empty()){
+
+      int priority = pq.get_all_priorities()[0];
+      TS_ASSERT(last <= priority);
+      last = priority;
+      pq.remove_front();
+
+    }
+
+  }
+
+  void testInsertAllIsMinHeap(){
+
+    PriorityQueue<int> pq;
+
+    std::vector<std::pair<int, int> > pairs;
+
+    for (int i = 0; i < rand()%100 + 50; i++){
+
+      pairs.push_back(std::pair<int, int>(rand()%100, i));
+
+    }
+
+    pq.insert_all(pairs);
+
+    std::vector<int> outputPriorities = pq.get_all_priorities();
+
+    for (int i = 0; i < outputPriorities.size(); i++){
+
+      if (2*i + 1 < outputPriorities.size()) TS_ASSERT(outputPriorities[i] <= outputPriorities[2*i+1]);
+      if (2*i + 2 < outputPriorities.size()) TS_ASSERT(outputPriorities[i] <= outputPriorities[2*i+2]);
+
+    }
+
+  }
+
+  void testChangePriorityReordersFront(){
+
+    PriorityQueue<int> pq;
+
+    for (int i = 0; i < 100; i++){
+
+      pq.insert(i + 10, i);
+
+    }
+
+    pq.change_priority(50, 1);
+    TS_ASSERT_EQUALS(pq.peek(), 50);
+
+    pq.change_priority(50, 1000);
+    TS_ASSERT_EQUALS(pq.peek(), 0);
+
+  }
+  
+  void testHandleChangePriority(){
+
+    PriorityQueue<std::string> pq;
+
+    std::vector<PriorityQueue<std::string>::Handle> handles;
+
+    for (int i = 0; i < 50; i++){
+
+      handles.push_back(pq.insert(i + 10, "same"));
+
+    }
+
+    pq.change_priority(handles[30], 1);
+
+    TS_ASSERT_EQUALS(pq.get_priority(handles[30]), 1);
+    TS_ASSERT_EQUALS(pq.get_priority(handles[10]), 20);
+    TS_ASSERT_EQUALS(pq.get_priority("same"), 1);
+
+    pq.change_priority(handles[30], 100);
+
+    TS_ASSERT_EQUALS(pq.get_priority(handles[30]), 100);
+    TS_ASSERT_EQUALS(pq.get_priority("same"), 10);
+
+  }
+
+  void testHandleNoLongerContainedAfterRemoval(){
+
+    PriorityQueue<int> pq;
+
+    PriorityQueue<int>::Handle first = pq.insert(1, 7);
+    PriorityQueue<int>::Handle second = pq.insert(2, 7);
+
+    TS_ASSERT(pq.contains(first));
+    TS_ASSERT(pq.contains(second));
+
+    pq.remove_front();
+
+    TS_ASSERT(!pq.contains(first));
+    TS_ASSERT(pq.contains(second));
+    TS_ASSERT_EQUALS(pq.get_priority(first), -1);
+
+    // A reused slot must not revive the old handle
+    PriorityQueue<int>::Handle third = pq.insert(3, 7);
+
+    TS_ASSERT(!pq.contains(first));
+    TS_ASSERT(pq.contains(third));
+    TS_ASSERT(!pq.contains(pq.insert(-1, 7)));
+
+  }
+  
+  void testMoveOnlyPayload(){
+
+    PriorityQueue<std::unique_ptr<int> > pq;
+
+    pq.insert(5, std::unique_ptr<int>(new int(5)));
+    pq.emplace(1, new int(1));
+    pq.emplace(3, new int(3));
+
+    TS_ASSERT_EQUALS(*pq.peek(), 1);
+
+    std::unique_ptr<int> front = pq.pop();
+
+    TS_ASSERT_EQUALS(*front, 1);
+    TS_ASSERT_EQUALS(*pq.remove_front(), 3);
+    TS_ASSERT_EQUALS(pq.size(), 1);
+
+  }
+
+  void testInsertAllMovesAndRanges(){
+
+    std::vector<std::pair<int, std::string> > pairs;
+
+    for (int i = 0; i < 20; i++){
+
+      pairs.push_back(std::pair<int, std::string>(20 - i, randomString(30)));
+
+    }
+
+    std::string smallest = pairs.back().second;
+
+    PriorityQueue<std::string> pq;
+
+    pq.insert_all(pairs.begin(), pairs.begin() + 10);
+    TS_ASSERT_EQUALS(pq.size(), 10);
+
+    std::vector<std::pair<int, std::string> > rest(pairs.begin() + 10, pairs.end());
+    pq.insert_all(std::move(rest));
+
+    TS_ASSERT_EQUALS(pq.size(), 20);
+    TS_ASSERT_EQUALS(pq.peek(), smallest);
+
+  }
+
+  void testInsertAllSmallBatchIntoLargeHeap(){
+
+    typedef PriorityQueue<int, 2, int, std::less<int>, false, std::allocator<int>, CountingInstrumentation> Counted;
+    Counted pq;
+
+    std::vector<std::pair<int, int> > bulk;
+    for (int i = 0; i < 100000; i++){
+
+      bulk.push_back(std::make_pair(rand()%1000000, i));
+
+    }
+    pq.insert_all(bulk);
+
+    // A handful more is sifted up one node at a time, not rebuilt
+    std::uint64_t before = pq.stats().sifts;
+    std::vector<std::pair<int, int> > few;
+    for (int i = 0; i < 10; i++){
+
+      few.push_back(std::make_pair(rand()%1000000, 100000 + i));
+
+    }
+    pq.insert_all(few);
+    TS_ASSERT_EQUALS(pq.stats().sifts - before, 10);
+    TS_ASSERT_EQUALS(pq.size(), 100010);
+
+    // The parallel path makes the same choice, for a batch big enough to
+    // be split between two threads
+    PriorityQueue<int> parallel;
+    std::vector<std::pair<int, int> > doubled(bulk);
+    doubled.insert(doubled.end(), bulk.begin(), bulk.end());
+    parallel.insert_all(doubled, 4);
+    std::vector<std::pair<int, int> > batch;
+    for (int i = 0; i < 8192; i++){
+
+      batch.push_back(std::make_pair(rand()%1000000, 200000 + i));
+
+    }
+    parallel.insert_all(batch, 4);
+    TS_ASSERT_EQUALS(parallel.size(), 208192);
+
+    int last = -1;
+    while (!pq.empty()){
+
+      TS_ASSERT(last <= pq.peek_priority());
+      last = pq.peek_priority();
+      pq.pop();
+
+    }
+
+    last = -1;
+    while (!parallel.empty()){
+
+      TS_ASSERT(last <= parallel.peek_priority());
+      last = parallel.peek_priority();
+      parallel.pop();
+
+    }
+
+  }
+  
+  void testIsMinHeapFourAry(){
+
+    PriorityQueue<int, 4> pq;
+
+    for (int i = 0; i < rand()%100 + 50; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    std::vector<int> outputPriorities = pq.get_all_priorities();
+
+    for (int i = 1; i < outputPriorities.size(); i++){
+
+      TS_ASSERT(outputPriorities[(i - 1) / 4] <= outputPriorities[i]);
+
+    }
+
+  }
+
+  void testRemoveFrontInPriorityOrderEightAry(){
+
+    PriorityQueue<int, 8> pq;
+
+    std::vector<std::pair<int, int> > pairs;
+
+    for (int i = 0; i < 500; i++){
+
+      pairs.push_back(std::pair<int, int>(rand()%100, i));
+
+    }
+
+    pq.insert_all(pairs);
+
+    for (int i = 0; i < 500; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    int last = 0;
+
+    while (!pq.empty()){
+
+      int priority = pq.get_all_priorities()[0];
+      TS_ASSERT(last <= priority);
+      last = priority;
+      pq.remove_front();
+
+    }
+
+  }
+  
+  void testHandlesSurviveRemovals(){
+
+    PriorityQueue<std::string> pq;
+
+    std::vector<PriorityQueue<std::string>::Handle> handles;
+    std::vector<std::string> elements;
+
+    for (int i = 0; i < 100; i++){
+
+      elements.push_back(randomString(10) + std::to_string(i));
+      handles.push_back(pq.insert((i * 37) % 100, elements[i]));
+
+    }
+
+    for (int i = 0; i < 50; i++){
+
+      pq.remove_front();
+
+    }
+
+    for (int i = 0; i < 100; i++){
+
+      int priority = (i * 37) % 100;
+
+      TS_ASSERT_EQUALS(pq.contains(handles[i]), priority >= 50);
+      TS_ASSERT_EQUALS(pq.contains(elements[i]), priority >= 50);
+
+      if (priority >= 50){
+	TS_ASSERT_EQUALS(pq.get_priority(handles[i]), priority);
+      }
+
+    }
+
+  }
+  
+  void testRemoveFrontInPriorityOrderSixteenAry(){
+
+    PriorityQueue<int, 16> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%50, i);
+
+    }
+
+    for (int i = 0; i < 100; i++){
+
+      pq.change_priority(rand()%1000, rand()%50);
+
+    }
+
+    int last = 0;
+
+    while (!pq.empty()){
+
+      int priority = pq.get_all_priorities()[0];
+      TS_ASSERT(last <= priority);
+      last = priority;
+      pq.remove_front();
+
+    }
+
+  }
+  
+  void testLongPriorities(){
+
+    PriorityQueue<std::string, 2, long long> pq;
+
+    long long base = 1LL << 40;
+
+    pq.insert(base + 2, "later");
+    pq.insert(base + 1, "sooner");
+    pq.insert(-1, "rejected");
+
+    TS_ASSERT_EQUALS(pq.size(), 2);
+    TS_ASSERT_EQUALS(pq.peek(), "sooner");
+    TS_ASSERT_EQUALS(pq.get_priority("later"), base + 2);
+    TS_ASSERT_EQUALS(pq.get_priority("rejected"), -1);
+
+  }
+
+  void testDoublePrioritiesRejectNaN(){
+
+    PriorityQueue<int, 4, double> pq;
+
+    pq.insert(0.5, 1);
+    pq.insert(0.25, 2);
+    pq.insert(0.0 / 0.0, 3);
+
+    TS_ASSERT_EQUALS(pq.size(), 2);
+    TS_ASSERT_EQUALS(pq.remove_front(), 2);
+    TS_ASSERT_EQUALS(pq.remove_front(), 1);
+
+  }
+
+  void testGreaterComparatorIsMaxHeap(){
+
+    PriorityQueue<int, 2, int, std::greater<int> > pq;
+
+    for (int i = 0; i < 100; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    int last = 100;
+
+    while (!pq.empty()){
+
+      int priority = pq.get_all_priorities()[0];
+      TS_ASSERT(priority <= last);
+      last = priority;
+      pq.remove_front();
+
+    }
+
+  }
+
+  void testPriorityTraitsFollowTheOrder(){
+
+    // Under std::greater negatives are legal, and nothing is set aside
+    PriorityQueue<int, 2, int, std::greater<int> > greater;
+    TS_ASSERT(greater.contains(greater.insert(-5, 1)));
+    greater.insert(3, 2);
+    TS_ASSERT_EQUALS(greater.peek_priority(), 3);
+    TS_ASSERT_EQUALS(greater.get_priority(9), 0);
+    TS_ASSERT(!greater.contains(9));
+
+    PriorityQueue<int, 2, double, std::greater<double> > doubles;
+    TS_ASSERT(doubles.contains(doubles.insert(-0.5, 1)));
+    TS_ASSERT(!doubles.contains(doubles.insert(std::numeric_limits<double>::quiet_NaN(), 2)));
+
+    // Unsigned priorities set their largest value aside as the sentinel
+    PriorityQueue<int, 2, unsigned> unsigneds;
+    TS_ASSERT(unsigneds.contains(unsigneds.insert(0, 1)));
+    TS_ASSERT(!unsigneds.contains(unsigneds.insert(std::numeric_limits<unsigned>::max(), 2)));
+    TS_ASSERT_EQUALS(unsigneds.size(), 1);
+    TS_ASSERT_EQUALS(unsigneds.get_priority(2), std::numeric_limits<unsigned>::max());
+
+  }
+
+  void testCompositePriorities(){
+
+    // (deadline, tiebreak) keys as used for EDF scheduling
+    PriorityQueue<std::string, 2, std::pair<long, int> > pq;
+
+    pq.insert(std::make_pair(20L, 1), "b");
+    pq.insert(std::make_pair(10L, 2), "a2");
+    pq.insert(std::make_pair(10L, 1), "a1");
+
+    TS_ASSERT_EQUALS(pq.remove_front(), "a1");
+    TS_ASSERT_EQUALS(pq.remove_front(), "a2");
+    TS_ASSERT_EQUALS(pq.get_priority("b"), std::make_pair(20L, 1));
+    TS_ASSERT_EQUALS(pq.get_priority("missing"), std::make_pair(0L, 0));
+
+  }
+
+  void testStableKeepsInsertionOrder(){
+
+    PriorityQueue<int, 4, int, std::less<int>, true> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%5, i);
+
+    }
+
+    std::vector<int> last(5, -1);
+
+    while (!pq.empty()){
+
+      int priority = pq.get_all_priorities()[0];
+      int element = pq.remove_front();
+      TS_ASSERT(last[priority] < element);
+      last[priority] = element;
+
+    }
+
+  }
+
+  void testStableWithCustomPriorities(){
+
+    PriorityQueue<std::string, 2, double, std::less<double>, true> pq;
+
+    std::vector<std::pair<double, std::string> > pairs;
+
+    for (int i = 0; i < 10; i++){
+
+      pairs.push_back(std::pair<double, std::string>(0.5, std::to_string(i)));
+
+    }
+
+    pq.insert_all(pairs);
+    pq.insert(0.5, "last");
+    pq.change_priority("3", 0.5);
+
+    for (int i = 0; i < 10; i++){
+
+      if (i != 3){
+	TS_ASSERT_EQUALS(pq.remove_front(), std::to_string(i));
+      }
+
+    }
+
+    TS_ASSERT_EQUALS(pq.remove_front(), "last");
+    TS_ASSERT_EQUALS(pq.remove_front(), "3");
+
+  }
+  
+  void testReserveAvoidsReallocation(){
+
+    typedef PriorityQueue<int, 2, int, std::less<int>, false, CountingAllocator<int> > CountingQueue;
+
+    CountingQueue pq;
+
+    pq.reserve(1000);
+
+    TS_ASSERT(pq.capacity() >= 1000);
+
+    int before = CountingAllocator<int>::allocations;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    TS_ASSERT_EQUALS(CountingAllocator<int>::allocations, before);
+
+    for (int i = 0; i < 990; i++){
+
+      pq.remove_front();
+
+    }
+
+    pq.shrink_to_fit();
+
+    TS_ASSERT(pq.capacity() < 1000);
+    TS_ASSERT_EQUALS(pq.size(), 10);
+
+  }
+
+  void testElementsShareTheArena(){
+
+#if __cplusplus >= 201703L
+    char buffer[1 << 16];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    typedef std::pmr::polymorphic_allocator<std::pmr::string> ArenaAllocator;
+    PriorityQueue<std::pmr::string, 2, int, std::less<int>, false, ArenaAllocator> pq((ArenaAllocator(&arena)));
+
+    pq.reserve(16);
+
+    for (int i = 0; i < 16; i++){
+
+      pq.emplace(16 - i, "a string too long for the small string buffer " + std::to_string(i));
+
+    }
+
+    TS_ASSERT_EQUALS(pq.peek().get_allocator().resource(), &arena);
+    TS_ASSERT_EQUALS(pq.remove_front(), "a string too long for the small string buffer 15");
+#endif
+
+  }
+  
+  void testPopNInPriorityOrder(){
+
+    for (int count = 1; count <= 300; count *= 3){
+
+      PriorityQueue<std::string> pq;
+
+      std::vector<PriorityQueue<std::string>::Handle> handles;
+      std::vector<int> priorityOf;
+
+      for (int i = 0; i < 200; i++){
+
+	priorityOf.push_back(rand()%100);
+	handles.push_back(pq.insert(priorityOf[i], std::to_string(i)));
+
+      }
+
+      std::vector<int> priorities = pq.get_all_priorities();
+      std::sort(priorities.begin(), priorities.end());
+
+      std::vector<std::string> output;
+      pq.pop_n(count, std::back_inserter(output));
+
+      int popped = std::min(count, 200);
+
+      TS_ASSERT_EQUALS(output.size(), popped);
+      TS_ASSERT_EQUALS(pq.size(), 200 - popped);
+
+      for (int i = 0; i < output.size(); i++){
+
+	TS_ASSERT_EQUALS(priorityOf[std::stoi(output[i])], priorities[i]);
+	TS_ASSERT(!pq.contains(output[i]));
+
+      }
+
+      // The rest must still be a valid heap, reachable through their handles
+      int last = popped > 0 ? priorities[popped - 1] : 0;
+
+      for (int i = 0; i < handles.size(); i++){
+
+	if (pq.contains(handles[i])){
+	  TS_ASSERT(last <= pq.get_priority(handles[i]));
+	}
+
+      }
+
+      while (!pq.empty()){
+
+	int priority = pq.get_all_priorities()[0];
+	TS_ASSERT(last <= priority);
+	last = priority;
+	pq.remove_front();
+
+      }
+
+    }
+
+  }
+
+  void testPopNWithPriorities(){
+
+    // Both the pop-by-pop path and the select-and-rebuild path
+    const int sizes[] = { 200, 300000 };
+    for (int s = 0; s < 2; s++){
+
+      PriorityQueue<int> pq;
+      std::vector<int> priorityOf;
+
+      for (int i = 0; i < sizes[s]; i++){
+
+	priorityOf.push_back(rand()%1000000);
+	pq.insert(priorityOf[i], i);
+
+      }
+
+      std::vector<int> output;
+      std::vector<int> priorities;
+      pq.pop_n(sizes[s] / 3, std::back_inserter(output), std::back_inserter(priorities));
+
+      TS_ASSERT_EQUALS(output.size(), sizes[s] / 3);
+      TS_ASSERT_EQUALS(priorities.size(), output.size());
+
+      for (int i = 0; i < output.size(); i++){
+
+	TS_ASSERT_EQUALS(priorities[i], priorityOf[output[i]]);
+	if (i > 0) TS_ASSERT(priorities[i - 1] <= priorities[i]);
+
+      }
+      TS_ASSERT(priorities.back() <= pq.peek_priority());
+
+    }
+
+  }
+
+  void testDrainIntoStable(){
+
+    StablePriorityQueue<int> pq;
+
+    for (int i = 0; i < 100; i++){
+
+      pq.insert(i % 3, i);
+
+    }
+
+    std::vector<int> output;
+    pq.drain_into(output);
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(output.size(), 100);
+
+    for (int i = 1; i < output.size(); i++){
+
+      TS_ASSERT(output[i - 1] % 3 < output[i] % 3 || (output[i - 1] % 3 == output[i] % 3 && output[i - 1] < output[i]));
+
+    }
+
+  }
+  
+  void testPopNLargeBatch(){
+
+    // Big enough for pop_n to select and rebuild instead of popping
+    PriorityQueue<int> pq;
+
+    std::vector<PriorityQueue<int>::Handle> handles;
+    std::vector<int> priorityOf;
+
+    for (int i = 0; i < 300000; i++){
+
+      priorityOf.push_back(rand()%1000000);
+      handles.push_back(pq.insert(priorityOf[i], i));
+
+    }
+
+    std::vector<int> output;
+    pq.pop_n(100000, std::back_inserter(output));
+
+    TS_ASSERT_EQUALS(output.size(), 100000);
+    TS_ASSERT_EQUALS(pq.size(), 200000);
+
+    std::vector<bool> taken(300000, false);
+
+    for (int i = 0; i < output.size(); i++){
+
+      if (i > 0) TS_ASSERT(priorityOf[output[i - 1]] <= priorityOf[output[i]]);
+      taken[output[i]] = true;
+
+    }
+
+    for (int i = 0; i < handles.size(); i++){
+
+      TS_ASSERT_EQUALS(pq.contains(handles[i]), !taken[i]);
+
+    }
+
+    std::vector<int> rest;
+    pq.drain_into(rest);
+
+    TS_ASSERT_EQUALS(rest.size(), 200000);
+    TS_ASSERT(priorityOf[output.back()] <= priorityOf[rest[0]]);
+
+    for (int i = 1; i < rest.size(); i++){
+
+      TS_ASSERT(priorityOf[rest[i - 1]] <= priorityOf[rest[i]]);
+
+    }
+
+  }
+  
+  void testErase(){
+
+    PriorityQueue<std::string> pq;
+
+    PriorityQueue<std::string>::Handle a = pq.insert(5, "a");
+    PriorityQueue<std::string>::Handle b = pq.insert(3, "b");
+    pq.insert(8, "c");
+    pq.insert(1, "d");
+    pq.insert(9, "b");
+
+    TS_ASSERT(pq.erase(a));
+    TS_ASSERT(!pq.erase(a));
+    TS_ASSERT(!pq.contains(a));
+
+    // Only the lowest priority match goes
+    TS_ASSERT(pq.erase("b"));
+    TS_ASSERT(!pq.contains(b));
+    TS_ASSERT(pq.contains("b"));
+    TS_ASSERT_EQUALS(pq.get_priority("b"), 9);
+    TS_ASSERT(!pq.erase("z"));
+
+    TS_ASSERT_EQUALS(pq.size(), 3);
+    TS_ASSERT_EQUALS(pq.remove_front(), "d");
+    TS_ASSERT_EQUALS(pq.remove_front(), "c");
+    TS_ASSERT_EQUALS(pq.remove_front(), "b");
+
+  }
+
+  void testEraseAllAndEraseIf(){
+
+    for (int size = 100; size <= 10000; size *= 100){
+
+      PriorityQueue<int> pq;
+      std::vector<PriorityQueue<int>::Handle> handles;
+      std::vector<int> priorityOf;
+
+      // Priorities start at 1, so 0 below is only ever element 3's
+      for (int i = 0; i < size; i++){
+
+	priorityOf.push_back(1 + rand()%1000);
+	handles.push_back(pq.insert(priorityOf[i], i));
+
+      }
+
+      // A small batch is erased one by one, a large one with a rebuild
+      std::vector<PriorityQueue<int>::Handle> few(handles.begin(), handles.begin() + 3);
+      TS_ASSERT_EQUALS(pq.erase_all(few.begin(), few.end()), 3);
+      TS_ASSERT_EQUALS(pq.erase_all(few.begin(), few.end()), 0);
+
+      std::vector<PriorityQueue<int>::Handle> many;
+      for (int i = 0; i < size; i += 2){
+	many.push_back(handles[i]);
+      }
+      TS_ASSERT_EQUALS(pq.erase_all(many.begin(), many.end()), size / 2 - 2);
+
+      TS_ASSERT_EQUALS(pq.erase_if([](int element){ return element % 4 == 1; }), size / 4 - 1);
+      TS_ASSERT_EQUALS(pq.size(), size / 4);
+
+      for (int i = 0; i < handles.size(); i++){
+
+	TS_ASSERT_EQUALS(pq.contains(handles[i]), i % 4 == 3);
+
+      }
+
+      pq.change_priority(handles[3], 0);
+      TS_ASSERT_EQUALS(pq.peek(), 3);
+
+      int last = -1;
+      while (!pq.empty()){
+
+	int element = pq.pop();
+	int priority = element == 3 ? 0 : priorityOf[element];
+	TS_ASSERT_EQUALS(element % 4, 3);
+	TS_ASSERT(last <= priority);
+	last = priority;
+
+      }
+
+    }
+
+  }
+
+  void testLazyErase(){
+
+    PriorityQueue<std::string> pq;
+    pq.set_lazy_erase(true);
+    pq.set_compaction_ratio(0.9);
+    TS_ASSERT(pq.lazy_erase());
+
+    PriorityQueue<std::string>::Handle a = pq.insert(1, "a");
+    PriorityQueue<std::string>::Handle b = pq.insert(4, "b");
+    pq.insert(6, "c");
+    pq.insert(2, "d");
+    pq.insert(9, "e");
+
+    // An erased element is gone at once, but its node stays behind
+    TS_ASSERT(pq.erase(b));
+    TS_ASSERT(!pq.erase(b));
+    TS_ASSERT(!pq.contains(b));
+    TS_ASSERT(!pq.contains("b"));
+    TS_ASSERT_EQUALS(pq.get_priority("b"), -1);
+    TS_ASSERT_EQUALS(pq.size(), 4);
+    TS_ASSERT_EQUALS(pq.physical_size(), 5);
+    TS_ASSERT_EQUALS(pq.tombstone_count(), 1);
+    TS_ASSERT_EQUALS(pq.get_all_elements().size(), 4);
+    TS_ASSERT_EQUALS(pq.get_all_priorities().size(), 4);
+
+    // A tombstone at the front is dropped straight away
+    TS_ASSERT(pq.erase(a));
+    TS_ASSERT_EQUALS(pq.peek(), "d");
+    TS_ASSERT_EQUALS(pq.physical_size(), 4);
+
+    TS_ASSERT(pq.erase("c"));
+    TS_ASSERT_EQUALS(pq.remove_front(), "d");
+    TS_ASSERT_EQUALS(pq.remove_front(), "e");
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.physical_size(), 0);
+
+    // Turning lazy mode off compacts what is left
+    pq.insert(3, "f");
+    pq.insert(1, "g");
+    pq.insert(2, "h");
+    pq.erase("f");
+    TS_ASSERT_EQUALS(pq.tombstone_count(), 1);
+    pq.set_lazy_erase(false);
+    TS_ASSERT_EQUALS(pq.tombstone_count(), 0);
+    TS_ASSERT_EQUALS(pq.physical_size(), 2);
+
+  }
+
+  void testLazyEraseCompaction(){
+
+    PriorityQueue<int> pq;
+    pq.set_lazy_erase(true);
+    pq.set_compaction_ratio(0.25);
+
+    std::vector<PriorityQueue<int>::Handle> handles;
+    std::vector<int> priorityOf;
+    for (int i = 0; i < 2000; i++){
+
+      priorityOf.push_back(1 + rand()%500);
+      handles.push_back(pq.insert(priorityOf[i], i));
+
+    }
+
+    // Tombstones never pass the ratio
+    for (int i = 0; i < 2000; i += 3){
+
+      TS_ASSERT(pq.erase(handles[i]));
+      TS_ASSERT(pq.tombstone_count() <= 0.25 * pq.physical_size());
+
+    }
+    TS_ASSERT_EQUALS(pq.size(), 2000 - 667);
+    TS_ASSERT_EQUALS(pq.erase_if([](int element){ return element % 3 == 1; }), 667);
+    TS_ASSERT_EQUALS(pq.size(), 666);
+    TS_ASSERT_EQUALS(pq.physical_size() - pq.tombstone_count(), 666);
+
+    // Handles of live elements still work across compactions
+    pq.change_priority(handles[2], 0);
+    TS_ASSERT_EQUALS(pq.peek(), 2);
+    TS_ASSERT_EQUALS(pq.get_priority(handles[5]), priorityOf[5]);
+
+    int last = -1;
+    int count = 0;
+    while (!pq.empty()){
+
+      int element = pq.pop();
+      int priority = element == 2 ? 0 : priorityOf[element];
+      TS_ASSERT_EQUALS(element % 3, 2);
+      TS_ASSERT(last <= priority);
+      last = priority;
+      count++;
+
+    }
+    TS_ASSERT_EQUALS(count, 666);
+    TS_ASSERT_EQUALS(pq.physical_size(), 0);
+
+  }
+
+  void testViews(){
+
+    PriorityQueue<std::string> pq;
+    pq.set_lazy_erase(true);
+    pq.insert(5, "a");
+    pq.insert(3, "b");
+    PriorityQueue<std::string>::Handle c = pq.insert(8, "c");
+    pq.insert(1, "d");
+    pq.insert(9, "e");
+    pq.erase(c);
+
+    // Views read the queue's own storage, in the order of the vector copies
+    PriorityQueue<std::string>::ElementsView elements = pq.elements_view();
+    TS_ASSERT_EQUALS(elements.size(), 4);
+    TS_ASSERT_EQUALS(&*elements.begin(), &pq.peek());
+    TS_ASSERT(std::vector<std::string>(elements.begin(), elements.end()) == pq.get_all_elements());
+
+    PriorityQueue<std::string>::PrioritiesView priorities = pq.priorities_view();
+    TS_ASSERT(std::vector<int>(priorities.begin(), priorities.end()) == pq.get_all_priorities());
+
+    int count = 0;
+    for (std::pair<int, const std::string&> entry : pq.entries()){
+
+      TS_ASSERT_EQUALS(entry.first, pq.get_priority(entry.second));
+      TS_ASSERT(entry.second != "c");
+      count++;
+
+    }
+    TS_ASSERT_EQUALS(count, 4);
+
+    PriorityQueue<std::string> none;
+    TS_ASSERT(none.entries().empty());
+    TS_ASSERT(none.elements_view().begin() == none.elements_view().end());
+
+  }
+
+  void testTopK(){
+
+    PriorityQueue<int, 4> pq;
+    pq.set_lazy_erase(true);
+    std::vector<PriorityQueue<int, 4>::Handle> handles;
+    for (int i = 0; i < 1000; i++){
+
+      handles.push_back(pq.insert(rand()%300, i));
+
+    }
+    for (int i = 0; i < 1000; i += 7){
+
+      pq.erase(handles[i]);
+
+    }
+
+    // A copy popped in full gives the order to expect
+    PriorityQueue<int, 4> copy = pq;
+    std::vector<int> expected;
+    copy.drain_into(expected);
+
+    std::vector<int> best;
+    pq.top_k(10, std::back_inserter(best));
+    TS_ASSERT_EQUALS(best.size(), 10);
+    for (int i = 0; i < 10; i++){
+
+      TS_ASSERT_EQUALS(pq.get_priority(handles[best[i]]), pq.get_priority(handles[expected[i]]));
+
+    }
+
+    // The queue is left as it was
+    TS_ASSERT_EQUALS(pq.size(), expected.size());
+    TS_ASSERT_EQUALS(pq.peek(), best[0]);
+
+    std::vector<int> all;
+    pq.top_k(5000, std::back_inserter(all));
+    TS_ASSERT_EQUALS(all.size(), expected.size());
+    TS_ASSERT_EQUALS(pq.top_k(0, all.begin()), all.begin());
+
+  }
+
+  void testSortedIterator(){
+
+    StablePriorityQueue<std::string> pq;
+    pq.insert(2, "a");
+    pq.insert(1, "b");
+    pq.insert(2, "c");
+    pq.insert(0, "d");
+    pq.insert(2, "e");
+
+    std::vector<std::string> walked(pq.sorted_begin(), pq.sorted_end());
+    std::vector<std::string> expected = {"d", "b", "a", "c", "e"};
+    TS_ASSERT(walked == expected);
+
+    StablePriorityQueue<std::string>::SortedIterator it = pq.sorted_begin();
+    TS_ASSERT_EQUALS(it.priority(), 0);
+    ++it;
+    TS_ASSERT_EQUALS(*it, "b");
+    TS_ASSERT_EQUALS(it->size(), 1);
+    TS_ASSERT_EQUALS(pq.size(), 5);
+
+    StablePriorityQueue<std::string> none;
+    TS_ASSERT(none.sorted_begin() == none.sorted_end());
+
+  }
+
+  void testInstrumentation(){
+
+    typedef PriorityQueue<int, 2, int, std::less<int>, false, std::allocator<int>, CountingInstrumentation> Counted;
+    Counted pq;
+
+    std::vector<Counted::Handle> handles;
+    for (int i = 0; i < 100; i++){
+
+      handles.push_back(pq.insert(100 - i, i));
+
+    }
+    pq.change_priority(handles[0], 0);
+    pq.erase(handles[1]);
+    TS_ASSERT(pq.contains(50));
+    TS_ASSERT(!pq.contains(1000));
+    pq.pop();
+    pq.remove_front();
+
+    PriorityQueueStats stats = pq.stats();
+    TS_ASSERT_EQUALS(stats.latencies[PriorityQueueStats::INSERT].count(), 100);
+    TS_ASSERT_EQUALS(stats.latencies[PriorityQueueStats::POP].count(), 2);
+    TS_ASSERT_EQUALS(stats.latencies[PriorityQueueStats::CHANGE_PRIORITY].count(), 1);
+    TS_ASSERT_EQUALS(stats.latencies[PriorityQueueStats::ERASE].count(), 1);
+
+    // Every insert sifts up past each parent, since priorities only fall
+    TS_ASSERT(stats.sifts >= 100);
+    TS_ASSERT(stats.comparisons >= stats.moves);
+    TS_ASSERT(stats.moves > 0);
+    TS_ASSERT(stats.reallocations > 0);
+    TS_ASSERT_EQUALS(stats.scans, 2);
+    TS_ASSERT(stats.scanned > 100);
+
+    const LatencyHistogram& inserts = stats.latencies[PriorityQueueStats::INSERT];
+    TS_ASSERT(inserts.percentile(50) <= inserts.percentile(99));
+    TS_ASSERT(inserts.percentile(100) <= inserts.max());
+
+    // Without a policy nothing is counted
+    PriorityQueue<int> plain;
+    plain.insert(1, 1);
+    TS_ASSERT_EQUALS(plain.stats().sifts, 0);
+    TS_ASSERT_EQUALS(plain.stats().latencies[PriorityQueueStats::INSERT].count(), 0);
+
+  }
+
+  void testLatencyHistogram(){
+
+    LatencyHistogram histogram;
+    TS_ASSERT_EQUALS(histogram.percentile(50), 0);
+
+    for (int i = 1; i <= 1000; i++){
+
+      histogram.record(i);
+
+    }
+    TS_ASSERT_EQUALS(histogram.count(), 1000);
+    TS_ASSERT_EQUALS(histogram.max(), 1000);
+
+    // Buckets are within an eighth of the value
+    TS_ASSERT(histogram.percentile(50) >= 500);
+    TS_ASSERT(histogram.percentile(50) <= 500 + 500 / 8);
+    TS_ASSERT_EQUALS(histogram.percentile(1), 10);
+    TS_ASSERT_EQUALS(histogram.percentile(100), 1000);
+
+    histogram.record(UINT64_MAX);
+    TS_ASSERT_EQUALS(histogram.max(), UINT64_MAX);
+    TS_ASSERT_EQUALS(LatencyHistogram::bucket_limit(LatencyHistogram::BUCKETS - 1), UINT64_MAX);
+
+  }
+
+  void testSaveAndLoad(){
+
+    StablePriorityQueue<std::string> pq;
+    pq.set_lazy_erase(true);
+    StablePriorityQueue<std::string>::Handle gone = pq.insert(4, "gone");
+    for (int i = 0; i < 50; i++){
+
+      pq.insert(i % 5, "element " + std::to_string(i));
+
+    }
+    pq.erase(gone);
+
+    std::stringstream snapshot;
+    pq.save(snapshot);
+
+    StablePriorityQueue<std::string> loaded;
+    StablePriorityQueue<std::string>::Handle old = loaded.insert(1, "old");
+    TS_ASSERT(loaded.load(snapshot));
+    TS_ASSERT(!loaded.contains(old));
+    TS_ASSERT(!loaded.contains("gone"));
+    TS_ASSERT_EQUALS(loaded.size(), 50);
+
+    // Equal priorities still come out first in, first out
+    std::vector<std::string> expected;
+    std::vector<std::string> actual;
+    pq.drain_into(expected);
+    loaded.drain_into(actual);
+    TS_ASSERT(actual == expected);
+
+    // New elements go behind the loaded ones with the same priority
+    snapshot.clear();
+    snapshot.seekg(0);
+    TS_ASSERT(loaded.load(snapshot));
+    loaded.insert(0, "new");
+    TS_ASSERT_EQUALS(loaded.get_all_elements().size(), 51);
+    int zeroes = 0;
+    while (loaded.peek_priority() == 0){
+
+      std::string element = loaded.pop();
+      zeroes++;
+      if (zeroes == 11) TS_ASSERT_EQUALS(element, "new");
+
+    }
+    TS_ASSERT_EQUALS(zeroes, 11);
+
+  }
+
+  void testLoadRejectsBadSnapshots(){
+
+    PriorityQueue<int> ints;
+    ints.insert(3, 30);
+    std::stringstream snapshot;
+    ints.save(snapshot);
+
+    // A different payload format or key type is refused
+    PriorityQueue<std::string> strings;
+    strings.insert(1, "kept");
+    TS_ASSERT(!strings.load(snapshot));
+    TS_ASSERT_EQUALS(strings.size(), 1);
+
+    snapshot.clear();
+    snapshot.seekg(0);
+    StablePriorityQueue<int> stable;
+    TS_ASSERT(!stable.load(snapshot));
+
+    std::stringstream garbage("not a snapshot at all, not even close to one");
+    TS_ASSERT(!ints.load(garbage));
+
+    // A truncated snapshot leaves the queue alone
+    std::string bytes = snapshot.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 2));
+    TS_ASSERT(!ints.load(truncated));
+    TS_ASSERT_EQUALS(ints.peek(), 30);
+
+  }
+
+  void testLoadRejectsCorruptedCount(){
+
+    PriorityQueue<int> ints;
+    ints.insert(3, 30);
+    ints.insert(4, 40);
+    std::stringstream snapshot;
+    ints.save(snapshot);
+    std::string bytes = snapshot.str();
+
+    // The node count follows six 32-bit header fields. Counts past INT_MAX
+    // are refused outright, and big ones the stream does not back up are
+    // refused once it runs out, without allocating for the whole count
+    const std::uint64_t counts[] = { 3, std::uint64_t(1) << 30, std::uint64_t(1) << 40, ~std::uint64_t(0) };
+    for (int i = 0; i < 4; i++){
+
+      std::string corrupted = bytes;
+      std::memcpy(&corrupted[24], &counts[i], sizeof(counts[i]));
+      std::stringstream in(corrupted);
+      TS_ASSERT(!ints.load(in));
+      TS_ASSERT_EQUALS(ints.size(), 2);
+      TS_ASSERT_EQUALS(ints.peek(), 30);
+
+      PriorityQueue<std::string> strings;
+      std::stringstream stringSnapshot;
+      strings.insert(1, "kept");
+      strings.save(stringSnapshot);
+      std::string stringBytes = stringSnapshot.str();
+      std::memcpy(&stringBytes[24], &counts[i], sizeof(counts[i]));
+      std::stringstream stringIn(stringBytes);
+      TS_ASSERT(!strings.load(stringIn));
+      TS_ASSERT_EQUALS(strings.peek(), "kept");
+
+    }
+
+    // A count the data does back up still loads
+    std::stringstream intact(bytes);
+    PriorityQueue<int> copy;
+    TS_ASSERT(copy.load(intact));
+    TS_ASSERT_EQUALS(copy.size(), 2);
+
+  }
+
+  void testLoadMapped(){
+
+    PriorityQueue<int, 4> pq;
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    char path[] = "/tmp/pq_snapshot_XXXXXX";
+    int file = mkstemp(path);
+    TS_ASSERT(file != -1);
+    close(file);
+    {
+      std::ofstream out(path, std::ios::binary);
+      pq.save(out);
+    }
+
+    PriorityQueue<int, 4> loaded;
+    TS_ASSERT(loaded.load_mapped(path));
+    TS_ASSERT(loaded.get_all_elements() == pq.get_all_elements());
+    TS_ASSERT(loaded.get_all_priorities() == pq.get_all_priorities());
+
+    // Another arity reads the same file, with a rebuild
+    PriorityQueue<int> binary;
+    TS_ASSERT(binary.load_mapped(path));
+    std::vector<int> expected;
+    std::vector<int> actual;
+    pq.drain_into(expected);
+    binary.drain_into(actual);
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT_EQUALS(loaded.get_priority(actual[i]), loaded.get_priority(expected[i]));
+
+    }
+
+    TS_ASSERT(!binary.load_mapped("/tmp/no/such/snapshot"));
+    std::remove(path);
+
+  }
+
+  void testParallelInsertAll(){
+
+    std::vector<std::pair<int, int> > pairs;
+    for (int i = 0; i < 200000; i++){
+
+      pairs.push_back(std::make_pair(rand()%1000, i));
+
+    }
+
+    // Equal priorities still leave in the order they were given
+    StablePriorityQueue<int> pq;
+    pq.insert(5, -1);
+    pq.insert_all(pairs, 4);
+    TS_ASSERT_EQUALS(pq.size(), 200001);
+
+    std::vector<int> lastOf(1000, -2);
+    lastOf[5] = -1;
+    TS_ASSERT_EQUALS(pq.get_priority(-1), 5);
+    int last = -1;
+    while (!pq.empty()){
+
+      int priority = pq.peek_priority();
+      int element = pq.pop();
+      TS_ASSERT(last <= priority);
+      TS_ASSERT(lastOf[priority] < element || (priority == 5 && element == -1));
+      lastOf[priority] = element;
+      last = priority;
+
+    }
+
+    // Moving the pairs in with one thread per core gives the same queue
+    PriorityQueue<int, 4> moved;
+    moved.insert_all(std::move(pairs), 0);
+    TS_ASSERT_EQUALS(moved.size(), 200000);
+    last = -1;
+    while (!moved.empty()){
+
+      TS_ASSERT(last <= moved.peek_priority());
+      last = moved.peek_priority();
+      moved.pop();
+
+    }
+
+  }
+
+  void testMerge(){
+
+    for (int size = 10; size <= 100000; size *= 100){
+
+      StablePriorityQueue<int> a;
+      StablePriorityQueue<int> b;
+      std::vector<StablePriorityQueue<int>::Handle> handles;
+      for (int i = 0; i < size; i++){
+
+	handles.push_back(a.insert(i % 50, i));
+	b.insert(i % 50, size + i);
+
+      }
+      StablePriorityQueue<int>::Handle fromB = b.insert(0, -5);
+
+      a.merge(std::move(b), 4);
+      TS_ASSERT(b.empty());
+      TS_ASSERT(!b.contains(fromB));
+      TS_ASSERT_EQUALS(a.size(), 2 * size + 1);
+      TS_ASSERT_EQUALS(a.get_priority(handles[7]), 7);
+
+      // Elements from "b" go after those of "a" among equal priorities
+      std::vector<int> lastOf(50, -1);
+      while (!a.empty()){
+
+	int priority = a.peek_priority();
+	int element = a.pop();
+	if (element == -5) element = 2 * size;
+	TS_ASSERT(lastOf[priority] < element);
+	lastOf[priority] = element;
+
+      }
+
+      b.insert(1, 1);
+      TS_ASSERT_EQUALS(b.pop(), 1);
+
+    }
+
+  }
+
+  void testBoundedQueue(){
+
+    // Keeps the 100 smallest of a shuffled stream
+    PriorityQueue<int> pq(100, OverflowPolicy::EVICT_WORST);
+    TS_ASSERT_EQUALS(pq.bound(), 100);
+    std::size_t reserved = pq.capacity();
+    TS_ASSERT(reserved >= 100);
+
+    for (int i = 0; i < 10000; i++){
+
+      int value = (i * 7919) % 10000;
+      int toBeat = pq.full() ? pq.worst_priority() : 10000;
+      PriorityQueue<int>::Handle handle = pq.insert(value, value);
+      TS_ASSERT_EQUALS(pq.contains(handle), value < toBeat);
+      TS_ASSERT(pq.size() <= 100);
+
+    }
+
+    TS_ASSERT(pq.full());
+    TS_ASSERT_EQUALS(pq.capacity(), reserved);
+    TS_ASSERT_EQUALS(pq.worst_priority(), 99);
+
+    // Ties with the worst are turned away
+    TS_ASSERT(!pq.contains(pq.insert(99, -1)));
+
+    // The worst is kept track of through erases and priority changes
+    pq.change_priority(99, 0);
+    TS_ASSERT_EQUALS(pq.worst_priority(), 98);
+    pq.erase(98);
+    pq.insert(500, 500);
+    TS_ASSERT_EQUALS(pq.worst_priority(), 500);
+    pq.insert(50, -50);
+    TS_ASSERT(!pq.contains(500));
+
+    std::vector<std::pair<int,int> > batch;
+    for (int i = 0; i < 1000; i++){
+
+      batch.push_back(std::make_pair(i % 10, 1000 + i));
+
+    }
+    pq.insert_all(batch);
+    TS_ASSERT_EQUALS(pq.size(), 100);
+    TS_ASSERT_EQUALS(pq.worst_priority(), 0);
+    TS_ASSERT_EQUALS(pq.capacity(), reserved);
+
+    for (int i = 0; i < 100; i++){
+
+      TS_ASSERT(pq.peek_priority() <= pq.worst_priority());
+      pq.pop();
+
+    }
+    TS_ASSERT(pq.empty());
+
+  }
+
+  void testBoundedQueueMatchesReference(){
+
+    // Lazy erase and stability must not upset the worst-first heap
+    StablePriorityQueue<int> pq(64, OverflowPolicy::EVICT_WORST);
+    pq.set_lazy_erase(true);
+    std::vector<std::pair<int,int> > reference;
+
+    for (int i = 0; i < 20000; i++){
+
+      int action = rand() % 5;
+      if (action < 3){
+
+	int priority = rand() % 200;
+	pq.insert(priority, i);
+	reference.push_back(std::make_pair(priority, i));
+	std::stable_sort(reference.begin(), reference.end(),
+			 [](const std::pair<int,int>& a, const std::pair<int,int>& b){ return a.first < b.first; });
+	if (reference.size() > 64) reference.pop_back();
+
+      }
+      else if (action == 3 && !reference.empty()){
+
+	int victim = rand() % reference.size();
+	TS_ASSERT(pq.erase(reference[victim].second));
+	reference.erase(reference.begin() + victim);
+
+      }
+      else if (!reference.empty()){
+
+	TS_ASSERT_EQUALS(pq.pop(), reference.front().second);
+	reference.erase(reference.begin());
+
+      }
+      TS_ASSERT_EQUALS(pq.size(), reference.size());
+      TS_ASSERT(pq.physical_size() <= 64);
+      if (!reference.empty()) TS_ASSERT_EQUALS(pq.worst_priority(), reference.back().first);
+
+    }
+
+  }
+
+  void testBoundedQueueRejectNew(){
+
+    PriorityQueue<int> pq(3, OverflowPolicy::REJECT_NEW);
+    TS_ASSERT_EQUALS(pq.overflow_policy(), OverflowPolicy::REJECT_NEW);
+    pq.insert(5, 5);
+    pq.insert(7, 7);
+    pq.insert(6, 6);
+    TS_ASSERT(!pq.contains(pq.insert(0, 0)));
+    TS_ASSERT_EQUALS(pq.size(), 3);
+    TS_ASSERT_EQUALS(pq.peek(), 5);
+
+    PriorityQueue<int> other;
+    for (int i = 0; i < 10; i++){
+
+      other.insert(i, 100 + i);
+
+    }
+    pq.pop();
+    pq.merge(std::move(other));
+    TS_ASSERT(other.empty());
+    TS_ASSERT_EQUALS(pq.size(), 3);
+    TS_ASSERT(pq.contains(100));
+
+    // A snapshot bigger than the bound is turned away
+    PriorityQueue<int> big;
+    for (int i = 0; i < 10; i++){
+
+      big.insert(i, i);
+
+    }
+    std::stringstream snapshot;
+    big.save(snapshot);
+    TS_ASSERT(!pq.load(snapshot));
+    TS_ASSERT_EQUALS(pq.size(), 3);
+
+  }
+
+  void testAlignedArray(){
+
+    AlignedArray<CacheLine> lines(5);
+    for (int i = 0; i < 5; i++){
+
+      TS_ASSERT_EQUALS(reinterpret_cast<std::uintptr_t>(&lines[i]) % 64, 0);
+      TS_ASSERT_EQUALS(lines[i].value, 7);
+
+    }
+
+    lines[2].value = 3;
+    lines.reset(3);
+    TS_ASSERT_EQUALS(lines[2].value, 7);
+    TS_ASSERT_EQUALS(reinterpret_cast<std::uintptr_t>(&lines[0]) % 64, 0);
+
+    AlignedArray<CacheLine> empty;
+    empty.reset(0);
+
+  }
+  
 };
@@ -0,0 +1,408 @@
+#ifndef _ASYNC_PR_QUEUE_H
+#define _ASYNC_PR_QUEUE_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define PRIORITY_QUEUE_HAVE_COROUTINES
+#include <coroutine>
+#endif
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements an asynchronous producer/consumer front end over
+ * PriorityQueue, for elements that are produced on one set of threads and
+ * consumed on another.
+ * Producers never touch the heap for a single push. Each producer thread is
+ * given one of a fixed set of staging buffers, and pushes go there under
+ * the buffer's own lock, which is normally uncontended. Once a buffer holds
+ * "batchSize" elements it is moved into the heap under one heap lock
+ * acquisition. The batch goes in an element at a time, so the lock is held
+ * for O(k log n) for k elements, however big the heap has grown.
+ * Consumers that find nothing to take do not poll or spin. They leave a
+ * waiter behind, and the next producer hands an element straight to the
+ * oldest waiter. Waiters can be a std::future (pop_future(), or wait_pop()
+ * to block on one), or with C++20 coroutines, "co_await queue.pop()".
+ * While any consumer is waiting, producers skip batching, so a waiter is
+ * never left behind elements sitting in a staging buffer.
+ * Every pop drains the staging buffers first, so it sees every push that
+ * finished before it started.
+ * Waiters are handed their elements, and coroutines are resumed, on the
+ * producer thread that pushed, after every lock has been released.
+ * The template parameters are the same as for PriorityQueue.
+ */
+template <typename E, int Arity = 2, typename Priority = int, typename Compare = std::less<Priority> >
+class AsyncPriorityQueue {
+
+private:
+
+  typedef PriorityQueue<E, Arity, Priority, Compare> Queue;
+  typedef std::vector<std::pair<Priority, E> > Batch;
+
+  /*
+   * Class for one staging buffer, padded to its own cache line so producers
+   * on different buffers do not false-share.
+   */
+  class alignas(64) Staging {
+  public:
+    std::mutex lock;
+    Batch pending;
+
+    // Size of "pending", readable without the lock
+    std::atomic<int> count;
+
+    /*
+     * Staging constructor with an empty buffer.
+     */
+    Staging() : count(0) {
+    }
+  };
+
+  /*
+   * Class for a consumer waiting for an element.
+   */
+  class Waiter {
+  public:
+    virtual ~Waiter() {
+    }
+
+    /*
+     * Hands "element" to the consumer.
+     */
+    virtual void deliver(E&& element) = 0;
+
+    /*
+     * Gives up on the consumer when the queue is destroyed first.
+     */
+    virtual void abandon() = 0;
+  };
+
+  /*
+   * Class for a consumer waiting on a std::future. It owns itself, and is
+   * deleted once it has been given an element, or abandoned (which breaks
+   * the promise).
+   */
+  class FutureWaiter : public Waiter {
+  public:
+    std::promise<E> promise;
+
+    void deliver(E&& element) {
+      promise.set_value(std::move(element));
+      delete this;
+    }
+
+    void abandon() {
+      delete this;
+    }
+  };
+
+  /*
+   * Private helper method that returns the staging buffer of the calling
+   * thread. Threads are given buffers in turn as they first push.
+   */
+  Staging& localStaging() {
+    static std::atomic<unsigned> nextThread(0);
+    static thread_local unsigned thread = nextThread++;
+    return stagings[thread % stagingCount];
+  }
+
+  /*
+   * Private helper method that moves the elements of "batch" into the heap
+   * and empties it. Each is sifted up on its own, since a batch is small
+   * next to the heap and a rebuild would cost O(n) under the lock.
+   * The heap lock must be held.
+   */
+  void absorb(Batch& batch) {
+    for (std::size_t i = 0; i < batch.size(); i++) {
+      heap.insert(batch[i].first, std::move(batch[i].second));
+    }
+    batch.clear();
+  }
+
+  /*
+   * Private helper method that moves every staging buffer into the heap.
+   * The heap lock must be held.
+   */
+  void drainStaging() {
+    for (int i = 0; i < stagingCount; i++) {
+      Staging& staging = stagings[i];
+      if (staging.count.load() == 0) {
+        continue;
+      }
+      std::lock_guard<std::mutex> guard(staging.lock);
+      absorb(staging.pending);
+      staging.count.store(0);
+    }
+  }
+
+  /*
+   * Private helper method that pairs waiting consumers with the best
+   * elements in the heap, oldest waiter first. The heap lock must be held;
+   * the elements are delivered once it has been let go.
+   */
+  void handOut(std::vector<std::pair<Waiter*, E> >& ready) {
+    while (!waiters.empty() && !heap.empty()) {
+      ready.push_back(std::make_pair(waiters.front(), heap.pop()));
+      waiters.pop_front();
+      waiting--;
+      count--;
+    }
+  }
+
+  /*
+   * Private helper method that delivers what handOut() paired up.
+   */
+  static void deliver(std::vector<std::pair<Waiter*, E> >& ready) {
+    for (std::size_t i = 0; i < ready.size(); i++) {
+      ready[i].first->deliver(std::move(ready[i].second));
+    }
+  }
+
+  /*
+   * Private helper method that moves "batch" into the heap, and serves any
+   * waiting consumers from it.
+   */
+  void flush(Batch& batch) {
+    std::vector<std::pair<Waiter*, E> > ready;
+    {
+      std::lock_guard<std::mutex> guard(heapLock);
+      absorb(batch);
+      handOut(ready);
+    }
+    deliver(ready);
+  }
+
+  /*
+   * Private helper method for a consumer about to wait. Takes the best
+   * element into "element" and returns false if there is one after all,
+   * and otherwise queues "waiter" and returns true.
+   * The waiting count goes up before the staging buffers are drained, and a
+   * producer checks it after staging its push, so either the drain sees the
+   * push or the producer sees the waiter.
+   */
+  bool waitOrTake(Waiter* waiter, E& element) {
+    std::lock_guard<std::mutex> guard(heapLock);
+    waiting++;
+    drainStaging();
+    if (!heap.empty()) {
+      waiting--;
+      count--;
+      element = heap.pop();
+      return false;
+    }
+    waiters.push_back(waiter);
+    return true;
+  }
+
+  // Staging buffers shared out between producer threads
+  AlignedArray<Staging> stagings;
+  int stagingCount;
+  int batchSize;
+
+  // The heap, and consumers waiting for it to have something
+  std::mutex heapLock;
+  Queue heap;
+  std::deque<Waiter*> waiters;
+
+  // Consumers waiting, readable without the heap lock
+  std::atomic<int> waiting;
+
+  // Elements in the heap and the staging buffers together
+  std::atomic<int> count;
+
+public:
+
+  /*
+   * Constructor that takes how many elements a staging buffer collects
+   * before it is moved into the heap, and how many staging buffers to
+   * share out between producer threads (0 for one per core).
+   */
+  explicit AsyncPriorityQueue(int newBatchSize = 64, int newStagingCount = 0)
+    : stagingCount(newStagingCount > 0 ? newStagingCount : std::max(1u, std::thread::hardware_concurrency())),
+      batchSize(std::max(1, newBatchSize)), waiting(0), count(0) {
+    stagings.reset(stagingCount);
+  }
+
+  /*
+   * Destructor that abandons any consumers still waiting. Their futures
+   * get a broken_promise error; coroutines still waiting are never resumed.
+   */
+  ~AsyncPriorityQueue() {
+    for (std::size_t i = 0; i < waiters.size(); i++) {
+      waiters[i]->abandon();
+    }
+  }
+
+  /*
+   * Adds "element" with priority "priority" to the calling thread's
+   * staging buffer, moving the buffer into the heap if it is full or a
+   * consumer is waiting. Returns false if the priority was rejected.
+   */
+  bool push(const Priority& priority, E element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return false;
+    }
+
+    Staging& staging = localStaging();
+    Batch batch;
+    count++;
+    {
+      std::lock_guard<std::mutex> guard(staging.lock);
+      staging.pending.push_back(std::make_pair(priority, std::move(element)));
+      if (staging.pending.size() >= (std::size_t)batchSize) {
+        batch.swap(staging.pending);
+        staging.pending.reserve(batchSize);
+      }
+      staging.count.store(staging.pending.size());
+    }
+
+    if (batch.empty() && waiting.load() > 0) {
+      std::lock_guard<std::mutex> guard(staging.lock);
+      batch.swap(staging.pending);
+      staging.count.store(0);
+    }
+    if (!batch.empty()) {
+      flush(batch);
+    }
+    return true;
+  }
+
+  /*
+   * Moves every staging buffer into the heap now, and serves any waiting
+   * consumers.
+   */
+  void flush() {
+    std::vector<std::pair<Waiter*, E> > ready;
+    {
+      std::lock_guard<std::mutex> guard(heapLock);
+      drainStaging();
+      handOut(ready);
+    }
+    deliver(ready);
+  }
+
+  /*
+   * Takes the lowest priority value element and moves it into "element",
+   * without waiting. Returns false if there was nothing to take.
+   */
+  bool try_pop(E& element) {
+    std::lock_guard<std::mutex> guard(heapLock);
+    drainStaging();
+    if (heap.empty()) {
+      return false;
+    }
+    count--;
+    element = heap.pop();
+    return true;
+  }
+
+  /*
+   * Returns a future for the lowest priority value element. The future is
+   * ready straight away if there is an element, and otherwise becomes ready
+   * when a producer pushes one.
+   */
+  std::future<E> pop_future() {
+    FutureWaiter* waiter = new FutureWaiter();
+    std::future<E> future = waiter->promise.get_future();
+    E element;
+    if (!waitOrTake(waiter, element)) {
+      waiter->deliver(std::move(element));
+    }
+    return future;
+  }
+
+  /*
+   * Takes the lowest priority value element, blocking until there is one.
+   */
+  E wait_pop() {
+    return pop_future().get();
+  }
+
+#if defined(PRIORITY_QUEUE_HAVE_COROUTINES)
+  /*
+   * Awaitable returned by pop(). Awaiting it gives the lowest priority
+   * value element, suspending the coroutine until there is one. It lives in
+   * the coroutine frame, so waiting this way allocates nothing.
+   */
+  class PopAwaitable : private Waiter {
+  private:
+    // Private fields
+    AsyncPriorityQueue& queue;
+    E element;
+    std::coroutine_handle<> handle;
+
+    friend class AsyncPriorityQueue;
+
+    /*
+     * PopAwaitable constructor used by the queue itself.
+     */
+    explicit PopAwaitable(AsyncPriorityQueue& newQueue) : queue(newQueue) {
+    }
+
+    void deliver(E&& newElement) {
+      element = std::move(newElement);
+      handle.resume();
+    }
+
+    void abandon() {
+    }
+
+  public:
+
+    bool await_ready() {
+      return queue.try_pop(element);
+    }
+
+    bool await_suspend(std::coroutine_handle<> newHandle) {
+      handle = newHandle;
+      return queue.waitOrTake(this, element);
+    }
+
+    E await_resume() {
+      return std::move(element);
+    }
+  };
+
+  /*
+   * Returns an awaitable for the lowest priority value element, for use as
+   * "E element = co_await queue.pop();".
+   */
+  PopAwaitable pop() {
+    return PopAwaitable(*this);
+  }
+#endif
+
+  /*
+   * Returns the number of elements in the heap and the staging buffers.
+   * With other threads running this is only a snapshot.
+   */
+  int size() const {
+    return count.load();
+  }
+
+  /*
+   * Returns true if there are no elements, false otherwise.
+   */
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /*
+   * Returns the number of consumers waiting for an element.
+   */
+  int waiting_count() const {
+    return waiting.load();
+  }
+
+};
+
+#endif
@@ -0,0 +1,142 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <chrono>
+
+#include "AsyncPriorityQueue.h"
+
+class AsyncPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testStagedPushesComeOutInOrder(){
+
+    AsyncPriorityQueue<int> pq(64, 2);
+
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT(pq.push((i * 7919) % 1000, (i * 7919) % 1000));
+
+    }
+
+    TS_ASSERT(!pq.push(-1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 1000);
+
+    // A pop sees pushes still sitting in a staging buffer
+    int element;
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT(pq.try_pop(element));
+      TS_ASSERT_EQUALS(element, i);
+
+    }
+
+    TS_ASSERT(!pq.try_pop(element));
+    TS_ASSERT(pq.empty());
+
+  }
+
+  void testFutureWaitsForProducer(){
+
+    AsyncPriorityQueue<int> pq(64, 1);
+
+    std::future<int> first = pq.pop_future();
+    std::future<int> second = pq.pop_future();
+    TS_ASSERT_EQUALS(pq.waiting_count(), 2);
+    TS_ASSERT(first.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout);
+
+    // A waiter is served at once rather than after a full batch
+    pq.push(5, 50);
+    TS_ASSERT(first.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready);
+    TS_ASSERT_EQUALS(first.get(), 50);
+
+    std::thread producer([&pq](){ pq.push(3, 30); });
+    TS_ASSERT_EQUALS(second.get(), 30);
+    producer.join();
+    TS_ASSERT_EQUALS(pq.waiting_count(), 0);
+
+    // With something queued the future is ready straight away
+    pq.push(1, 10);
+    pq.push(0, 0);
+    TS_ASSERT_EQUALS(pq.wait_pop(), 0);
+    TS_ASSERT_EQUALS(pq.pop_future().get(), 10);
+
+  }
+
+  void testManyProducersAndConsumers(){
+
+    AsyncPriorityQueue<int> pq(16, 4);
+    const int producers = 4;
+    const int perThread = 2000;
+
+    std::vector<std::atomic<int> > seen(producers * perThread);
+    for (int i = 0; i < seen.size(); i++){
+
+      seen[i] = 0;
+
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < producers; t++){
+
+      threads.push_back(std::thread([&pq, t, perThread](){
+	for (int i = 0; i < perThread; i++){
+	  pq.push(i % 100, t * perThread + i);
+	}
+      }));
+      threads.push_back(std::thread([&pq, &seen, perThread](){
+	for (int i = 0; i < perThread; i++){
+	  seen[pq.wait_pop()]++;
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    TS_ASSERT(pq.empty());
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i].load(), 1);
+
+    }
+
+  }
+
+  void testFlushServesWaiters(){
+
+    AsyncPriorityQueue<int> pq(1000, 1);
+    for (int i = 0; i < 10; i++){
+
+      pq.push(i, i);
+
+    }
+    TS_ASSERT_EQUALS(pq.size(), 10);
+
+    pq.flush();
+    int element;
+    TS_ASSERT(pq.try_pop(element));
+    TS_ASSERT_EQUALS(element, 0);
+
+  }
+
+  void testAbandonedFutureIsBroken(){
+
+    std::future<int> future;
+    {
+      AsyncPriorityQueue<int> pq;
+      future = pq.pop_future();
+    }
+    TS_ASSERT_THROWS(future.get(), std::future_error);
+
+  }
+
+};
@@ -0,0 +1,249 @@
+#ifndef _CONCURRENT_PR_QUEUE_H
+#define _CONCURRENT_PR_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a thread-safe priority queue on top of
+ * PriorityQueue, using flat combining.
+ * Rather than each thread taking the heap lock in turn, a thread publishes
+ * its push or pop in a shared publication record. Whichever thread gets the
+ * heap lock becomes the combiner and applies every published operation in
+ * one go, while the others wait for their record to be marked done. Under
+ * contention this turns many lock handoffs into one, and the heap stays hot
+ * in a single core's cache.
+ * The template parameters are the same as for PriorityQueue.
+ */
+template <typename E, int Arity = 2, typename Priority = int, typename Compare = std::less<Priority> >
+class ConcurrentPriorityQueue {
+
+private:
+
+  typedef PriorityQueue<E, Arity, Priority, Compare> Queue;
+
+  /*
+   * Class for a publication record - one pending operation waiting to be
+   * applied by the combiner. The element and priority live on the caller's
+   * stack, which stays valid because the caller waits until the record is done.
+   */
+  class alignas(64) Record {
+  public:
+
+    // Record states
+    static const int FREE = 0;
+    static const int PENDING = 1;
+    static const int DONE = 2;
+
+    // Operations
+    static const int PUSH = 0;
+    static const int POP = 1;
+
+    std::atomic<bool> claimed;
+    std::atomic<int> state;
+    int operation;
+    const Priority* priority;
+    E* element;
+    bool result;
+
+    /*
+     * Record constructor that leaves the record free for any thread.
+     */
+    Record() : claimed(false), state(FREE), operation(PUSH), priority(0), element(0), result(false) {
+    }
+  };
+
+  /*
+   * Private helper method that claims a free publication record, starting
+   * from a slot picked by the calling thread's id so threads tend to keep
+   * to their own record. Returns null if every record is in use.
+   */
+  Record* claimRecord() {
+    std::size_t start = std::hash<std::thread::id>()(std::this_thread::get_id()) % recordCount;
+    for (int i = 0; i < recordCount; i++) {
+      Record& record = records[(start + i) % recordCount];
+      bool expected = false;
+      if (!record.claimed.load(std::memory_order_relaxed) &&
+          record.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return &record;
+      }
+    }
+    return 0;
+  }
+
+  /*
+   * Private helper method that applies one operation to the heap.
+   * The heap lock must be held.
+   */
+  bool apply(int operation, const Priority* priority, E* element) {
+    if (operation == Record::PUSH) {
+      if (queue.insert(*priority, std::move(*element)) == typename Queue::Handle()) {
+        return false;
+      }
+      count.fetch_add(1);
+      return true;
+    }
+
+    if (queue.empty()) {
+      return false;
+    }
+    *element = queue.pop();
+    count.fetch_sub(1);
+    return true;
+  }
+
+  /*
+   * Private combine method, run by whichever thread holds the heap lock.
+   * Applies every pending operation it can find, so one lock acquisition
+   * serves a whole batch of threads.
+   */
+  void combine() {
+    for (int pass = 0; pass < 2; pass++) {
+      for (int i = 0; i < recordCount; i++) {
+        Record& record = records[i];
+        if (record.state.load(std::memory_order_acquire) == Record::PENDING) {
+          record.result = apply(record.operation, record.priority, record.element);
+          record.state.store(Record::DONE, std::memory_order_release);
+        }
+      }
+    }
+  }
+
+  /*
+   * Private helper method that publishes an operation and waits until a
+   * combiner (possibly this thread) has applied it. Returns its result.
+   */
+  bool execute(int operation, const Priority* priority, E* element) {
+    Record* record = claimRecord();
+
+    // Every record is busy, so just queue up for the lock
+    if (record == 0) {
+      std::lock_guard<std::mutex> lock(heapMutex);
+      return apply(operation, priority, element);
+    }
+
+    record->operation = operation;
+    record->priority = priority;
+    record->element = element;
+    record->state.store(Record::PENDING, std::memory_order_release);
+
+    // The lock is held by a unique_lock so it is released even if an
+    // element's move or an allocation in the heap throws
+    while (record->state.load(std::memory_order_acquire) != Record::DONE) {
+      std::unique_lock<std::mutex> lock(heapMutex, std::try_to_lock);
+      if (lock.owns_lock()) {
+        combine();
+      }
+      else {
+        std::this_thread::yield();
+      }
+    }
+
+    bool result = record->result;
+    record->state.store(Record::FREE, std::memory_order_relaxed);
+    record->claimed.store(false, std::memory_order_release);
+    return result;
+  }
+
+  /*
+   * Private helper method that wakes a blocked pop() after a push.
+   */
+  void notifyWaiters() {
+    if (waiters.load() > 0) {
+      std::lock_guard<std::mutex> lock(waitMutex);
+      notEmpty.notify_one();
+    }
+  }
+
+  // The heap itself, only touched while heapMutex is held
+  Queue queue;
+  std::mutex heapMutex;
+
+  // Publication records
+  AlignedArray<Record> records;
+  int recordCount;
+
+  // Number of elements, readable without the heap lock
+  std::atomic<int> count;
+
+  // Blocking pop support
+  std::mutex waitMutex;
+  std::condition_variable notEmpty;
+  std::atomic<int> waiters;
+
+public:
+
+  /*
+   * Constructor that takes the number of publication records to use. It
+   * should be at least the number of threads expected to use the queue at
+   * once; threads that find no free record still work, but skip combining.
+   */
+  explicit ConcurrentPriorityQueue(int newRecordCount = 2 * std::max(1u, std::thread::hardware_concurrency()))
+    : records(newRecordCount), recordCount(newRecordCount), count(0), waiters(0) {
+  }
+
+  /*
+   * Adds "element" to the queue with priority "priority". Returns false if
+   * the priority was rejected, just like PriorityQueue::insert().
+   */
+  bool push(const Priority& priority, E element) {
+    bool pushed = execute(Record::PUSH, &priority, &element);
+    if (pushed) {
+      notifyWaiters();
+    }
+    return pushed;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves it into
+   * "element". Returns false without waiting if the queue is empty.
+   */
+  bool try_pop(E& element) {
+    if (count.load() == 0) {
+      return false;
+    }
+    return execute(Record::POP, 0, &element);
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and returns it,
+   * blocking until there is one to take.
+   */
+  E pop() {
+    E element;
+    while (!try_pop(element)) {
+      std::unique_lock<std::mutex> lock(waitMutex);
+      waiters.fetch_add(1);
+      notEmpty.wait(lock, [this] { return count.load() > 0; });
+      waiters.fetch_sub(1);
+    }
+    return element;
+  }
+
+  /*
+   * Returns the number of elements in the queue. With other threads
+   * running this is only a snapshot.
+   */
+  int size() const {
+    return count.load();
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise. With other
+   * threads running this is only a snapshot.
+   */
+  bool empty() const {
+    return count.load() == 0;
+  }
+
+};
+
+#endif
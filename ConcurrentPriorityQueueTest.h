@@ -0,0 +1,138 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "ConcurrentPriorityQueue.h"
+
+class ConcurrentPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testSingleThreadOrder(){
+
+    ConcurrentPriorityQueue<int> pq;
+
+    for (int i = 0; i < 100; i++){
+
+      pq.push((i * 37) % 100, i);
+
+    }
+
+    TS_ASSERT(!pq.push(-1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 100);
+
+    int last = -1;
+    int element;
+
+    while (pq.try_pop(element)){
+
+      int priority = (element * 37) % 100;
+      TS_ASSERT(last < priority);
+      last = priority;
+
+    }
+
+    TS_ASSERT(pq.empty());
+
+  }
+
+  void testProducersAndConsumers(){
+
+    const int producers = 4;
+    const int perProducer = 5000;
+
+    ConcurrentPriorityQueue<int> pq;
+    std::vector<std::atomic<int> > seen(producers * perProducer);
+    std::atomic<int> popped(0);
+
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; p++){
+
+      threads.push_back(std::thread([&pq, p, perProducer](){
+	for (int i = 0; i < perProducer; i++){
+	  pq.push(i % 100, p * perProducer + i);
+	}
+      }));
+
+    }
+
+    for (int c = 0; c < 3; c++){
+
+      threads.push_back(std::thread([&](){
+	int element;
+	while (popped.load() < producers * perProducer){
+	  if (pq.try_pop(element)){
+	    seen[element]++;
+	    popped++;
+	  }
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    TS_ASSERT(pq.empty());
+
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i].load(), 1);
+
+    }
+
+  }
+
+  void testBlockingPopWaitsForPush(){
+
+    ConcurrentPriorityQueue<int> pq;
+    std::atomic<int> result(-1);
+
+    std::thread consumer([&](){
+      result = pq.pop();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TS_ASSERT_EQUALS(result.load(), -1);
+
+    pq.push(5, 42);
+    consumer.join();
+
+    TS_ASSERT_EQUALS(result.load(), 42);
+
+  }
+
+  void testMoreThreadsThanRecords(){
+
+    ConcurrentPriorityQueue<int> pq(1);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++){
+
+      threads.push_back(std::thread([&pq, t](){
+	for (int i = 0; i < 1000; i++){
+	  pq.push(i, t);
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    TS_ASSERT_EQUALS(pq.size(), 4000);
+
+  }
+
+};
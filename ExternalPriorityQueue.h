@@ -0,0 +1,631 @@
+#ifndef _EXTERNAL_PR_QUEUE_H
+#define _EXTERNAL_PR_QUEUE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements an external-memory priority queue, for backlogs
+ * too big to keep in RAM, in the spirit of a sequence heap.
+ * New elements go into an in-memory PriorityQueue used as an insertion
+ * buffer. When the buffer fills up, it is drained in priority order to a
+ * sorted run on disk. Each run on disk keeps only one block in memory, read
+ * with one large sequential read at a time, and a small heap over the
+ * fronts of the runs does the multiway merge as elements are taken.
+ * remove_front() takes whichever is better of the buffer's front and the
+ * front of the best run.
+ * Runs are merged in tiers, as in an LSM tree. A spilled buffer is a run on
+ * level 0, and once a level has fanout() runs they are merged with one
+ * sequential pass into a single run on the next level up. Each element is
+ * rewritten once per level, so total I/O is O((n/B) log(n/M)) for n
+ * elements, blocks of B and a buffer of M.
+ * Half of the memory budget goes to the insertion buffer and half to run
+ * blocks, with the fanout picked so that the blocks of four full levels
+ * fit. Sizes are worked out from sizeof(std::pair<Priority, E>), so
+ * elements that own extra memory (such as strings) use more than this.
+ * Elements are written with PayloadSerializer<E>, the same as
+ * PriorityQueue::save(), and priorities must be trivially copyable.
+ * Run files live in the directory given to the constructor, and are deleted
+ * once they are used up or the queue is destroyed.
+ * A merge that cannot be written or read back is abandoned, leaving the
+ * runs it was merging as they were. If a run cannot be read, the elements
+ * left in it are lost and size() drops by that many. Either way
+ * io_error() reports it from then on.
+ */
+template <typename E, typename Priority = int, typename Compare = std::less<Priority> >
+class ExternalPriorityQueue {
+
+  static_assert(std::is_trivially_copyable<Priority>::value, "runs on disk need trivially copyable priorities");
+
+private:
+
+  typedef PayloadSerializer<E> Serializer;
+  typedef std::pair<Priority, E> Entry;
+
+  /*
+   * Class for how far through a run reading has got, so a run can be put
+   * back where it was.
+   */
+  class Mark {
+  public:
+    std::streampos blockStart;
+    std::uint64_t remainingAtBlock;
+    std::size_t next;
+  };
+
+  /*
+   * Class for one sorted run on disk, and the block of it in memory.
+   */
+  class Run {
+  public:
+    std::string path;
+    std::ifstream file;
+    std::vector<char> streamBuffer;
+
+    // The block of entries read in so far, and the next one to hand out
+    std::vector<Entry> block;
+    std::size_t next;
+
+    // Entries still on disk after this block, and how many there were
+    // before it was read, starting at "blockStart" in the file
+    std::uint64_t remaining;
+    std::uint64_t remainingAtBlock;
+    std::streampos blockStart;
+
+    // Entries that could not be read back, and so are gone
+    std::uint64_t lost;
+
+    // Merge level the run is on
+    int level;
+
+    /*
+     * Run constructor that opens the run of "count" entries at "newPath",
+     * on merge level "newLevel", reading through a buffer of "bufferBytes".
+     */
+    Run(const std::string& newPath, std::uint64_t count, int newLevel, std::size_t bufferBytes)
+      : path(newPath), streamBuffer(bufferBytes), next(0), remaining(count), remainingAtBlock(count),
+        blockStart(0), lost(0), level(newLevel) {
+      file.rdbuf()->pubsetbuf(&streamBuffer[0], streamBuffer.size());
+      file.open(path.c_str(), std::ios::binary);
+    }
+
+    /*
+     * Reads the next block of up to "blockEntries" entries. Returns false if
+     * the run is used up. Entries that cannot be read are counted in "lost".
+     */
+    bool refill(std::size_t blockEntries) {
+      block.clear();
+      next = 0;
+      remainingAtBlock = remaining;
+      blockStart = file.tellg();
+      while (remaining > 0 && block.size() < blockEntries) {
+        Entry entry;
+        if (!file.read(reinterpret_cast<char*>(&entry.first), sizeof(Priority)) ||
+            !Serializer::read(file, entry.second)) {
+          lost += remaining;
+          remaining = 0;
+          break;
+        }
+        block.push_back(std::move(entry));
+        remaining--;
+      }
+      return !block.empty();
+    }
+
+    /*
+     * Moves past the front entry, reading the next block if need be.
+     * Returns false if the run is used up.
+     */
+    bool advance(std::size_t blockEntries) {
+      next++;
+      return next < block.size() || refill(blockEntries);
+    }
+
+    /*
+     * Returns how far through the run reading has got.
+     */
+    Mark mark() const {
+      Mark where;
+      where.blockStart = blockStart;
+      where.remainingAtBlock = remainingAtBlock;
+      where.next = next;
+      return where;
+    }
+
+    /*
+     * Puts the run back to "where", reading that block again unless it is
+     * still the one in memory. Anything that cannot be read again is
+     * counted in "lost". Returns false if nothing is left.
+     */
+    bool rewind(const Mark& where, std::size_t blockEntries) {
+      if (blockStart == where.blockStart && remainingAtBlock == where.remainingAtBlock) {
+        next = where.next;
+        return true;
+      }
+      std::uint64_t pending = where.remainingAtBlock;
+      file.clear();
+      file.seekg(where.blockStart);
+      remaining = where.remainingAtBlock;
+      if (!file || !refill(blockEntries)) {
+        lost = pending - where.next;
+        return false;
+      }
+      lost = pending - (block.size() + remaining);
+      if (block.size() <= where.next) {
+        lost = pending - where.next;
+        remaining = 0;
+        block.clear();
+        return false;
+      }
+      next = where.next;
+      return true;
+    }
+
+    /*
+     * Returns the entry at the front of the run.
+     */
+    Entry& front() {
+      return block[next];
+    }
+
+    const Entry& front() const {
+      return block[next];
+    }
+  };
+
+  /*
+   * Private helper method that writes one entry to a run file.
+   */
+  static void writeEntry(std::ostream& out, const Priority& priority, const E& element) {
+    out.write(reinterpret_cast<const char*>(&priority), sizeof(Priority));
+    Serializer::write(out, element);
+  }
+
+  /*
+   * Private helper method that returns a file name for a new run. The
+   * queue's address keeps the names of queues sharing a directory apart.
+   */
+  std::string nextRunPath() {
+    return directory + "/pq-run-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "-" +
+           std::to_string(runSerial++) + ".bin";
+  }
+
+  /*
+   * Private helper method that starts reading the run of "count" entries
+   * just written to "path" on level "level". Returns null, deleting the
+   * file, if it cannot be read back in full.
+   */
+  std::unique_ptr<Run> readRun(const std::string& path, std::uint64_t count, int level) {
+    std::unique_ptr<Run> run(new Run(path, count, level, blockBytes));
+    if (!run->file || !run->refill(blockEntries) || run->lost > 0) {
+      run->file.close();
+      std::remove(path.c_str());
+      run.reset();
+    }
+    return run;
+  }
+
+  /*
+   * Private helper method that puts "run" on the run heap, in the first
+   * free place in "runs".
+   */
+  void addRun(std::unique_ptr<Run> run) {
+    int index = 0;
+    while (index < (int)runs.size() && runs[index]) {
+      index++;
+    }
+    if (index == (int)runs.size()) {
+      runs.push_back(std::unique_ptr<Run>());
+    }
+    runHeads.insert(run->front().first, index);
+    runs[index] = std::move(run);
+    activeRuns++;
+  }
+
+  /*
+   * Private helper method that closes and deletes run "index" once it is
+   * off the run heap.
+   */
+  void retireRun(int index) {
+    runs[index]->file.close();
+    std::remove(runs[index]->path.c_str());
+    runs[index].reset();
+    activeRuns--;
+  }
+
+  /*
+   * Private helper method that takes any entries run "index" has lost out
+   * of the count, and notes the error.
+   */
+  void noteLoss(int index) {
+    Run& run = *runs[index];
+    if (run.lost > 0) {
+      count -= run.lost;
+      run.lost = 0;
+      failed = true;
+    }
+  }
+
+  /*
+   * Private helper method that hands out the front of run "index" and moves
+   * the run on, refilling its block and deleting the run once it is used up.
+   */
+  Entry takeFromRun(int index) {
+    Run& run = *runs[index];
+    Entry entry = std::move(run.front());
+    bool more = run.advance(blockEntries);
+    noteLoss(index);
+    if (more) {
+      runHeads.insert(run.front().first, index);
+    }
+    else {
+      retireRun(index);
+    }
+    return entry;
+  }
+
+  /*
+   * Private helper method that drains the insertion buffer to a new sorted
+   * run on level 0. Returns false if the run could not be written, in which
+   * case the buffer is left as it was.
+   */
+  bool spill() {
+    std::string path = nextRunPath();
+    std::vector<char> writeBuffer(blockBytes);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(&writeBuffer[0], writeBuffer.size());
+    out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) {
+      failed = true;
+      return false;
+    }
+
+    // The sorted iterator writes the run without emptying the buffer, so a
+    // failed write loses nothing
+    std::uint64_t written = 0;
+    typename Buffer::SortedIterator end = buffer.sorted_end();
+    for (typename Buffer::SortedIterator it = buffer.sorted_begin(); it != end; ++it) {
+      writeEntry(out, it.priority(), *it);
+      written++;
+    }
+    out.close();
+    std::unique_ptr<Run> run;
+    if (out) {
+      run = readRun(path, written, 0);
+    }
+    if (!run) {
+      std::remove(path.c_str());
+      failed = true;
+      return false;
+    }
+
+    entriesWritten += written;
+    addRun(std::move(run));
+    buffer = Buffer(compare);
+    buffer.reserve(bufferCapacity);
+    for (int level = 0; runsOn(level) >= fanoutRuns && mergeLevel(level); level++) {
+    }
+    return true;
+  }
+
+  /*
+   * Private helper method that returns how many runs are on level "level".
+   */
+  int runsOn(int level) const {
+    int found = 0;
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      if (runs[i] && runs[i]->level == level) {
+        found++;
+      }
+    }
+    return found;
+  }
+
+  /*
+   * Private helper method that merges every run on level "level" into a
+   * single run on the level above, with one sequential pass over each.
+   * The merged run is written and opened before anything is let go of. If
+   * that fails, the runs are put back as they were and false is returned.
+   */
+  bool mergeLevel(int level) {
+    std::vector<int> members;
+    std::vector<Mark> marks;
+    PriorityQueue<int, 2, Priority, Compare> heads(compare);
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      if (runs[i] && runs[i]->level == level) {
+        members.push_back(i);
+        marks.push_back(runs[i]->mark());
+        heads.insert(runs[i]->front().first, i);
+      }
+    }
+
+    std::string path = nextRunPath();
+    std::vector<char> writeBuffer(blockBytes);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(&writeBuffer[0], writeBuffer.size());
+    out.open(path.c_str(), std::ios::binary | std::ios::trunc);
+
+    std::uint64_t written = 0;
+    bool readable = true;
+    while (out && readable && !heads.empty()) {
+      int index = heads.pop();
+      Run& run = *runs[index];
+      writeEntry(out, run.front().first, run.front().second);
+      written++;
+      if (run.advance(blockEntries)) {
+        heads.insert(run.front().first, index);
+      }
+      readable = run.lost == 0;
+    }
+    out.close();
+
+    std::unique_ptr<Run> merged;
+    if (out && readable) {
+      merged = readRun(path, written, level + 1);
+    }
+    if (!merged) {
+      std::remove(path.c_str());
+      restoreRuns(members, marks);
+      failed = true;
+      return false;
+    }
+
+    // Only now are the merged runs let go of
+    std::vector<bool> gone(runs.size(), false);
+    for (std::size_t i = 0; i < members.size(); i++) {
+      gone[members[i]] = true;
+      retireRun(members[i]);
+    }
+    runHeads.erase_if([&gone](int index) { return gone[index]; });
+    entriesWritten += written;
+    addRun(std::move(merged));
+    return true;
+  }
+
+  /*
+   * Private helper method that puts the runs in "members" back to "marks"
+   * after an abandoned merge. Their fronts are the same as before, so the
+   * run heap is still right, except for runs that can no longer be read.
+   */
+  void restoreRuns(const std::vector<int>& members, const std::vector<Mark>& marks) {
+    std::vector<bool> gone(runs.size(), false);
+    bool anyGone = false;
+    for (std::size_t i = 0; i < members.size(); i++) {
+      bool left = runs[members[i]]->rewind(marks[i], blockEntries);
+      noteLoss(members[i]);
+      if (!left) {
+        gone[members[i]] = true;
+        anyGone = true;
+        retireRun(members[i]);
+      }
+    }
+    if (anyGone) {
+      runHeads.erase_if([&gone](int index) { return gone[index]; });
+    }
+  }
+
+  /*
+   * Private helper method that returns true if the front of the insertion
+   * buffer should come out before the front of the best run.
+   */
+  bool bufferFirst() const {
+    if (runHeads.empty()) {
+      return true;
+    }
+    if (buffer.empty()) {
+      return false;
+    }
+    return !compare(runHeads.peek_priority(), buffer.peek_priority());
+  }
+
+  typedef PriorityQueue<E, 2, Priority, Compare> Buffer;
+
+  // Where run files go, and a counter to name them by
+  std::string directory;
+  std::uint64_t runSerial;
+
+  // The in-memory insertion buffer
+  Buffer buffer;
+
+  // Runs on disk, with finished ones left as null for reuse, and a heap of
+  // run indexes ordered by the priority at their front
+  std::vector<std::unique_ptr<Run> > runs;
+  PriorityQueue<int, 2, Priority, Compare> runHeads;
+  int activeRuns;
+
+  // How the memory budget is shared out
+  std::size_t memoryBudget;
+  std::size_t blockBytes;
+  std::size_t bufferCapacity;
+  std::size_t blockEntries;
+  int fanoutRuns;
+
+  // Number of elements in the buffer and the runs together
+  std::uint64_t count;
+
+  // Entries written to run files so far, by spills and merges
+  std::uint64_t entriesWritten;
+
+  // Whether any run file has failed to be written or read
+  bool failed;
+
+  Compare compare;
+
+public:
+
+  /*
+   * Constructor that takes the directory to write runs to, the memory
+   * budget in bytes, and how many bytes each run reads at a time.
+   */
+  explicit ExternalPriorityQueue(const std::string& newDirectory, std::size_t newMemoryBudget = 64 << 20,
+                                 std::size_t newBlockBytes = 1 << 20, const Compare& newCompare = Compare())
+    : directory(newDirectory), runSerial(0), runHeads(newCompare), activeRuns(0),
+      memoryBudget(newMemoryBudget), count(0), entriesWritten(0), failed(false), compare(newCompare) {
+    std::size_t entryBytes = sizeof(Entry);
+    blockBytes = newBlockBytes < entryBytes ? entryBytes : newBlockBytes;
+    bufferCapacity = memoryBudget / 2 / entryBytes;
+    if (bufferCapacity < 1) {
+      bufferCapacity = 1;
+    }
+    blockEntries = blockBytes / entryBytes;
+    std::size_t runBudget = memoryBudget / 2 / (blockBytes * 2) / 4;
+    fanoutRuns = runBudget < 2 ? 2 : int(runBudget);
+    buffer = Buffer(newCompare);
+    buffer.reserve(bufferCapacity);
+  }
+
+  // Run files belong to one queue, so it can be neither copied nor moved
+  ExternalPriorityQueue(const ExternalPriorityQueue&) = delete;
+  ExternalPriorityQueue& operator=(const ExternalPriorityQueue&) = delete;
+
+  /*
+   * Destructor that deletes any run files left.
+   */
+  ~ExternalPriorityQueue() {
+    for (std::size_t i = 0; i < runs.size(); i++) {
+      if (runs[i]) {
+        runs[i]->file.close();
+        std::remove(runs[i]->path.c_str());
+      }
+    }
+  }
+
+  /*
+   * This function adds a new element "element" to the queue with priority
+   * "priority". Returns false if the priority was rejected, or if the
+   * buffer was full and could not be written out to disk.
+   */
+  bool insert(const Priority& priority, const E& element) {
+    return insert(priority, E(element));
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of copying it.
+   */
+  bool insert(const Priority& priority, E&& element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return false;
+    }
+    if (buffer.size() >= (int)bufferCapacity && !spill()) {
+      return false;
+    }
+    buffer.insert(priority, std::move(element));
+    count++;
+    return true;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue, and returns it.
+   */
+  E remove_front() {
+    if (!empty()) {
+      return pop();
+    }
+    return E();
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves it out.
+   * The queue must not be empty.
+   */
+  E pop() {
+    count--;
+    if (bufferFirst()) {
+      return buffer.pop();
+    }
+    return takeFromRun(runHeads.pop()).second;
+  }
+
+  /*
+   * Returns the lowest priority value element in the queue, but leaves it
+   * in the queue. The queue must not be empty.
+   */
+  const E& peek() const {
+    if (bufferFirst()) {
+      return buffer.peek();
+    }
+    return runs[runHeads.peek()]->front().second;
+  }
+
+  /*
+   * Returns the priority of the element peek() would return.
+   * The queue must not be empty.
+   */
+  Priority peek_priority() const {
+    if (bufferFirst()) {
+      return buffer.peek_priority();
+    }
+    return runHeads.peek_priority();
+  }
+
+  /*
+   * Returns the number of elements in the queue, in memory and on disk.
+   */
+  std::uint64_t size() const {
+    return count;
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  bool empty() const {
+    return count == 0;
+  }
+
+  /*
+   * Returns the number of sorted runs on disk.
+   */
+  int run_count() const {
+    return activeRuns;
+  }
+
+  /*
+   * Returns how many runs a level holds before they are merged into one run
+   * on the level above.
+   */
+  int fanout() const {
+    return fanoutRuns;
+  }
+
+  /*
+   * Returns how many entries have been written to run files so far, by
+   * spills and merges together.
+   */
+  std::uint64_t entries_written() const {
+    return entriesWritten;
+  }
+
+  /*
+   * Returns true if a run file has failed to be written or read since the
+   * queue was made. See the class comment for what that costs.
+   */
+  bool io_error() const {
+    return failed;
+  }
+
+  /*
+   * Returns how many elements the insertion buffer holds before it spills.
+   */
+  std::size_t buffer_capacity() const {
+    return bufferCapacity;
+  }
+
+  /*
+   * Returns the memory budget in bytes.
+   */
+  std::size_t memory_budget() const {
+    return memoryBudget;
+  }
+
+};
+
+#endif
@@ -0,0 +1,216 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+
+#include "ExternalPriorityQueue.h"
+
+class ExternalPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  /*
+   * Counts the run files in "directory".
+   */
+  int count_runs(const std::string& directory){
+
+    int runs = 0;
+    DIR* dir = opendir(directory.c_str());
+    for (dirent* entry = readdir(dir); entry != 0; entry = readdir(dir)){
+
+      if (std::string(entry->d_name).compare(0, 7, "pq-run-") == 0) runs++;
+
+    }
+    closedir(dir);
+    return runs;
+
+  }
+
+  void testSpillsAndRemovesInPriorityOrder(){
+
+    // Room for 64 ints in memory, and blocks of 8
+    ExternalPriorityQueue<int> pq("/tmp", 1024, 64);
+    TS_ASSERT_EQUALS(pq.buffer_capacity(), 64);
+
+    for (int i = 0; i < 5000; i++){
+
+      TS_ASSERT(pq.insert((i * 7919) % 5000, (i * 7919) % 5000));
+
+    }
+
+    TS_ASSERT(!pq.insert(-1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 5000);
+    TS_ASSERT(pq.run_count() > 0);
+
+    // 78 spills with a fanout of 2 leave at most one run on each of 7
+    // levels, and each element has been written once per level at most
+    TS_ASSERT_EQUALS(pq.fanout(), 2);
+    TS_ASSERT(pq.run_count() <= 7);
+    TS_ASSERT(pq.entries_written() <= 5000 * 7);
+    TS_ASSERT(!pq.io_error());
+    TS_ASSERT_EQUALS(pq.peek(), 0);
+
+    for (int i = 0; i < 5000; i++){
+
+      TS_ASSERT_EQUALS(pq.peek_priority(), i);
+      TS_ASSERT_EQUALS(pq.remove_front(), i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.run_count(), 0);
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testStringPayloads(){
+
+    ExternalPriorityQueue<std::string> pq("/tmp", 4096, 256);
+
+    for (int i = 0; i < 2000; i++){
+
+      pq.insert(i % 100, "element " + std::to_string(i));
+
+    }
+
+    int last = -1;
+    int count = 0;
+    while (!pq.empty()){
+
+      int priority = pq.peek_priority();
+      std::string element = pq.pop();
+      TS_ASSERT(last <= priority);
+      TS_ASSERT_EQUALS(std::atoi(element.c_str() + 8) % 100, priority);
+      last = priority;
+      count++;
+
+    }
+    TS_ASSERT_EQUALS(count, 2000);
+
+  }
+
+  void testInterleavedMatchesPriorityQueue(){
+
+    ExternalPriorityQueue<int> external("/tmp", 512, 32);
+    PriorityQueue<int> reference;
+
+    for (int i = 0; i < 20000; i++){
+
+      if (rand() % 3 != 0 || reference.empty()){
+
+	int priority = rand() % 1000;
+	external.insert(priority, priority);
+	reference.insert(priority, priority);
+
+      }
+      else{
+
+	TS_ASSERT_EQUALS(external.peek_priority(), reference.peek_priority());
+	TS_ASSERT_EQUALS(external.pop(), reference.pop());
+
+      }
+
+    }
+    TS_ASSERT_EQUALS(external.size(), reference.size());
+
+    while (!reference.empty()){
+
+      TS_ASSERT_EQUALS(external.pop(), reference.pop());
+
+    }
+    TS_ASSERT(external.empty());
+
+  }
+
+  void testRunFilesAreDeleted(){
+
+    int before = count_runs("/tmp");
+    {
+      ExternalPriorityQueue<int> pq("/tmp", 256, 32);
+      for (int i = 0; i < 1000; i++){
+
+	pq.insert(i, i);
+
+      }
+      TS_ASSERT(count_runs("/tmp") > before);
+      TS_ASSERT_EQUALS(count_runs("/tmp") - before, pq.run_count());
+    }
+    TS_ASSERT_EQUALS(count_runs("/tmp"), before);
+
+  }
+
+  void testUnwritableDirectory(){
+
+    ExternalPriorityQueue<int> pq("/tmp/no/such/directory", 64, 8);
+    int accepted = 0;
+    for (int i = 0; i < 100; i++){
+
+      if (pq.insert(i, i)) accepted++;
+
+    }
+
+    // Inserts fail once the buffer is full, and nothing is lost
+    TS_ASSERT_EQUALS(accepted, pq.buffer_capacity());
+    TS_ASSERT_EQUALS(pq.size(), accepted);
+    TS_ASSERT(pq.io_error());
+    TS_ASSERT_EQUALS(pq.pop(), 0);
+
+  }
+
+  void testTruncatedRunsAreReported(){
+
+    ExternalPriorityQueue<int> pq("/tmp", 1024, 64);
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert((i * 7919) % 1000, i);
+
+    }
+
+    // Cut every run file short, losing all but the blocks in memory
+    std::string prefix = "pq-run-" + std::to_string(reinterpret_cast<std::uintptr_t>(&pq)) + "-";
+    DIR* dir = opendir("/tmp");
+    for (dirent* entry = readdir(dir); entry != 0; entry = readdir(dir)){
+
+      if (std::string(entry->d_name).compare(0, prefix.size(), prefix) == 0){
+
+	std::ofstream(std::string("/tmp/") + entry->d_name, std::ios::binary | std::ios::trunc);
+
+      }
+
+    }
+    closedir(dir);
+
+    // More spills, so merges have to read the cut runs too
+    for (int i = 0; i < 300; i++){
+
+      TS_ASSERT(pq.insert(1000 + i, i));
+
+    }
+    TS_ASSERT(pq.io_error());
+
+    std::uint64_t popped = 0;
+    int last = -1;
+    while (!pq.empty()){
+
+      std::uint64_t size = pq.size();
+      int priority = pq.peek_priority();
+      pq.pop();
+      TS_ASSERT(last <= priority);
+      TS_ASSERT(pq.size() < size);
+      last = priority;
+      popped++;
+
+    }
+    TS_ASSERT(popped < 1300);
+    TS_ASSERT(popped >= 300);
+    TS_ASSERT_EQUALS(pq.run_count(), 0);
+
+  }
+
+};
@@ -0,0 +1,515 @@
+#ifndef _LOCK_FREE_PR_QUEUE_H
+#define _LOCK_FREE_PR_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a lock-free concurrent priority queue as a skiplist,
+ * in the style of Linden and Jonsson.
+ * Elements are kept in priority order in the bottom list of the skiplist, so
+ * the front of the queue is the first node that has not been taken yet.
+ * Removing the front is split in two. First a node is logically deleted by
+ * marking it taken, which needs one atomic exchange and never touches the
+ * index levels. Then, only once a removal has had to skip over "cleanupOffset"
+ * taken nodes, the whole taken prefix is unlinked in one pass. Batching the
+ * physical deletes keeps removals from fighting over the head of the list.
+ * No operation ever waits on another thread, so a thread that is descheduled
+ * midway cannot hold the others up.
+ * Unlinked nodes are freed with epoch-based reclamation: a node is only
+ * deleted once every operation that could still be looking at it has finished.
+ * Each remove is exact against the elements present when it reaches them,
+ * but an element inserted ahead of a removal already walking the list can be
+ * passed over, so the order is quiescently consistent rather than
+ * linearizable. Equal priorities come out first in, first out.
+ * Elements are copied out rather than moved, since peek() may be reading an
+ * element at the same moment another thread removes it.
+ * The Priority and Compare template parameters are the same as for
+ * PriorityQueue.
+ */
+template <typename E, typename Priority = int, typename Compare = std::less<Priority> >
+class LockFreePriorityQueue {
+
+private:
+
+  // Highest index level a node can reach
+  static const int MAX_LEVEL = 24;
+
+  // Retired nodes a participant collects before trying to free them
+  static const std::size_t RETIRE_BATCH = 64;
+
+  // Epoch announced by a participant that is not in an operation
+  static const std::uint64_t QUIESCENT = UINT64_MAX;
+
+  /*
+   * Class for a skiplist node. The lowest bit of each next pointer is a
+   * deletion mark; a node whose level 0 pointer is marked is on its way out.
+   * The priority, sequence number and element never change once the node is
+   * published, so any thread may read them while the node is alive.
+   */
+  class Node {
+  public:
+    Priority priority;
+    std::uint64_t sequence;
+    E element;
+    int topLevel;
+
+    // Set by the remove that claims this node
+    std::atomic<bool> taken;
+
+    // Levels the node is linked into, plus one while its insert is running
+    std::atomic<int> references;
+
+    std::unique_ptr<std::atomic<std::uintptr_t>[]> next;
+
+    /*
+     * Node constructor with no links yet.
+     */
+    Node(const Priority& newPriority, std::uint64_t newSequence, E newElement, int newTopLevel)
+      : priority(newPriority), sequence(newSequence), element(std::move(newElement)),
+        topLevel(newTopLevel), taken(false), references(1),
+        next(new std::atomic<std::uintptr_t>[newTopLevel + 1]) {
+      for (int level = 0; level <= topLevel; level++) {
+        next[level].store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  /*
+   * Class for a reclamation participant. A thread claims one for the length
+   * of each operation, announces the epoch it started in, and parks nodes it
+   * unlinked in "retired" until no operation can still reach them.
+   * Participants are never freed before the queue, so the list of them only
+   * grows, up to the most threads that were ever inside the queue at once.
+   */
+  class Participant {
+  public:
+    std::atomic<bool> claimed;
+    std::atomic<std::uint64_t> epoch;
+    std::vector<std::pair<std::uint64_t, Node*> > retired;
+    Participant* nextParticipant;
+
+    /*
+     * Participant constructor that starts out claimed by its creator.
+     */
+    Participant() : claimed(true), epoch(QUIESCENT), nextParticipant(0) {
+    }
+  };
+
+  /*
+   * Private helper methods for the marked next pointers.
+   */
+  static Node* pointer(std::uintptr_t link) {
+    return reinterpret_cast<Node*>(link & ~std::uintptr_t(1));
+  }
+
+  static std::uintptr_t link(Node* node) {
+    return reinterpret_cast<std::uintptr_t>(node);
+  }
+
+  static bool isMarked(std::uintptr_t link) {
+    return (link & 1) != 0;
+  }
+
+  /*
+   * Private helper method that returns a random top level for a new node,
+   * each level half as likely as the one below, using a per-thread xorshift
+   * generator so threads never share random state.
+   */
+  static int randomLevel() {
+    static thread_local std::uint64_t state =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    int level = 0;
+    std::uint64_t bits = state;
+    while (level < MAX_LEVEL - 1 && (bits & 1)) {
+      level++;
+      bits >>= 1;
+    }
+    return level;
+  }
+
+  /*
+   * Private helper method that returns true if "node" comes before the key
+   * made of "priority" and "sequence".
+   */
+  bool keyBefore(const Node* node, const Priority& priority, std::uint64_t sequence) const {
+    if (compare(node->priority, priority)) {
+      return true;
+    }
+    return !compare(priority, node->priority) && node->sequence < sequence;
+  }
+
+  /*
+   * Private helper method that claims a participant for the calling thread
+   * and announces the current epoch. A new participant is added when every
+   * existing one is in use, so this never waits.
+   */
+  Participant* enter() {
+    Participant* participant = participants.load();
+    for (; participant != 0; participant = participant->nextParticipant) {
+      bool expected = false;
+      if (!participant->claimed.load(std::memory_order_relaxed) &&
+          participant->claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        break;
+      }
+    }
+
+    if (participant == 0) {
+      participant = new Participant();
+      participant->nextParticipant = participants.load();
+      while (!participants.compare_exchange_weak(participant->nextParticipant, participant)) {
+      }
+    }
+
+    participant->epoch.store(globalEpoch.load());
+    return participant;
+  }
+
+  /*
+   * Private helper method that ends an operation, frees whatever retired
+   * nodes have become safe, and hands the participant back.
+   */
+  void exit(Participant* participant) {
+    participant->epoch.store(QUIESCENT);
+
+    if (participant->retired.size() >= RETIRE_BATCH) {
+      tryAdvance();
+      freeRetired(participant);
+    }
+
+    participant->claimed.store(false, std::memory_order_release);
+  }
+
+  /*
+   * Private helper method that moves the global epoch on by one if every
+   * participant that is in an operation has seen the current one.
+   */
+  void tryAdvance() {
+    std::uint64_t epoch = globalEpoch.load();
+    for (Participant* other = participants.load(); other != 0; other = other->nextParticipant) {
+      std::uint64_t announced = other->epoch.load();
+      if (announced != QUIESCENT && announced != epoch) {
+        return;
+      }
+    }
+    globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+  }
+
+  /*
+   * Private helper method that deletes the nodes "participant" retired at
+   * least two epochs ago. Every operation that started before such a node was
+   * unlinked has finished by then.
+   */
+  void freeRetired(Participant* participant) {
+    std::uint64_t epoch = globalEpoch.load();
+    std::vector<std::pair<std::uint64_t, Node*> >& retired = participant->retired;
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < retired.size(); i++) {
+      if (retired[i].first + 2 <= epoch) {
+        delete retired[i].second;
+      }
+      else {
+        retired[kept++] = retired[i];
+      }
+    }
+    retired.resize(kept);
+  }
+
+  /*
+   * Private helper method called each time "node" is unlinked from a level.
+   * Retires it once it is linked nowhere and its insert has finished.
+   */
+  void release(Node* node, Participant* participant) {
+    if (node->references.fetch_sub(1) == 1) {
+      participant->retired.push_back(std::make_pair(globalEpoch.load(), node));
+    }
+  }
+
+  /*
+   * Private helper method that fills "preds" and "succs" with, on every level,
+   * the last node before the given key and the node after it. Marked nodes
+   * met on the way are unlinked.
+   */
+  void find(const Priority& priority, std::uint64_t sequence, Node** preds, Node** succs,
+            Participant* participant) {
+    bool restart = true;
+    while (restart) {
+      restart = false;
+      Node* pred = head;
+
+      for (int level = MAX_LEVEL - 1; level >= 0 && !restart; level--) {
+        Node* curr = pointer(pred->next[level].load());
+        while (curr != 0) {
+          std::uintptr_t succ = curr->next[level].load();
+
+          // Unlink a deleted node, or start over if "pred" changed under us
+          if (isMarked(succ)) {
+            std::uintptr_t expected = link(curr);
+            if (!pred->next[level].compare_exchange_strong(expected, link(pointer(succ)))) {
+              restart = true;
+              break;
+            }
+            release(curr, participant);
+            curr = pointer(succ);
+            continue;
+          }
+
+          if (!keyBefore(curr, priority, sequence)) {
+            break;
+          }
+          pred = curr;
+          curr = pointer(succ);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+      }
+    }
+  }
+
+  /*
+   * Private helper method that marks every level of "node", top down, so
+   * later finds unlink it and no insert can link after it.
+   */
+  static void markNode(Node* node) {
+    for (int level = node->topLevel; level >= 0; level--) {
+      std::uintptr_t succ = node->next[level].load();
+      while (!isMarked(succ) && !node->next[level].compare_exchange_weak(succ, succ | 1)) {
+      }
+    }
+  }
+
+  // The skiplist, starting at a sentinel that is on every level
+  Node* head;
+
+  // Every participant that has used the queue
+  std::atomic<Participant*> participants;
+  std::atomic<std::uint64_t> globalEpoch;
+
+  // Gives equal priorities their insertion order
+  std::atomic<std::uint64_t> sequence;
+
+  // Number of elements, counted when inserted and when taken
+  std::atomic<int> count;
+
+  // Taken nodes a remove may skip before it unlinks them
+  int cleanupOffset;
+
+  Compare compare;
+
+public:
+
+  /*
+   * Constructor that takes how many taken nodes may build up at the front
+   * before a remove unlinks them. Larger values mean fewer, longer cleanups.
+   */
+  explicit LockFreePriorityQueue(int newCleanupOffset = 32)
+    : head(new Node(Priority(), 0, E(), MAX_LEVEL - 1)), participants(0), globalEpoch(0),
+      sequence(0), count(0), cleanupOffset(std::max(1, newCleanupOffset)) {
+  }
+
+  /*
+   * Destructor that frees every node, linked or retired. No other thread may
+   * be using the queue.
+   */
+  ~LockFreePriorityQueue() {
+    std::vector<Node*> nodes;
+    for (int level = 0; level < MAX_LEVEL; level++) {
+      for (Node* node = pointer(head->next[level].load()); node != 0; node = pointer(node->next[level].load())) {
+        nodes.push_back(node);
+      }
+    }
+
+    Participant* participant = participants.load();
+    while (participant != 0) {
+      for (std::size_t i = 0; i < participant->retired.size(); i++) {
+        nodes.push_back(participant->retired[i].second);
+      }
+      Participant* next = participant->nextParticipant;
+      delete participant;
+      participant = next;
+    }
+
+    // A node with several levels was seen once on each of them
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    for (std::size_t i = 0; i < nodes.size(); i++) {
+      delete nodes[i];
+    }
+    delete head;
+  }
+
+  LockFreePriorityQueue(const LockFreePriorityQueue&) = delete;
+  LockFreePriorityQueue& operator=(const LockFreePriorityQueue&) = delete;
+
+  /*
+   * This function adds a new element "element" to the queue with priority
+   * "priority". Returns false if the priority was rejected.
+   */
+  bool insert(const Priority& priority, E element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return false;
+    }
+
+    Node* node = new Node(priority, sequence.fetch_add(1), std::move(element), randomLevel());
+    Node* preds[MAX_LEVEL];
+    Node* succs[MAX_LEVEL];
+    Participant* participant = enter();
+
+    // Counted first so a remove that wins the race never sees a negative size
+    count.fetch_add(1);
+
+    // Linking the bottom level is what puts the element in the queue. Each
+    // link is counted before it is made, since it can be unlinked at once
+    node->references.fetch_add(1);
+    while (true) {
+      find(priority, node->sequence, preds, succs, participant);
+      node->next[0].store(link(succs[0]), std::memory_order_relaxed);
+      std::uintptr_t expected = link(succs[0]);
+      if (preds[0]->next[0].compare_exchange_strong(expected, link(node))) {
+        break;
+      }
+    }
+
+    // The index levels are only shortcuts, so give up on them if the node is
+    // taken in the meantime
+    Node* deletedSuccessor = 0;
+    for (int level = 1; level <= node->topLevel; level++) {
+      bool linked = false;
+      while (true) {
+        std::uintptr_t own = node->next[level].load();
+        if (isMarked(own) ||
+            !node->next[level].compare_exchange_strong(own, link(succs[level]))) {
+          break;
+        }
+        std::uintptr_t expected = link(succs[level]);
+        node->references.fetch_add(1);
+        if (preds[level]->next[level].compare_exchange_strong(expected, link(node))) {
+          linked = true;
+          break;
+        }
+        node->references.fetch_sub(1);
+        find(priority, node->sequence, preds, succs, participant);
+      }
+      if (!linked) {
+        break;
+      }
+
+      // A successor deleted while this level was linked is now only reachable
+      // through this node, so make sure it gets unlinked
+      if (succs[level] != 0 && isMarked(succs[level]->next[level].load())) {
+        deletedSuccessor = succs[level];
+      }
+    }
+
+    // Unlink this node again if it was taken while some levels went in late,
+    // along with any deleted successor it picked up
+    if (deletedSuccessor != 0) {
+      find(deletedSuccessor->priority, deletedSuccessor->sequence, preds, succs, participant);
+    }
+    else if (isMarked(node->next[0].load())) {
+      find(priority, node->sequence, preds, succs, participant);
+    }
+    release(node, participant);
+
+    exit(participant);
+    return true;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and copies it into
+   * "element". Returns false if no untaken element was found.
+   */
+  bool try_remove_front(E& element) {
+    if (count.load() == 0) {
+      return false;
+    }
+
+    Participant* participant = enter();
+
+    // Skip the taken prefix, claiming the first node nobody else has
+    int offset = 0;
+    Node* found = 0;
+    for (Node* curr = pointer(head->next[0].load()); curr != 0; curr = pointer(curr->next[0].load())) {
+      if (!curr->taken.load(std::memory_order_relaxed) && !curr->taken.exchange(true)) {
+        found = curr;
+        break;
+      }
+      offset++;
+    }
+
+    if (found != 0) {
+      element = found->element;
+      count.fetch_sub(1);
+      markNode(found);
+
+      // Unlink the whole taken prefix in one pass once it has grown long
+      if (offset >= cleanupOffset) {
+        Node* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        find(found->priority, found->sequence, preds, succs, participant);
+      }
+    }
+
+    exit(participant);
+    return found != 0;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and returns it,
+   * or returns E() if the queue is empty, like PriorityQueue::remove_front().
+   */
+  E remove_front() {
+    E element = E();
+    try_remove_front(element);
+    return element;
+  }
+
+  /*
+   * Returns a copy of the lowest priority value element, but leaves it in the
+   * queue. Returns E() if the queue is empty.
+   */
+  E peek() {
+    E element = E();
+    Participant* participant = enter();
+    for (Node* curr = pointer(head->next[0].load()); curr != 0; curr = pointer(curr->next[0].load())) {
+      if (!curr->taken.load()) {
+        element = curr->element;
+        break;
+      }
+    }
+    exit(participant);
+    return element;
+  }
+
+  /*
+   * Returns the number of elements in the queue. With other threads
+   * running this is only a snapshot.
+   */
+  int size() const {
+    return count.load();
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise. With other
+   * threads running this is only a snapshot.
+   */
+  bool empty() const {
+    return count.load() == 0;
+  }
+
+};
+
+#endif
@@ -0,0 +1,183 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include "LockFreePriorityQueue.h"
+
+/*
+ * Element type that counts how many copies of itself are alive, so tests can
+ * check that the queue frees every node it allocates.
+ */
+class Tracked {
+public:
+  static std::atomic<int> alive;
+  int value;
+
+  Tracked(int newValue = 0) : value(newValue) {
+    alive++;
+  }
+
+  Tracked(const Tracked& other) : value(other.value) {
+    alive++;
+  }
+
+  Tracked& operator=(const Tracked& other) {
+    value = other.value;
+    return *this;
+  }
+
+  ~Tracked() {
+    alive--;
+  }
+};
+
+std::atomic<int> Tracked::alive(0);
+
+class LockFreePriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testRemovesInPriorityOrder(){
+
+    LockFreePriorityQueue<int> pq;
+
+    for (int i = 0; i < 500; i++){
+
+      pq.insert((i * 37) % 500, (i * 37) % 500);
+
+    }
+
+    TS_ASSERT(!pq.insert(-1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 500);
+    TS_ASSERT_EQUALS(pq.peek(), 0);
+
+    for (int i = 0; i < 500; i++){
+
+      TS_ASSERT_EQUALS(pq.remove_front(), i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testEqualPrioritiesAreFifo(){
+
+    LockFreePriorityQueue<std::string> pq(4);
+
+    pq.insert(2, "c");
+    pq.insert(1, "a");
+    pq.insert(2, "d");
+    pq.insert(1, "b");
+
+    TS_ASSERT_EQUALS(pq.remove_front(), "a");
+    TS_ASSERT_EQUALS(pq.remove_front(), "b");
+    TS_ASSERT_EQUALS(pq.remove_front(), "c");
+    TS_ASSERT_EQUALS(pq.remove_front(), "d");
+
+  }
+
+  void testInterleavedInsertAndRemove(){
+
+    LockFreePriorityQueue<int> pq(8);
+    std::vector<int> expected;
+
+    for (int round = 0; round < 50; round++){
+
+      for (int i = 0; i < 20; i++){
+
+	int priority = rand()%1000;
+	pq.insert(priority, priority);
+
+      }
+
+      // Smaller priorities than what was already removed can still arrive
+      int last = -1;
+      for (int i = 0; i < 10; i++){
+
+	int element = pq.remove_front();
+	TS_ASSERT(last <= element);
+	last = element;
+
+      }
+
+    }
+
+    TS_ASSERT_EQUALS(pq.size(), 500);
+
+  }
+
+  void testFreesEveryNode(){
+
+    {
+      LockFreePriorityQueue<Tracked> pq(4);
+
+      for (int i = 0; i < 2000; i++){
+
+	pq.insert(i % 100, Tracked(i));
+
+      }
+
+      for (int i = 0; i < 1500; i++){
+
+	pq.remove_front();
+
+      }
+
+      // Cleanup and reclamation keep removed nodes from piling up
+      TS_ASSERT_LESS_THAN(Tracked::alive.load(), 1000);
+
+    }
+
+    TS_ASSERT_EQUALS(Tracked::alive.load(), 0);
+
+  }
+
+  void testConcurrentInsertAndRemove(){
+
+    LockFreePriorityQueue<int> pq;
+    std::vector<std::atomic<int> > seen(16000);
+    std::atomic<int> removed(0);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++){
+
+      threads.push_back(std::thread([&pq, t](){
+	for (int i = 0; i < 4000; i++){
+	  pq.insert(i % 50, t * 4000 + i);
+	}
+      }));
+      threads.push_back(std::thread([&](){
+	int element;
+	while (removed.load() < 16000){
+	  if (pq.try_remove_front(element)){
+	    seen[element]++;
+	    removed++;
+	  }
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    TS_ASSERT(pq.empty());
+
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i].load(), 1);
+
+    }
+
+  }
+
+};
@@ -0,0 +1,533 @@
+#ifndef _MIN_MAX_PR_QUEUE_H
+#define _MIN_MAX_PR_QUEUE_H
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a double-ended priority queue as a min-max heap,
+ * for when both the lowest and the highest priority value elements are
+ * wanted, such as for a rate limiter that serves the earliest deadline and
+ * sheds the latest.
+ * The heap is one array whose levels alternate: a node on an even level
+ * (the root's) is no bigger than anything below it, and a node on an odd
+ * level is no smaller. So the lowest priority is at the root and the
+ * highest is one of its two children, both peeks are O(1), and insert(),
+ * both pops, erase() and change_priority() are O(log n), with one copy of
+ * each element and no second queue to keep in step.
+ * The rest of the interface matches PriorityQueue's, with handles that
+ * stay valid while their element is in the queue.
+ * The template parameters are as for PriorityQueue, except that a min-max
+ * heap is always binary.
+ */
+template <typename E, typename Priority = int, typename Compare = std::less<Priority> >
+class MinMaxPriorityQueue {
+
+private:
+
+  /*
+   * Class for one node of the heap.
+   */
+  class Node {
+  public:
+    Priority priority;
+    E element;
+
+    // Handle slot the node owns
+    int slot;
+
+    /*
+     * Node constructor that takes everything the node holds.
+     */
+    Node(const Priority& newPriority, E&& newElement, int newSlot)
+      : priority(newPriority), element(std::move(newElement)), slot(newSlot) {
+    }
+  };
+
+  /*
+   * Private helper method that returns true if heap index "index" is on a
+   * min level, that is an even depth from the root.
+   */
+  static bool onMinLevel(int index) {
+    int depth = 0;
+    for (int n = index + 1; n > 1; n /= 2) {
+      depth++;
+    }
+    return depth % 2 == 0;
+  }
+
+  /*
+   * Private helper method that returns true if the node at "a" belongs
+   * nearer the root than the node at "b" on a min level (if "minLevel" is
+   * set) or a max level.
+   */
+  bool beats(int a, int b, bool minLevel) const {
+    if (minLevel) {
+      return compare(nodes[a].priority, nodes[b].priority);
+    }
+    return compare(nodes[b].priority, nodes[a].priority);
+  }
+
+  /*
+   * Private helper method that swaps the nodes at "a" and "b", keeping
+   * the handle slots pointing at them.
+   */
+  void swapNodes(int a, int b) {
+    std::swap(nodes[a], nodes[b]);
+    slotPositions[nodes[a].slot] = a;
+    slotPositions[nodes[b].slot] = b;
+  }
+
+  /*
+   * Private trickleDown method that moves the node at "index" down while
+   * one of its children or grandchildren belongs above it. A node moved
+   * down to a grandchild is also checked against its new parent, which is
+   * on the other kind of level, and whichever of the two ends up at the
+   * grandchild carries on down.
+   */
+  void trickleDown(int index) {
+    bool minLevel = onMinLevel(index);
+    int count = nodes.size();
+    while (true) {
+      int child = 2 * index + 1;
+      if (child >= count) {
+        break;
+      }
+
+      // The best of up to two children and four grandchildren
+      int best = child;
+      int candidates[] = {child + 1, 2 * child + 1, 2 * child + 2, 2 * child + 3, 2 * child + 4};
+      for (int k = 0; k < 5 && candidates[k] < count; k++) {
+        if (beats(candidates[k], best, minLevel)) {
+          best = candidates[k];
+        }
+      }
+      if (!beats(best, index, minLevel)) {
+        break;
+      }
+
+      swapNodes(best, index);
+      if (best <= child + 1) {
+        return;
+      }
+      int parent = (best - 1) / 2;
+      if (beats(parent, best, minLevel)) {
+        swapNodes(best, parent);
+      }
+      index = best;
+    }
+  }
+
+  /*
+   * Private bubbleUp method that moves the node at "index" up. If it
+   * belongs on the other side of its parent it swaps with it first, and
+   * then it climbs one grandparent at a time along its own kind of level.
+   */
+  void bubbleUp(int index) {
+    if (index == 0) {
+      return;
+    }
+    bool minLevel = onMinLevel(index);
+    int parent = (index - 1) / 2;
+    if (beats(parent, index, minLevel)) {
+      swapNodes(index, parent);
+      index = parent;
+      minLevel = !minLevel;
+    }
+    while (index > 2) {
+      int grandparent = ((index - 1) / 2 - 1) / 2;
+      if (!beats(index, grandparent, minLevel)) {
+        break;
+      }
+      swapNodes(index, grandparent);
+      index = grandparent;
+    }
+  }
+
+  /*
+   * Private helper method that puts the node at "index" back in place
+   * after it has been replaced or given a new priority. Bubbling up first
+   * moves it above any ancestor it beats; if it swapped with its parent,
+   * the parent's node now at "index" is too big (or small) for its new
+   * level, and trickling down settles whichever node is left there.
+   */
+  void restore(int index) {
+    bubbleUp(index);
+    trickleDown(index);
+  }
+
+  /*
+   * Private helper method that returns the heap index of the highest
+   * priority value node. The queue must not be empty.
+   */
+  int maxIndex() const {
+    if (nodes.size() == 1) {
+      return 0;
+    }
+    if (nodes.size() == 2 || !compare(nodes[1].priority, nodes[2].priority)) {
+      return 1;
+    }
+    return 2;
+  }
+
+  /*
+   * Private helper method that removes the node at "index" and returns
+   * its element, moving the last node into the gap.
+   */
+  E removeAt(int index) {
+    E element = std::move(nodes[index].element);
+    int slot = nodes[index].slot;
+    int last = nodes.size() - 1;
+    if (index != last) {
+      nodes[index] = std::move(nodes[last]);
+      slotPositions[nodes[index].slot] = index;
+    }
+    nodes.pop_back();
+    if (index < last) {
+      restore(index);
+    }
+
+    // Bumping the generation invalidates any handle still holding the slot
+    slotPositions[slot] = -1;
+    generations[slot]++;
+    freeSlots.push_back(slot);
+    return element;
+  }
+
+  /*
+   * Private helper method that returns the heap index of the lowest
+   * priority node whose value is "element", or -1 if there is none.
+   */
+  int findFirst(const E& element) const {
+    int first = -1;
+    for (int i = 0; i < nodes.size(); i++) {
+      if (nodes[i].element == element && (first == -1 || compare(nodes[i].priority, nodes[first].priority))) {
+        first = i;
+      }
+    }
+    return first;
+  }
+
+  /*
+   * Private helper method that returns the heap index of the node a handle
+   * refers to, or -1 if it has left the queue.
+   */
+  int findHandle(int slot, int generation) const {
+    if (slot < 0 || slot >= slotPositions.size() || generations[slot] != generation) {
+      return -1;
+    }
+    return slotPositions[slot];
+  }
+
+  /*
+   * Private helper method that gives the node at "index" priority
+   * "newPriority".
+   */
+  void changePriorityAt(int index, const Priority& newPriority) {
+    if (PriorityTraits<Priority, Compare>::isLegal(newPriority)) {
+      nodes[index].priority = newPriority;
+      restore(index);
+    }
+  }
+
+  // The heap, min and max levels alternating
+  std::vector<Node> nodes;
+
+  // Heap index of the node holding each slot (-1 when the slot is free),
+  // the generation of each slot, and released slots waiting to be reused
+  std::vector<int> slotPositions;
+  std::vector<int> generations;
+  std::vector<int> freeSlots;
+
+  Compare compare;
+
+public:
+
+  /*
+   * Opaque reference to a single element in the queue, returned by
+   * insert(). It stops matching anything once its element has left the
+   * queue.
+   */
+  class Handle {
+  private:
+    // Private fields
+    int slot;
+    int generation;
+
+    friend class MinMaxPriorityQueue;
+
+    /*
+     * Handle constructor used by the queue itself.
+     */
+    Handle(int newSlot, int newGeneration) {
+      slot = newSlot;
+      generation = newGeneration;
+    }
+
+  public:
+
+    /*
+     * Default constructor for a handle that refers to nothing.
+     */
+    Handle() {
+      slot = -1;
+      generation = 0;
+    }
+
+    bool operator==(const Handle& other) const {
+      return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+      return !(*this == other);
+    }
+  };
+
+  /*
+   * Constructor that optionally takes the comparator to order priorities
+   * with.
+   */
+  explicit MinMaxPriorityQueue(const Compare& newCompare = Compare()) : compare(newCompare) {
+  }
+
+  /*
+   * This function adds a new element "element" to the queue with priority
+   * "priority". Returns a handle to the new element, which refers to
+   * nothing if the priority was rejected.
+   */
+  Handle insert(const Priority& priority, const E& element) {
+    return insert(priority, E(element));
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of copying it.
+   */
+  Handle insert(const Priority& priority, E&& element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return Handle();
+    }
+
+    int slot;
+    if (!freeSlots.empty()) {
+      slot = freeSlots.back();
+      freeSlots.pop_back();
+    }
+    else {
+      slot = slotPositions.size();
+      slotPositions.push_back(-1);
+      generations.push_back(0);
+    }
+
+    slotPositions[slot] = nodes.size();
+    nodes.push_back(Node(priority, std::move(element), slot));
+    bubbleUp(nodes.size() - 1);
+    return Handle(slot, generations[slot]);
+  }
+
+  /*
+   * Returns the lowest priority value element, but leaves it in the
+   * queue. The queue must not be empty.
+   */
+  const E& peek_min() const {
+    return nodes[0].element;
+  }
+
+  /*
+   * Returns the highest priority value element, but leaves it in the
+   * queue. The queue must not be empty.
+   */
+  const E& peek_max() const {
+    return nodes[maxIndex()].element;
+  }
+
+  /*
+   * Returns the priority of the element peek_min() would return.
+   * The queue must not be empty.
+   */
+  Priority peek_min_priority() const {
+    return nodes[0].priority;
+  }
+
+  /*
+   * Returns the priority of the element peek_max() would return.
+   * The queue must not be empty.
+   */
+  Priority peek_max_priority() const {
+    return nodes[maxIndex()].priority;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves it out.
+   * The queue must not be empty.
+   */
+  E pop_min() {
+    return removeAt(0);
+  }
+
+  /*
+   * Takes the highest priority value element off the queue and moves it
+   * out. The queue must not be empty.
+   */
+  E pop_max() {
+    return removeAt(maxIndex());
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue, and returns it,
+   * or a default element if the queue is empty.
+   */
+  E remove_front() {
+    if (!empty()) {
+      return pop_min();
+    }
+    return E();
+  }
+
+  /*
+   * Removes the element referred to by "handle". Returns false if it was
+   * no longer in the queue.
+   */
+  bool erase(Handle handle) {
+    int index = findHandle(handle.slot, handle.generation);
+    if (index == -1) {
+      return false;
+    }
+    removeAt(index);
+    return true;
+  }
+
+  /*
+   * Removes the first (in priority order) element that matches "element".
+   * Returns false if no element matched.
+   */
+  bool erase(const E& element) {
+    int index = findFirst(element);
+    if (index == -1) {
+      return false;
+    }
+    removeAt(index);
+    return true;
+  }
+
+  /*
+   * Returns true if the queue contains element "element", false otherwise.
+   */
+  bool contains(const E& element) const {
+    for (int i = 0; i < nodes.size(); i++) {
+      if (nodes[i].element == element) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*
+   * Returns true if the element referred to by "handle" is still in the
+   * queue, false otherwise. This is O(1).
+   */
+  bool contains(Handle handle) const {
+    return findHandle(handle.slot, handle.generation) != -1;
+  }
+
+  /*
+   * Returns the priority of the element that matches "element". If there
+   * is more than one, it returns the lowest priority value. If no element
+   * matches, it returns PriorityTraits<Priority, Compare>::none().
+   */
+  Priority get_priority(const E& element) const {
+    int index = findFirst(element);
+    if (index == -1) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return nodes[index].priority;
+  }
+
+  /*
+   * Returns the priority of the element referred to by "handle", or
+   * PriorityTraits<Priority, Compare>::none() if it is no longer in the queue.
+   */
+  Priority get_priority(Handle handle) const {
+    int index = findHandle(handle.slot, handle.generation);
+    if (index == -1) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return nodes[index].priority;
+  }
+
+  /*
+   * Finds the first (in priority order) element that matches "element",
+   * and changes its priority to "new_priority".
+   */
+  void change_priority(const E& element, const Priority& new_priority) {
+    int index = findFirst(element);
+    if (index != -1) {
+      changePriorityAt(index, new_priority);
+    }
+  }
+
+  /*
+   * Changes the priority of the element referred to by "handle" to
+   * "new_priority" in O(log n). Does nothing if the element is no longer
+   * in the queue.
+   */
+  void change_priority(Handle handle, const Priority& new_priority) {
+    int index = findHandle(handle.slot, handle.generation);
+    if (index != -1) {
+      changePriorityAt(index, new_priority);
+    }
+  }
+
+  /*
+   * Returns a vector containing all the elements in the queue.
+   */
+  std::vector<E> get_all_elements() const {
+    std::vector<E> elements;
+    elements.reserve(nodes.size());
+    for (int i = 0; i < nodes.size(); i++) {
+      elements.push_back(nodes[i].element);
+    }
+    return elements;
+  }
+
+  /*
+   * Returns a vector containing all the priorities, in the same order as
+   * get_all_elements().
+   */
+  std::vector<Priority> get_all_priorities() const {
+    std::vector<Priority> priorities;
+    priorities.reserve(nodes.size());
+    for (int i = 0; i < nodes.size(); i++) {
+      priorities.push_back(nodes[i].priority);
+    }
+    return priorities;
+  }
+
+  /*
+   * Makes room for at least "capacity" elements up front.
+   */
+  void reserve(std::size_t capacity) {
+    nodes.reserve(capacity);
+    slotPositions.reserve(capacity);
+    generations.reserve(capacity);
+  }
+
+  /*
+   * Returns the number of elements in the queue.
+   */
+  int size() const {
+    return nodes.size();
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  bool empty() const {
+    return nodes.empty();
+  }
+
+};
+
+#endif
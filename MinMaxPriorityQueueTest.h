@@ -0,0 +1,195 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <set>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+
+#include "MinMaxPriorityQueue.h"
+
+class MinMaxPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testPopsFromBothEnds(){
+
+    MinMaxPriorityQueue<int> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT(pq.contains(pq.insert((i * 7919) % 1000, (i * 7919) % 1000)));
+
+    }
+
+    TS_ASSERT_EQUALS(pq.size(), 1000);
+    TS_ASSERT_EQUALS(pq.peek_min(), 0);
+    TS_ASSERT_EQUALS(pq.peek_max(), 999);
+
+    // Taking from alternate ends meets in the middle
+    for (int i = 0; i < 500; i++){
+
+      TS_ASSERT_EQUALS(pq.peek_min_priority(), i);
+      TS_ASSERT_EQUALS(pq.pop_min(), i);
+      TS_ASSERT_EQUALS(pq.peek_max_priority(), 999 - i);
+      TS_ASSERT_EQUALS(pq.pop_max(), 999 - i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+    pq.insert(4, 40);
+    TS_ASSERT_EQUALS(pq.peek_min(), 40);
+    TS_ASSERT_EQUALS(pq.peek_max(), 40);
+
+  }
+
+  void testMatchesReference(){
+
+    MinMaxPriorityQueue<int> pq;
+    std::vector<MinMaxPriorityQueue<int>::Handle> handles;
+    std::set<std::pair<int,int> > reference;
+    std::vector<int> priorities;
+
+    for (int i = 0; i < 20000; i++){
+
+      int action = rand() % 6;
+      if (action < 2 || reference.empty()){
+
+	int priority = rand() % 1000;
+	handles.push_back(pq.insert(priority, (int) priorities.size()));
+	reference.insert(std::make_pair(priority, (int) priorities.size()));
+	priorities.push_back(priority);
+
+      }
+      else if (action == 2){
+
+	int element = pq.pop_min();
+	TS_ASSERT_EQUALS(priorities[element], reference.begin()->first);
+	reference.erase(std::make_pair(priorities[element], element));
+
+      }
+      else if (action == 3){
+
+	int element = pq.pop_max();
+	TS_ASSERT_EQUALS(priorities[element], reference.rbegin()->first);
+	reference.erase(std::make_pair(priorities[element], element));
+
+      }
+      else{
+
+	// Erase or re-prioritise anything still there, by handle
+	int element = rand() % handles.size();
+	bool present = reference.count(std::make_pair(priorities[element], element)) > 0;
+	TS_ASSERT_EQUALS(pq.contains(handles[element]), present);
+	if (!present) continue;
+	reference.erase(std::make_pair(priorities[element], element));
+	if (action == 4){
+
+	  TS_ASSERT(pq.erase(handles[element]));
+
+	}
+	else{
+
+	  priorities[element] = rand() % 1000;
+	  pq.change_priority(handles[element], priorities[element]);
+	  reference.insert(std::make_pair(priorities[element], element));
+
+	}
+
+      }
+
+      TS_ASSERT_EQUALS(pq.size(), reference.size());
+      if (!reference.empty()){
+
+	TS_ASSERT_EQUALS(pq.peek_min_priority(), reference.begin()->first);
+	TS_ASSERT_EQUALS(pq.peek_max_priority(), reference.rbegin()->first);
+
+      }
+
+    }
+
+  }
+
+  void testHandles(){
+
+    MinMaxPriorityQueue<int> pq;
+    MinMaxPriorityQueue<int>::Handle five = pq.insert(5, 5);
+    MinMaxPriorityQueue<int>::Handle nine = pq.insert(9, 9);
+    pq.insert(1, 1);
+
+    TS_ASSERT(!pq.contains(MinMaxPriorityQueue<int>::Handle()));
+    TS_ASSERT_EQUALS(pq.get_priority(nine), 9);
+    TS_ASSERT_EQUALS(pq.pop_max(), 9);
+    TS_ASSERT(!pq.contains(nine));
+    TS_ASSERT(!pq.erase(nine));
+    TS_ASSERT_EQUALS(pq.get_priority(nine), -1);
+
+    // A reused slot does not bring an old handle back
+    MinMaxPriorityQueue<int>::Handle seven = pq.insert(7, 7);
+    TS_ASSERT(!pq.contains(nine));
+    TS_ASSERT(nine != seven);
+
+    pq.change_priority(five, 20);
+    TS_ASSERT_EQUALS(pq.peek_max(), 5);
+    pq.change_priority(five, 0);
+    TS_ASSERT_EQUALS(pq.peek_min(), 5);
+    TS_ASSERT_EQUALS(pq.peek_max(), 7);
+    TS_ASSERT(pq.erase(five));
+    TS_ASSERT_EQUALS(pq.peek_min(), 1);
+
+  }
+
+  void testElementLookups(){
+
+    MinMaxPriorityQueue<std::string> pq;
+    TS_ASSERT(!pq.contains(pq.insert(-1, "illegal")));
+    TS_ASSERT(pq.empty());
+
+    pq.insert(3, "three");
+    pq.insert(8, "eight");
+    pq.insert(6, "six");
+    pq.insert(2, "six");
+
+    TS_ASSERT(pq.contains("eight"));
+    TS_ASSERT(!pq.contains("nine"));
+    TS_ASSERT_EQUALS(pq.get_priority("six"), 2);
+    TS_ASSERT_EQUALS(pq.get_priority("nine"), -1);
+
+    // Only the lowest priority match is changed or erased
+    pq.change_priority("six", 10);
+    TS_ASSERT_EQUALS(pq.get_priority("six"), 6);
+    TS_ASSERT_EQUALS(pq.peek_max_priority(), 10);
+    pq.change_priority("three", -5);
+    TS_ASSERT_EQUALS(pq.get_priority("three"), 3);
+
+    TS_ASSERT(pq.erase("six"));
+    TS_ASSERT_EQUALS(pq.get_priority("six"), 10);
+    TS_ASSERT(!pq.erase("nine"));
+    TS_ASSERT_EQUALS(pq.size(), 3);
+    TS_ASSERT_EQUALS(pq.get_all_elements().size(), 3);
+    TS_ASSERT_EQUALS(pq.get_all_priorities().size(), 3);
+
+  }
+
+  void testComparator(){
+
+    // With std::greater the "min" end holds the largest priority
+    MinMaxPriorityQueue<int, double, std::greater<double> > pq;
+    for (int i = 0; i < 100; i++){
+
+      pq.insert(i * 0.5, i);
+
+    }
+
+    TS_ASSERT_EQUALS(pq.peek_min(), 99);
+    TS_ASSERT_EQUALS(pq.peek_max(), 0);
+    TS_ASSERT_EQUALS(pq.pop_max(), 0);
+    TS_ASSERT_EQUALS(pq.peek_max_priority(), 0.5);
+
+  }
+
+};
@@ -0,0 +1,261 @@
+#ifndef _MULTI_QUEUE_H
+#define _MULTI_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a relaxed concurrent priority queue, the MultiQueue
+ * of Rihani, Sanders and Dementiev.
+ * It keeps a number of independent PriorityQueues, each behind its own lock
+ * that is only ever taken with try_lock, so no thread waits on another.
+ * An insert goes to a random sub-queue. A removal samples two random
+ * sub-queues and takes the better of their two fronts.
+ * The result is not exactly in priority order. With q sub-queues, the
+ * element removed is expected to be about q places from the true front (its
+ * rank error is O(q) in expectation, and O(q log q) with high probability).
+ * In return throughput scales with the number of threads. Use around
+ * 2 to 4 sub-queues per thread: fewer gives a tighter order, more gives
+ * less contention.
+ * The template parameters are the same as for PriorityQueue.
+ */
+template <typename E, int Arity = 2, typename Priority = int, typename Compare = std::less<Priority> >
+class MultiQueue {
+
+private:
+
+  typedef PriorityQueue<E, Arity, Priority, Compare> Queue;
+
+  /*
+   * Class for SubQueue - one of the independent heaps, padded to its own
+   * cache line so locks on neighbouring sub-queues do not false-share.
+   */
+  class alignas(64) SubQueue {
+  public:
+    std::mutex lock;
+    Queue queue;
+  };
+
+  /*
+   * Private helper method that returns a random sub-queue index, using a
+   * per-thread xorshift generator so threads never share random state.
+   */
+  int randomIndex() {
+    static thread_local std::uint64_t state =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state % subQueueCount;
+  }
+
+  /*
+   * Private helper method that returns true if sub-queue "a" has a better
+   * front than sub-queue "b". Both must be locked.
+   */
+  bool betterFront(SubQueue& a, SubQueue& b) {
+    if (a.queue.empty()) {
+      return false;
+    }
+    if (b.queue.empty()) {
+      return true;
+    }
+    return compare(a.queue.peek_priority(), b.queue.peek_priority());
+  }
+
+  /*
+   * Private helper method that locks two different random sub-queues, or just
+   * one if there is only one. Returns false if either lock was busy.
+   */
+  bool lockTwo(int& first, int& second) {
+    first = randomIndex();
+    second = subQueueCount > 1 ? randomIndex() : first;
+    if (second == first && subQueueCount > 1) {
+      second = (first + 1) % subQueueCount;
+    }
+
+    if (!subQueues[first].lock.try_lock()) {
+      return false;
+    }
+    if (second != first && !subQueues[second].lock.try_lock()) {
+      subQueues[first].lock.unlock();
+      return false;
+    }
+    return true;
+  }
+
+  /*
+   * Private helper method that unlocks what lockTwo() locked.
+   */
+  void unlockTwo(int first, int second) {
+    if (second != first) {
+      subQueues[second].lock.unlock();
+    }
+    subQueues[first].lock.unlock();
+  }
+
+  /*
+   * Private helper method that sweeps every sub-queue in turn for something
+   * to remove, taking the locks normally. Used when random sampling keeps
+   * landing on empty sub-queues, so an element is never missed.
+   */
+  bool sweep(E& element, bool remove) {
+    for (int i = 0; i < subQueueCount; i++) {
+      std::lock_guard<std::mutex> guard(subQueues[i].lock);
+      if (!subQueues[i].queue.empty()) {
+        if (remove) {
+          element = subQueues[i].queue.pop();
+          count.fetch_sub(1);
+        }
+        else {
+          element = subQueues[i].queue.peek();
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*
+   * Private helper method shared by remove and peek. Samples two sub-queues
+   * and takes or copies the better front.
+   */
+  bool sampleFront(E& element, bool remove) {
+    for (int attempt = 0; attempt < 2 * subQueueCount + 8; attempt++) {
+      if (count.load() == 0) {
+        return false;
+      }
+
+      int first;
+      int second;
+      if (!lockTwo(first, second)) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      SubQueue& best = betterFront(subQueues[second], subQueues[first]) ? subQueues[second] : subQueues[first];
+      bool found = !best.queue.empty();
+      if (found) {
+        if (remove) {
+          element = best.queue.pop();
+          count.fetch_sub(1);
+        }
+        else {
+          element = best.queue.peek();
+        }
+      }
+      unlockTwo(first, second);
+
+      if (found) {
+        return true;
+      }
+    }
+    return sweep(element, remove);
+  }
+
+  // The sub-queues
+  AlignedArray<SubQueue> subQueues;
+  int subQueueCount;
+
+  // Comparator for the fronts of two sub-queues
+  Compare compare;
+
+  // Number of elements across all sub-queues
+  std::atomic<int> count;
+
+public:
+
+  /*
+   * Constructor that takes the number of sub-queues. The default is two per
+   * hardware thread.
+   */
+  explicit MultiQueue(int newSubQueueCount = 2 * std::max(1u, std::thread::hardware_concurrency()))
+    : subQueues(std::max(1, newSubQueueCount)),
+      subQueueCount(std::max(1, newSubQueueCount)), count(0) {
+  }
+
+  /*
+   * This function adds a new element "element" to a random sub-queue
+   * with priority "priority". Returns false if the priority was rejected.
+   */
+  bool insert(const Priority& priority, E element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return false;
+    }
+    for (int attempt = 1; ; attempt++) {
+      SubQueue& subQueue = subQueues[randomIndex()];
+      if (subQueue.lock.try_lock()) {
+        subQueue.queue.insert(priority, std::move(element));
+        count.fetch_add(1);
+        subQueue.lock.unlock();
+        return true;
+      }
+
+      // Every lock we tried was busy, so let the holders run
+      if (attempt % subQueueCount == 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /*
+   * Takes an element from near the front of the queue and moves it into
+   * "element". Returns false if the queue is empty.
+   */
+  bool try_remove_front(E& element) {
+    return sampleFront(element, true);
+  }
+
+  /*
+   * Takes an element from near the front of the queue and returns it,
+   * or returns E() if the queue is empty, like PriorityQueue::remove_front().
+   */
+  E remove_front() {
+    E element = E();
+    sampleFront(element, true);
+    return element;
+  }
+
+  /*
+   * Returns a copy of an element from near the front of the queue, but
+   * leaves it in the queue. Returns E() if the queue is empty.
+   */
+  E peek() {
+    E element = E();
+    sampleFront(element, false);
+    return element;
+  }
+
+  /*
+   * Returns the number of elements in the queue. With other threads
+   * running this is only a snapshot.
+   */
+  int size() const {
+    return count.load();
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  bool empty() const {
+    return count.load() == 0;
+  }
+
+  /*
+   * Returns the number of sub-queues.
+   */
+  int sub_queue_count() const {
+    return subQueueCount;
+  }
+
+};
+
+#endif
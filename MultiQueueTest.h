@@ -0,0 +1,149 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "MultiQueue.h"
+
+class MultiQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testSingleSubQueueIsExact(){
+
+    MultiQueue<int> pq(1);
+
+    for (int i = 0; i < 100; i++){
+
+      pq.insert((i * 37) % 100, i);
+
+    }
+
+    TS_ASSERT(!pq.insert(-1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 100);
+
+    int last = -1;
+
+    while (!pq.empty()){
+
+      int priority = (pq.remove_front() * 37) % 100;
+      TS_ASSERT(last < priority);
+      last = priority;
+
+    }
+
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testEveryElementComesOutOnce(){
+
+    MultiQueue<int> pq(8);
+
+    std::vector<int> seen(1000, 0);
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert(rand()%100, i);
+
+    }
+
+    TS_ASSERT_EQUALS(pq.sub_queue_count(), 8);
+
+    int element;
+    int removed = 0;
+
+    while (pq.try_remove_front(element)){
+
+      seen[element]++;
+      removed++;
+
+    }
+
+    TS_ASSERT_EQUALS(removed, 1000);
+    TS_ASSERT(pq.empty());
+
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i], 1);
+
+    }
+
+  }
+
+  void testRankErrorIsSmall(){
+
+    // Elements are their own priorities, so the rank of a removed element
+    // is how many smaller ones are still queued
+    MultiQueue<int> pq(4);
+    std::vector<bool> present(10000, true);
+
+    for (int i = 0; i < 10000; i++){
+
+      pq.insert(i, i);
+
+    }
+
+    int front = 0;
+    long totalRank = 0;
+
+    for (int i = 0; i < 5000; i++){
+
+      int element = pq.remove_front();
+      present[element] = false;
+      while (!present[front]) front++;
+
+      for (int j = front; j < element; j++){
+	if (present[j]) totalRank++;
+      }
+
+    }
+
+    // The expected rank error is O(number of sub-queues)
+    TS_ASSERT_LESS_THAN(totalRank / 5000.0, 16.0);
+
+  }
+
+  void testConcurrentInsertAndRemove(){
+
+    MultiQueue<int> pq(8);
+    std::vector<std::atomic<int> > seen(16000);
+    std::atomic<int> removed(0);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++){
+
+      threads.push_back(std::thread([&pq, t](){
+	for (int i = 0; i < 4000; i++){
+	  pq.insert(i % 50, t * 4000 + i);
+	}
+      }));
+      threads.push_back(std::thread([&](){
+	int element;
+	while (removed.load() < 16000){
+	  if (pq.try_remove_front(element)){
+	    seen[element]++;
+	    removed++;
+	  }
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i].load(), 1);
+
+    }
+
+  }
+
+};
@@ -0,0 +1,697 @@
+#ifndef _PAIRING_PR_QUEUE_H
+#define _PAIRING_PR_QUEUE_H
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a mergeable priority queue as a pairing heap.
+ * Every node keeps its first child and its next sibling, so two heaps meld
+ * by making the worse root the first child of the better one. That makes
+ * merge() O(1), along with insert() and moving an element to a better
+ * priority. Removing the front, or moving an element to a worse priority,
+ * is O(log n) amortised: the removed node's children are paired off
+ * left to right and then folded together right to left.
+ * Nodes come from a pool owned by the queue, in chunks that double in size,
+ * so neighbouring nodes tend to share cache lines and a removal never frees
+ * memory, it only puts the node back on the pool's free list. A merge takes
+ * over the other queue's pool as it is, so handles to its elements stay
+ * valid in the merged queue.
+ * The public interface is the same as PriorityQueue's, plus merge().
+ */
+template <typename E, typename Priority = int, typename Compare = std::less<Priority> >
+class PairingPriorityQueue {
+
+private:
+
+  /*
+   * Class for a heap node. "previous" is the parent for a first child, or
+   * the sibling to the left for any other, so a node can be cut out of the
+   * tree in O(1). The element is only constructed while the node is in use.
+   */
+  class Node {
+  public:
+    Priority priority;
+    Node* child;
+    Node* sibling;
+    Node* previous;
+    int generation;
+    typename std::aligned_storage<sizeof(E), alignof(E)>::type storage;
+
+    Node() : priority(), child(0), sibling(0), previous(0), generation(0) {
+    }
+
+    E& value() {
+      return *reinterpret_cast<E*>(&storage);
+    }
+
+    const E& value() const {
+      return *reinterpret_cast<const E*>(&storage);
+    }
+  };
+
+  /*
+   * Class for one chunk of the node pool.
+   */
+  class Chunk {
+  public:
+    Chunk* next;
+    std::unique_ptr<Node[]> nodes;
+
+    explicit Chunk(std::size_t size) : next(0), nodes(new Node[size]) {
+    }
+  };
+
+  // Nodes in the first pool chunk, and the most in any one chunk
+  static const std::size_t FIRST_CHUNK = 32;
+  static const std::size_t LARGEST_CHUNK = 4096;
+
+  /*
+   * Private helper method that takes a node from the pool, adding a new
+   * chunk if the free list is empty.
+   */
+  Node* allocateNode() {
+    if (freeNodes == 0) {
+      Chunk* chunk = new Chunk(nextChunkSize);
+      if (lastChunk != 0) {
+        lastChunk->next = chunk;
+      }
+      else {
+        firstChunk = chunk;
+      }
+      lastChunk = chunk;
+
+      // Chain the chunk's nodes onto the free list through "sibling"
+      for (std::size_t i = 0; i < nextChunkSize; i++) {
+        chunk->nodes[i].sibling = i + 1 < nextChunkSize ? &chunk->nodes[i + 1] : 0;
+      }
+      freeNodes = &chunk->nodes[0];
+      lastFreeNode = &chunk->nodes[nextChunkSize - 1];
+      nextChunkSize = nextChunkSize * 2 < LARGEST_CHUNK ? nextChunkSize * 2 : LARGEST_CHUNK;
+    }
+
+    Node* node = freeNodes;
+    freeNodes = node->sibling;
+    if (freeNodes == 0) {
+      lastFreeNode = 0;
+    }
+    node->child = 0;
+    node->sibling = 0;
+    node->previous = 0;
+    return node;
+  }
+
+  /*
+   * Private helper method that destroys the element in "node" and puts the
+   * node back in the pool, so handles to it stop matching.
+   */
+  void freeNode(Node* node) {
+    node->value().~E();
+    node->generation++;
+    node->child = 0;
+    node->previous = 0;
+    node->sibling = freeNodes;
+    freeNodes = node;
+    if (lastFreeNode == 0) {
+      lastFreeNode = node;
+    }
+  }
+
+  /*
+   * Private helper method that returns true if "a" comes before "b".
+   */
+  bool before(const Node* a, const Node* b) const {
+    return compare(a->priority, b->priority);
+  }
+
+  /*
+   * Private helper method that melds two heap roots, either of which may be
+   * null, and returns the new root.
+   */
+  Node* meld(Node* a, Node* b) {
+    if (a == 0) {
+      return b;
+    }
+    if (b == 0) {
+      return a;
+    }
+    if (before(b, a)) {
+      std::swap(a, b);
+    }
+
+    // "b" becomes the first child of "a"
+    b->previous = a;
+    b->sibling = a->child;
+    if (a->child != 0) {
+      a->child->previous = b;
+    }
+    a->child = b;
+    a->sibling = 0;
+    a->previous = 0;
+    return a;
+  }
+
+  /*
+   * Private helper method that combines the sibling list starting at
+   * "first" into one heap, pairing left to right and then folding right to
+   * left, and returns its root.
+   */
+  Node* combine(Node* first) {
+    if (first == 0) {
+      return 0;
+    }
+
+    scratch.clear();
+    while (first != 0) {
+      Node* a = first;
+      Node* b = a->sibling;
+      first = b != 0 ? b->sibling : 0;
+      a->sibling = 0;
+      a->previous = 0;
+      if (b != 0) {
+        b->sibling = 0;
+        b->previous = 0;
+      }
+      scratch.push_back(meld(a, b));
+    }
+
+    Node* root = scratch.back();
+    for (int i = scratch.size() - 2; i >= 0; i--) {
+      root = meld(scratch[i], root);
+    }
+    return root;
+  }
+
+  /*
+   * Private helper method that cuts the subtree rooted at "node" out of
+   * the tree. "node" must not be the root.
+   */
+  void cut(Node* node) {
+    if (node->previous->child == node) {
+      node->previous->child = node->sibling;
+    }
+    else {
+      node->previous->sibling = node->sibling;
+    }
+    if (node->sibling != 0) {
+      node->sibling->previous = node->previous;
+    }
+    node->sibling = 0;
+    node->previous = 0;
+  }
+
+  /*
+   * Private helper method that takes the root off and returns it, still
+   * holding its element.
+   */
+  Node* takeRoot() {
+    Node* node = root;
+    root = combine(node->child);
+    node->child = 0;
+    count--;
+    return node;
+  }
+
+  /*
+   * Private helper method that gives "node" priority "newPriority" and
+   * puts it back where it belongs.
+   */
+  void changeNodePriority(Node* node, const Priority& newPriority) {
+    bool better = compare(newPriority, node->priority);
+    node->priority = newPriority;
+
+    if (node == root) {
+      // Only a worse root has anywhere to go
+      if (!better && node->child != 0) {
+        Node* children = node->child;
+        node->child = 0;
+        root = meld(node, combine(children));
+      }
+      return;
+    }
+
+    cut(node);
+    if (!better) {
+      // A worse node's children may now belong above it
+      Node* children = node->child;
+      node->child = 0;
+      root = meld(root, combine(children));
+    }
+    root = meld(root, node);
+  }
+
+  /*
+   * Private helper method that calls "visit" on every node in the heap.
+   */
+  template <typename Visit>
+  void forEachNode(Visit visit) const {
+    std::vector<const Node*> pending;
+    if (root != 0) {
+      pending.push_back(root);
+    }
+    while (!pending.empty()) {
+      const Node* node = pending.back();
+      pending.pop_back();
+      visit(node);
+      for (const Node* child = node->child; child != 0; child = child->sibling) {
+        pending.push_back(child);
+      }
+    }
+  }
+
+  /*
+   * Private helper method that returns the node with the lowest priority
+   * whose element equals "element", or null if there is none.
+   */
+  Node* findFirst(const E& element) const {
+    const Node* lowest = 0;
+    const Compare& order = compare;
+    forEachNode([&](const Node* node) {
+      if (node->value() == element && (lowest == 0 || order(node->priority, lowest->priority))) {
+        lowest = node;
+      }
+    });
+    return const_cast<Node*>(lowest);
+  }
+
+  /*
+   * Private helper method that empties the queue and frees the pool.
+   */
+  void destroy() {
+    forEachNode([](const Node* node) {
+      const_cast<Node*>(node)->value().~E();
+    });
+    while (firstChunk != 0) {
+      Chunk* next = firstChunk->next;
+      delete firstChunk;
+      firstChunk = next;
+    }
+  }
+
+  /*
+   * Private helper method that leaves the queue empty with no pool.
+   */
+  void reset() {
+    root = 0;
+    count = 0;
+    firstChunk = 0;
+    lastChunk = 0;
+    freeNodes = 0;
+    lastFreeNode = 0;
+    nextChunkSize = FIRST_CHUNK;
+  }
+
+  // The heap
+  Node* root;
+  int count;
+
+  // The node pool: every chunk, and the nodes in them not in use
+  Chunk* firstChunk;
+  Chunk* lastChunk;
+  Node* freeNodes;
+  Node* lastFreeNode;
+  std::size_t nextChunkSize;
+
+  // Roots waiting to be folded together by combine()
+  std::vector<Node*> scratch;
+
+  Compare compare;
+
+public:
+
+  /*
+   * Opaque reference to a single element in the queue, returned by insert().
+   * A handle lets the element be found in O(1) without comparing values, and
+   * stops matching anything once its element has left the queue. It stays
+   * valid when its queue is merged into another one.
+   */
+  class Handle {
+  private:
+    // Private fields
+    Node* node;
+    int generation;
+
+    friend class PairingPriorityQueue;
+
+    /*
+     * Handle constructor used by the queue itself.
+     */
+    Handle(Node* newNode, int newGeneration) {
+      node = newNode;
+      generation = newGeneration;
+    }
+
+  public:
+
+    /*
+     * Default constructor for a handle that refers to nothing.
+     */
+    Handle() {
+      node = 0;
+      generation = 0;
+    }
+
+    bool operator==(const Handle& other) const {
+      return node == other.node && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+      return !(*this == other);
+    }
+  };
+
+private:
+
+  /*
+   * Private helper method that returns the node "handle" refers to, or
+   * null if its element is no longer in the queue.
+   */
+  static Node* findHandle(Handle handle) {
+    if (handle.node == 0 || handle.node->generation != handle.generation) {
+      return 0;
+    }
+    return handle.node;
+  }
+
+public:
+
+  /*
+   * A constructor, if you need it.
+   */
+  PairingPriorityQueue() {
+    reset();
+  }
+
+  /*
+   * Constructor that takes the comparator to order priorities with, for
+   * comparators that carry state.
+   */
+  explicit PairingPriorityQueue(const Compare& newCompare) : compare(newCompare) {
+    reset();
+  }
+
+  /*
+   * Move constructor that takes over the elements and pool of "other".
+   */
+  PairingPriorityQueue(PairingPriorityQueue&& other) : compare(other.compare) {
+    reset();
+    merge(std::move(other));
+  }
+
+  /*
+   * Move assignment that replaces this queue with the elements of "other".
+   */
+  PairingPriorityQueue& operator=(PairingPriorityQueue&& other) {
+    if (this != &other) {
+      destroy();
+      reset();
+      compare = other.compare;
+      merge(std::move(other));
+    }
+    return *this;
+  }
+
+  PairingPriorityQueue(const PairingPriorityQueue&) = delete;
+  PairingPriorityQueue& operator=(const PairingPriorityQueue&) = delete;
+
+  /*
+   * Destructor that destroys every element and frees the pool.
+   */
+  ~PairingPriorityQueue() {
+    destroy();
+  }
+
+  /*
+   * This function adds a new element "element" to the queue
+   * with priority "priority".
+   * Returns a handle to the new element, which refers to nothing if
+   * the priority was rejected.
+   */
+  Handle insert(const Priority& priority, const E& element) {
+    return emplace(priority, element);
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of
+   * copying it.
+   */
+  Handle insert(const Priority& priority, E&& element) {
+    return emplace(priority, std::move(element));
+  }
+
+  /*
+   * Builds a new element in place from "args" with priority "priority",
+   * so the element is never copied or moved on the way in.
+   */
+  template <typename... Args>
+  Handle emplace(const Priority& priority, Args&&... args) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority)) {
+      return Handle();
+    }
+
+    Node* node = allocateNode();
+    new (&node->storage) E(std::forward<Args>(args)...);
+    node->priority = priority;
+    root = meld(root, node);
+    count++;
+    return Handle(node, node->generation);
+  }
+
+  /*
+   * Similar to insert, but takes a whole vector of new things to
+   * add.
+   */
+  void insert_all(const std::vector<std::pair<Priority,E> >& new_elements) {
+    insert_all(new_elements.begin(), new_elements.end());
+  }
+
+  /*
+   * Same as above, but moves the elements out of "new_elements".
+   */
+  void insert_all(std::vector<std::pair<Priority,E> >&& new_elements) {
+    insert_all(std::make_move_iterator(new_elements.begin()),
+               std::make_move_iterator(new_elements.end()));
+  }
+
+  /*
+   * Same as above, but takes any range of (priority, element) pairs.
+   */
+  template <typename InputIt>
+  void insert_all(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      typename std::iterator_traits<InputIt>::value_type entry = *first;
+      emplace(entry.first, std::move(entry.second));
+    }
+  }
+
+  /*
+   * Moves every element of "other" into this queue in O(1), leaving
+   * "other" empty. Handles to elements of "other" now refer to them here.
+   * Both queues must order priorities the same way.
+   */
+  void merge(PairingPriorityQueue&& other) {
+    if (this == &other) {
+      return;
+    }
+
+    root = meld(root, other.root);
+    count += other.count;
+
+    if (other.firstChunk != 0) {
+      if (lastChunk != 0) {
+        lastChunk->next = other.firstChunk;
+      }
+      else {
+        firstChunk = other.firstChunk;
+      }
+      lastChunk = other.lastChunk;
+    }
+    if (other.freeNodes != 0) {
+      if (lastFreeNode != 0) {
+        lastFreeNode->sibling = other.freeNodes;
+      }
+      else {
+        freeNodes = other.freeNodes;
+      }
+      lastFreeNode = other.lastFreeNode;
+    }
+    nextChunkSize = std::max(nextChunkSize, other.nextChunkSize);
+
+    other.reset();
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue,
+   * and returns it.
+   */
+  E remove_front() {
+    if (!empty()) {
+      return pop();
+    }
+    return E();
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves
+   * it out. The queue must not be empty.
+   */
+  E pop() {
+    Node* node = takeRoot();
+    E element = std::move(node->value());
+    freeNode(node);
+    return element;
+  }
+
+  /*
+   * Takes up to "count" of the lowest priority value elements off the
+   * queue in one go, moving them to "out" in priority order. Returns the
+   * output iterator past the last element written.
+   */
+  template <typename OutputIt>
+  OutputIt pop_n(int count, OutputIt out) {
+    for (int i = 0; i < count && !empty(); i++) {
+      *out++ = pop();
+    }
+    return out;
+  }
+
+  /*
+   * Empties the queue into the back of "container", in priority order.
+   */
+  template <typename Container>
+  void drain_into(Container& container) {
+    pop_n(size(), std::back_inserter(container));
+  }
+
+  /*
+   * Returns the lowest priority value element in the queue, but leaves
+   * it in the queue.
+   */
+  const E& peek() const {
+    return root->value();
+  }
+
+  /*
+   * Returns the priority of the element peek() would return.
+   * The queue must not be empty.
+   */
+  Priority peek_priority() const {
+    return root->priority;
+  }
+
+  /*
+   * Returns a vector containing all the elements in the queue.
+   */
+  std::vector<E> get_all_elements() const {
+    std::vector<E> elements;
+    elements.reserve(count);
+    forEachNode([&elements](const Node* node) {
+      elements.push_back(node->value());
+    });
+    return elements;
+  }
+
+  /*
+   * Returns true if the queue contains element "element", false
+   * otherwise.
+   */
+  bool contains(const E& element) const {
+    return findFirst(element) != 0;
+  }
+
+  /*
+   * Returns true if the element referred to by "handle" is still
+   * in the queue, false otherwise. This is O(1).
+   */
+  bool contains(Handle handle) const {
+    return findHandle(handle) != 0;
+  }
+
+  /*
+   * Returns the priority of the element that matches "element", the
+   * lowest one if there is more than one, or -1 if no element matches.
+   */
+  Priority get_priority(const E& element) const {
+    Node* node = findFirst(element);
+    if (node == 0) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return node->priority;
+  }
+
+  /*
+   * Returns the priority of the element referred to by "handle",
+   * or -1 if it is no longer in the queue. This is O(1).
+   */
+  Priority get_priority(Handle handle) const {
+    Node* node = findHandle(handle);
+    if (node == 0) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return node->priority;
+  }
+
+  /*
+   * Returns a vector containing all the priorities.
+   * The priority of the element get_all_elements()[i] is
+   * get_all_priorities()[i].
+   */
+  std::vector<Priority> get_all_priorities() const {
+    std::vector<Priority> priorities;
+    priorities.reserve(count);
+    forEachNode([&priorities](const Node* node) {
+      priorities.push_back(node->priority);
+    });
+    return priorities;
+  }
+
+  /*
+   * Finds the first (in priority order) element that matches
+   * "element", and changes its priority to "new_priority".
+   */
+  void change_priority(const E& element, const Priority& new_priority) {
+    Node* node = findFirst(element);
+    if (node != 0 && PriorityTraits<Priority, Compare>::isLegal(new_priority)) {
+      changeNodePriority(node, new_priority);
+    }
+  }
+
+  /*
+   * Changes the priority of the element referred to by "handle" to
+   * "new_priority". This is O(1) for a better priority and O(log n)
+   * amortised for a worse one. Does nothing if the element is no longer in
+   * the queue.
+   */
+  void change_priority(Handle handle, const Priority& new_priority) {
+    Node* node = findHandle(handle);
+    if (node != 0 && PriorityTraits<Priority, Compare>::isLegal(new_priority)) {
+      changeNodePriority(node, new_priority);
+    }
+  }
+
+  /*
+   * Returns the number of elements in the queue.
+   */
+  int size() const {
+    return count;
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  bool empty() const {
+    return count == 0;
+  }
+
+};
+
+#endif
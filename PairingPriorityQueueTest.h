@@ -0,0 +1,173 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "PairingPriorityQueue.h"
+
+class PairingPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testRemovesInPriorityOrder(){
+
+    PairingPriorityQueue<int> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert((i * 7919) % 1000, (i * 7919) % 1000);
+
+    }
+
+    TS_ASSERT(pq.insert(-1, 0) == PairingPriorityQueue<int>::Handle());
+    TS_ASSERT_EQUALS(pq.size(), 1000);
+    TS_ASSERT_EQUALS(pq.peek(), 0);
+
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT_EQUALS(pq.peek_priority(), i);
+      TS_ASSERT_EQUALS(pq.remove_front(), i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testMergeKeepsHandles(){
+
+    PairingPriorityQueue<std::string> a;
+    PairingPriorityQueue<std::string> b;
+
+    a.insert(5, "a5");
+    a.insert(1, "a1");
+    PairingPriorityQueue<std::string>::Handle b3 = b.insert(3, "b3");
+    b.insert(0, "b0");
+    TS_ASSERT_EQUALS(b.pop(), "b0");
+
+    a.merge(std::move(b));
+    TS_ASSERT_EQUALS(a.size(), 3);
+    TS_ASSERT(b.empty());
+    TS_ASSERT(a.contains(b3));
+
+    a.change_priority(b3, 0);
+    TS_ASSERT_EQUALS(a.peek(), "b3");
+
+    // The merged-in pool is reused, and the empty queue still works
+    b.insert(2, "b2");
+    TS_ASSERT_EQUALS(b.pop(), "b2");
+
+    TS_ASSERT_EQUALS(a.pop(), "b3");
+    TS_ASSERT(!a.contains(b3));
+    TS_ASSERT_EQUALS(a.pop(), "a1");
+    TS_ASSERT_EQUALS(a.pop(), "a5");
+    TS_ASSERT(a.empty());
+
+  }
+
+  void testChangePriorityBothWays(){
+
+    PairingPriorityQueue<int> pq;
+    std::vector<PairingPriorityQueue<int>::Handle> handles;
+    std::vector<int> priorities;
+
+    for (int i = 0; i < 2000; i++){
+
+      priorities.push_back(rand()%10000);
+      handles.push_back(pq.insert(priorities[i], i));
+
+    }
+
+    for (int i = 0; i < 5000; i++){
+
+      int which = rand()%2000;
+      priorities[which] = rand()%10000;
+      pq.change_priority(handles[which], priorities[which]);
+
+    }
+
+    pq.change_priority(5, 20000);
+    priorities[5] = 20000;
+    TS_ASSERT_EQUALS(pq.get_priority(5), 20000);
+    TS_ASSERT_EQUALS(pq.get_priority(handles[6]), priorities[6]);
+
+    int last = -1;
+    while (!pq.empty()){
+
+      int element = pq.pop();
+      TS_ASSERT(last <= priorities[element]);
+      last = priorities[element];
+
+    }
+
+  }
+
+  void testMergeManyShards(){
+
+    std::vector<PairingPriorityQueue<int> > shards(8);
+
+    for (int i = 0; i < 8000; i++){
+
+      shards[i % 8].insert(i, i);
+
+    }
+
+    PairingPriorityQueue<int> all;
+
+    for (int i = 0; i < shards.size(); i++){
+
+      all.merge(std::move(shards[i]));
+
+    }
+
+    TS_ASSERT_EQUALS(all.size(), 8000);
+
+    std::vector<int> out;
+    all.drain_into(out);
+
+    for (int i = 0; i < out.size(); i++){
+
+      TS_ASSERT_EQUALS(out[i], i);
+
+    }
+
+  }
+
+  void testMoveOnlyAndAccessors(){
+
+    PairingPriorityQueue<std::unique_ptr<int> > pq;
+
+    pq.insert(3, std::unique_ptr<int>(new int(3)));
+    pq.emplace(1, new int(1));
+    TS_ASSERT_EQUALS(*pq.peek(), 1);
+    TS_ASSERT_EQUALS(*pq.pop(), 1);
+
+    PairingPriorityQueue<int> ints;
+    std::vector<std::pair<int,int> > elements;
+    for (int i = 0; i < 20; i++){
+
+      elements.push_back(std::make_pair(i * 2, i));
+
+    }
+    ints.insert_all(elements);
+
+    std::vector<int> all = ints.get_all_elements();
+    std::vector<int> priorities = ints.get_all_priorities();
+    TS_ASSERT_EQUALS(all.size(), 20);
+
+    for (int i = 0; i < all.size(); i++){
+
+      TS_ASSERT_EQUALS(priorities[i], all[i] * 2);
+
+    }
+
+    TS_ASSERT(ints.contains(19));
+    TS_ASSERT(!ints.contains(20));
+
+  }
+
+};
@@ -9,271 +9,2809 @@
 #include <vector>
 #include <list>
 #include <utility>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+/*
+ * Memory-mapped snapshot loading, where the platform has mmap().
+ */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(PRIORITY_QUEUE_NO_MMAP)
+#define PRIORITY_QUEUE_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * SIMD support for picking the smallest child in wide heaps.
+ * The best instruction set the compiler has been told about is used, and
+ * defining PRIORITY_QUEUE_NO_SIMD forces the scalar path.
+ */
+#if !defined(PRIORITY_QUEUE_NO_SIMD)
+#if defined(__AVX2__)
+#define PRIORITY_QUEUE_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define PRIORITY_QUEUE_SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define PRIORITY_QUEUE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+/*
+ * Traits that decide which priorities a queue ordered by "Compare" accepts,
+ * and what get_priority() returns for elements that are not in the queue.
+ * One value is set aside as that sentinel only under the default order,
+ * std::less:
+ *   - signed and floating point priorities must not be negative (which
+ *     also rules out NaN), and the sentinel is -1;
+ *   - unsigned priorities may be anything but their largest value, which
+ *     is the sentinel.
+ * Under any other order, such as std::greater, every arithmetic priority
+ * but NaN is accepted, so the value-initialised Priority() returned for a
+ * missing element is a legal priority; check contains() first. Any other
+ * priority type is always accepted. Specialise this for your own priority
+ * type (and comparator, if it is not std::less) to change either rule.
+ * Both are constexpr so that StaticPriorityQueue can use them at compile
+ * time.
+ */
+template <typename Priority, typename Compare = std::less<Priority>, typename Enable = void>
+struct PriorityTraits {
+  static constexpr bool isLegal(const Priority&) {
+    return true;
+  }
+
+  static constexpr Priority none() {
+    return Priority();
+  }
+};
+
+template <typename Priority, typename Compare>
+struct PriorityTraits<Priority, Compare,
+                      typename std::enable_if<std::is_arithmetic<Priority>::value &&
+                                              !std::is_same<Compare, std::less<Priority> >::value>::type> {
+  static constexpr bool isLegal(const Priority& priority) {
+    return priority == priority;
+  }
+
+  static constexpr Priority none() {
+    return Priority();
+  }
+};
+
+template <typename Priority>
+struct PriorityTraits<Priority, std::less<Priority>,
+                      typename std::enable_if<std::is_arithmetic<Priority>::value &&
+                                              !std::is_unsigned<Priority>::value>::type> {
+  static constexpr bool isLegal(const Priority& priority) {
+    return priority >= 0;
+  }
+
+  static constexpr Priority none() {
+    return Priority(-1);
+  }
+};
+
+template <typename Priority>
+struct PriorityTraits<Priority, std::less<Priority>,
+                      typename std::enable_if<std::is_unsigned<Priority>::value>::type> {
+  static constexpr bool isLegal(const Priority& priority) {
+    return priority != std::numeric_limits<Priority>::max();
+  }
+
+  static constexpr Priority none() {
+    return std::numeric_limits<Priority>::max();
+  }
+};
+
+/*
+ * Serializers that decide how save() and load() write and read each element.
+ * Trivially copyable elements are "raw": the whole payload array is written
+ * as one block, which is also what lets load_mapped() copy it straight in.
+ * Strings are written as a length and their characters. Specialise this for
+ * your own element type, with raw set to false, a write() and a read() that
+ * returns false on bad input.
+ */
+template <typename T, typename Enable = void>
+struct PayloadSerializer;
+
+template <typename T>
+struct PayloadSerializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+  static const bool raw = true;
+
+  static void write(std::ostream& out, const T& element) {
+    out.write(reinterpret_cast<const char*>(&element), sizeof(T));
+  }
+
+  static bool read(std::istream& in, T& element) {
+    return bool(in.read(reinterpret_cast<char*>(&element), sizeof(T)));
+  }
+};
+
+template <typename Char, typename CharTraits, typename StringAllocator>
+struct PayloadSerializer<std::basic_string<Char, CharTraits, StringAllocator> > {
+  typedef std::basic_string<Char, CharTraits, StringAllocator> String;
+
+  static const bool raw = false;
+
+  static void write(std::ostream& out, const String& element) {
+    std::uint64_t length = element.size();
+    out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    out.write(reinterpret_cast<const char*>(element.data()), length * sizeof(Char));
+  }
+
+  static bool read(std::istream& in, String& element) {
+    std::uint64_t length;
+    if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+      return false;
+    }
+    element.resize(length);
+    return length == 0 || bool(in.read(reinterpret_cast<char*>(&element[0]), length * sizeof(Char)));
+  }
+};
+
+/*
+ * Fixed-length array whose elements all start on an alignof(T) boundary.
+ * The concurrent queues pad their per-thread records to a cache line with
+ * alignas(64), which plain new[] only honours from C++17 on, so they are
+ * allocated through this instead. It is used like std::unique_ptr<T[]>.
+ */
+template <typename T>
+class AlignedArray {
+private:
+  // The block as allocated, and the aligned elements inside it
+  void* storage;
+  T* items;
+  std::size_t length;
+
+  /*
+   * Private helper method that destroys the elements and frees the block.
+   */
+  void release() {
+    for (std::size_t i = length; i > 0; i--) {
+      items[i - 1].~T();
+    }
+    ::operator delete(storage);
+    storage = nullptr;
+    items = nullptr;
+    length = 0;
+  }
+
+public:
+  /*
+   * Constructor for an empty array.
+   */
+  AlignedArray() : storage(nullptr), items(nullptr), length(0) {
+  }
+
+  /*
+   * Constructor for an array of "newLength" default-constructed elements.
+   */
+  explicit AlignedArray(std::size_t newLength) : AlignedArray() {
+    reset(newLength);
+  }
+
+  AlignedArray(const AlignedArray&) = delete;
+  AlignedArray& operator=(const AlignedArray&) = delete;
+
+  ~AlignedArray() {
+    release();
+  }
+
+  /*
+   * Replaces the array with "newLength" default-constructed elements.
+   */
+  void reset(std::size_t newLength) {
+    release();
+    std::size_t bytes = newLength * sizeof(T);
+    std::size_t space = bytes + alignof(T) - 1;
+    storage = ::operator new(space);
+    void* start = storage;
+    items = static_cast<T*>(std::align(alignof(T), bytes, start, space));
+    for (; length < newLength; length++) {
+      new (items + length) T();
+    }
+  }
+
+  T& operator[](std::size_t index) {
+    return items[index];
+  }
+
+  const T& operator[](std::size_t index) const {
+    return items[index];
+  }
+};
+
+/*
+ * Keys are what the heap actually sorts on. By default a key is just the
+ * priority. In stable mode each key also carries an insertion sequence number
+ * so equal priorities come out first in, first out.
+ */
+template <typename Priority, typename Compare, bool Stable, typename Enable = void>
+struct HeapKeys {
+  typedef Priority Key;
+
+  // Sequence numbers are not used, so they never run out
+  static const std::uint64_t sequenceLimit = UINT64_MAX;
+
+  static Key make(const Priority& priority, std::uint64_t) {
+    return priority;
+  }
+
+  static Priority priority(const Key& key) {
+    return key;
+  }
+
+  static std::uint64_t sequence(const Key&) {
+    return 0;
+  }
+
+  static bool before(const Compare& compare, const Key& a, const Key& b) {
+    return compare(a, b);
+  }
+};
+
+/*
+ * Stable keys for any priority type, ordered by the comparator and then by
+ * a 64-bit sequence number.
+ */
+template <typename Priority, typename Compare>
+struct HeapKeys<Priority, Compare, true,
+  typename std::enable_if<!(std::is_same<Priority, int>::value && std::is_same<Compare, std::less<int> >::value)>::type> {
+  struct Key {
+    Priority priority;
+    std::uint64_t sequence;
+  };
+
+  static const std::uint64_t sequenceLimit = UINT64_MAX;
+
+  static Key make(const Priority& priority, std::uint64_t sequence) {
+    Key key = { priority, sequence };
+    return key;
+  }
+
+  static Priority priority(const Key& key) {
+    return key.priority;
+  }
+
+  static std::uint64_t sequence(const Key& key) {
+    return key.sequence;
+  }
+
+  static bool before(const Compare& compare, const Key& a, const Key& b) {
+    if (compare(a.priority, b.priority)) {
+      return true;
+    }
+    if (compare(b.priority, a.priority)) {
+      return false;
+    }
+    return a.sequence < b.sequence;
+  }
+};
+
+/*
+ * Stable keys for the default int priorities. The priority (with its sign
+ * bit flipped so it orders as unsigned) goes in the high 32 bits and the
+ * sequence number in the low 32 bits, so ties are broken by one 64-bit
+ * compare with no extra branch. The heap renumbers its sequence numbers
+ * once every 2^32 inserts to keep them in range.
+ */
+template <typename Priority, typename Compare>
+struct HeapKeys<Priority, Compare, true,
+  typename std::enable_if<std::is_same<Priority, int>::value && std::is_same<Compare, std::less<int> >::value>::type> {
+  typedef std::uint64_t Key;
+
+  static const std::uint64_t sequenceLimit = UINT64_C(1) << 32;
+
+  static Key make(int priority, std::uint64_t sequence) {
+    return (Key(std::uint32_t(priority) ^ UINT32_C(0x80000000)) << 32) | sequence;
+  }
+
+  static int priority(const Key& key) {
+    return int(std::uint32_t(key >> 32) ^ UINT32_C(0x80000000));
+  }
+
+  static std::uint64_t sequence(const Key& key) {
+    return key & UINT64_C(0xFFFFFFFF);
+  }
+
+  static bool before(const Compare&, const Key& a, const Key& b) {
+    return a < b;
+  }
+};
+
+/*
+ * HDR-style histogram of operation latencies in nanoseconds. Values under 16
+ * get a bucket each, and every power of two above that is split into 8
+ * buckets, so any value is recorded to within 12.5% in a fixed 4KB table
+ * with no allocation.
+ */
+class LatencyHistogram {
+public:
+  static const int EXACT = 16;
+  static const int SUB_BUCKETS = 8;
+  static const int BUCKETS = EXACT + 60 * SUB_BUCKETS;
+
+private:
+  // Private fields
+  std::uint64_t counts[BUCKETS];
+  std::uint64_t total;
+  std::uint64_t maximum;
+
+  /*
+   * Private helper method that returns the bucket "nanoseconds" falls in.
+   */
+  static int bucketOf(std::uint64_t nanoseconds) {
+    if (nanoseconds < EXACT) {
+      return int(nanoseconds);
+    }
+    int magnitude = 4;
+    while (magnitude < 63 && (nanoseconds >> (magnitude + 1)) != 0) {
+      magnitude++;
+    }
+    int sub = int(nanoseconds >> (magnitude - 3)) & (SUB_BUCKETS - 1);
+    return EXACT + (magnitude - 4) * SUB_BUCKETS + sub;
+  }
+
+  /*
+   * Private helper method that returns the largest value bucket "bucket"
+   * holds.
+   */
+  static std::uint64_t bucketTop(int bucket) {
+    if (bucket < EXACT) {
+      return bucket;
+    }
+    int magnitude = (bucket - EXACT) / SUB_BUCKETS + 4;
+    int sub = (bucket - EXACT) % SUB_BUCKETS;
+    std::uint64_t width = std::uint64_t(1) << (magnitude - 3);
+    return (SUB_BUCKETS + sub) * width + (width - 1);
+  }
+
+public:
+
+  /*
+   * LatencyHistogram constructor with nothing recorded.
+   */
+  LatencyHistogram() : total(0), maximum(0) {
+    for (int i = 0; i < BUCKETS; i++) {
+      counts[i] = 0;
+    }
+  }
+
+  /*
+   * Records one operation that took "nanoseconds".
+   */
+  void record(std::uint64_t nanoseconds) {
+    counts[bucketOf(nanoseconds)]++;
+    total++;
+    if (nanoseconds > maximum) {
+      maximum = nanoseconds;
+    }
+  }
+
+  /*
+   * Returns the number of operations recorded.
+   */
+  std::uint64_t count() const {
+    return total;
+  }
+
+  /*
+   * Returns the slowest operation recorded, in nanoseconds.
+   */
+  std::uint64_t max() const {
+    return maximum;
+  }
+
+  /*
+   * Returns a latency that at least "percent" percent of the operations
+   * took no longer than, to within the bucket width. Returns 0 if nothing
+   * has been recorded.
+   */
+  std::uint64_t percentile(double percent) const {
+    if (total == 0) {
+      return 0;
+    }
+    double wanted = total * percent / 100;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (seen > 0 && seen >= wanted) {
+        std::uint64_t top = bucketTop(i);
+        return top < maximum ? top : maximum;
+      }
+    }
+    return maximum;
+  }
+
+  /*
+   * Returns the number of operations recorded in bucket "bucket", for
+   * exporters that want the whole distribution.
+   */
+  std::uint64_t bucket_count(int bucket) const {
+    return counts[bucket];
+  }
+
+  /*
+   * Returns the largest latency bucket "bucket" holds, in nanoseconds.
+   */
+  static std::uint64_t bucket_limit(int bucket) {
+    return bucketTop(bucket);
+  }
+};
+
+/*
+ * Snapshot of what an instrumented PriorityQueue has done, as returned by
+ * stats(). Comparisons and moves are counted inside the sifts, so dividing
+ * them by "sifts" gives the average work per sift.
+ */
+class PriorityQueueStats {
+public:
+
+  // Operations with a latency histogram each
+  enum Operation { INSERT, POP, CHANGE_PRIORITY, ERASE, OPERATIONS };
+
+  // Sifts run, up or down, including the ones in a Floyd build
+  std::uint64_t sifts;
+
+  // Key comparisons made by the sifts
+  std::uint64_t comparisons;
+
+  // Nodes moved by the sifts
+  std::uint64_t moves;
+
+  // Linear scans by value, and the nodes they looked at
+  std::uint64_t scans;
+  std::uint64_t scanned;
+
+  // Times the heap arrays had to grow into new memory
+  std::uint64_t reallocations;
+
+  // Latency of each kind of operation
+  LatencyHistogram latencies[OPERATIONS];
+
+  /*
+   * PriorityQueueStats constructor with every count at zero.
+   */
+  PriorityQueueStats() : sifts(0), comparisons(0), moves(0), scans(0), scanned(0), reallocations(0) {
+  }
+};
+
+/*
+ * Instrumentation policy to give PriorityQueue by default. Every hook is
+ * empty, and the policy is held as an empty base, so it compiles away to
+ * nothing. stats() on an uninstrumented queue is always all zeroes.
+ */
+class NoInstrumentation {
+public:
+
+  /*
+   * Times nothing.
+   */
+  class Timer {
+  public:
+    Timer(const NoInstrumentation&, PriorityQueueStats::Operation) {
+    }
+  };
+
+  void countSift() const {
+  }
+
+  void countComparisons(int) const {
+  }
+
+  void countMoves(int) const {
+  }
+
+  void countScan(int) const {
+  }
+
+  void countReallocation() const {
+  }
+
+  PriorityQueueStats snapshot() const {
+    return PriorityQueueStats();
+  }
+};
+
+/*
+ * Instrumentation policy that counts the work done in the heap's hot paths
+ * and records the latency of each insert, pop, change_priority and erase.
+ * Nothing here is thread safe, so it should be read from the thread that
+ * owns the queue (or under the same lock).
+ */
+class CountingInstrumentation {
+private:
+  // Private fields
+  mutable PriorityQueueStats stats;
+
+public:
+
+  /*
+   * Times one operation for as long as it is in scope.
+   */
+  class Timer {
+  private:
+    const CountingInstrumentation& owner;
+    PriorityQueueStats::Operation operation;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    Timer(const CountingInstrumentation& newOwner, PriorityQueueStats::Operation newOperation)
+      : owner(newOwner), operation(newOperation), start(std::chrono::steady_clock::now()) {
+    }
+
+    ~Timer() {
+      std::chrono::nanoseconds taken = std::chrono::steady_clock::now() - start;
+      owner.stats.latencies[operation].record(taken.count());
+    }
+  };
+
+  void countSift() const {
+    stats.sifts++;
+  }
+
+  void countComparisons(int count) const {
+    stats.comparisons += count;
+  }
+
+  void countMoves(int count) const {
+    stats.moves += count;
+  }
+
+  void countScan(int length) const {
+    stats.scans++;
+    stats.scanned += length;
+  }
+
+  void countReallocation() const {
+    stats.reallocations++;
+  }
+
+  PriorityQueueStats snapshot() const {
+    return stats;
+  }
+};
+
+/*
+ * What a bounded PriorityQueue does with an insert once it is full.
+ */
+enum class OverflowPolicy {
+  // Keep the best elements seen: a new element replaces the worst one if it
+  // comes out before it, and is turned away otherwise
+  EVICT_WORST,
+
+  // Keep the first elements that fit: every insert is turned away
+  REJECT_NEW
+};
 
 /*
  * This class implements a priority queue ADT
- * with priorities specified in ints.
+ * with priorities specified in ints by default.
  * Lower priority values precede higher values in
  * the ordering.
  * The template type E is the element type.
+ * Arity is the number of children each heap node has. The default of 2 is
+ * a binary heap; 4 or 8 give a shallower tree whose children share a cache
+ * line, which suits large queues with cheap keys.
+ * Priority is the priority type, and Compare(a, b) returns true when a
+ * should precede b. Any default-constructible, copyable priority works, e.g.
+ * 64-bit timestamps, doubles, or (deadline, tiebreak) pairs.
+ * Stable makes elements with equal priorities leave in the order they were
+ * inserted, at the cost of a sequence number stored next to each key.
+ * Allocator supplies the memory for elements, and is rebound for the heap's
+ * own bookkeeping arrays, so a whole queue can live in one arena. With a
+ * std::pmr::polymorphic_allocator, elements that take the same allocator
+ * (such as std::pmr::string) get their own memory from the arena too.
+ * Instrumentation is a compile-time policy. NoInstrumentation costs nothing,
+ * and CountingInstrumentation fills in the snapshot stats() returns.
+ * A queue can also be bounded to a fixed number of elements, to keep only
+ * the best K of a stream; see the (capacity, policy) constructor.
  * See the tests for examples.
  */
-template <typename E>
+template <typename E, int Arity = 2, typename Priority = int, typename Compare = std::less<Priority>,
+          bool Stable = false, typename Allocator = std::allocator<E>,
+          typename Instrumentation = NoInstrumentation>
 class PriorityQueue {
 
-private:
+  static_assert(Arity >= 2, "PriorityQueue needs an arity of at least 2");
+
+private:
+
+  /*
+   * Class for MinHeap internal structure.
+   * The heap is stored as a structure of arrays. The heap-ordered arrays only
+   * hold the priority of each node and the index of its payload, so sifting
+   * touches packed keys and never moves an element. Payloads sit densely in
+   * their own vector and are moved at most once per removal.
+   * The comparator and the instrumentation policy are held as private bases
+   * so empty ones take no space.
+   */
+  class MinHeap : private Compare, private Instrumentation {
+  private:
+
+    // What the heap sorts on
+    typedef HeapKeys<Priority, Compare, Stable> Keys;
+    typedef typename Keys::Key Key;
+
+    // Allocators for the bookkeeping arrays, rebound from the element allocator
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Key> KeyAllocator;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<int> IntAllocator;
+    typedef std::vector<int, IntAllocator> IntVector;
+
+    // Whether keys can use the SIMD child search
+    typedef std::integral_constant<bool,
+      std::is_same<Key, int>::value && std::is_same<Compare, std::less<int> >::value> SimdKeys;
+
+    /*
+     * Private helper method for calculating the location of a
+     * parent node from a given index.
+     */
+    int getParent(int index) const {
+      return (index - 1) / Arity;
+    }
+
+    /*
+     * Private helper method for calculating the location of the
+     * first child of a given index. The other children follow it directly.
+     */
+    int getFirstChild(int index) const {
+      return index * Arity + 1;
+    }
+
+#if defined(PRIORITY_QUEUE_SIMD_AVX2) || defined(PRIORITY_QUEUE_SIMD_SSE2)
+    /*
+     * Private helpers for the x86 child search. Plain SSE2 has no 32-bit
+     * min, so it is built from a compare and a blend.
+     */
+    static __m128i min4(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+      return _mm_min_epi32(a, b);
+#else
+      __m128i less = _mm_cmplt_epi32(a, b);
+      return _mm_or_si128(_mm_and_si128(less, a), _mm_andnot_si128(less, b));
+#endif
+    }
+
+    static __m128i broadcastMin4(__m128i m) {
+      m = min4(m, _mm_shuffle_epi32(m, 0x4E));
+      return min4(m, _mm_shuffle_epi32(m, 0xB1));
+    }
+
+    static int lowestBit(int mask) {
+      return __builtin_ctz(mask);
+    }
+#endif
+
+    /*
+     * Private helper method that returns the offset of the smallest of the
+     * "count" contiguous keys starting at "children", picking the first one on
+     * ties. This version is for arbitrary keys and comparators.
+     */
+    int findSmallest(const Key* children, int count, std::false_type) const {
+      int smallest = 0;
+      for (int k = 1; k < count; k++) {
+        if (keyBefore(children[k], children[smallest])) {
+          smallest = k;
+        }
+      }
+      return smallest;
+    }
+
+    /*
+     * Same as above, for plain int keys ordered by std::less. A full group of
+     * children is searched with SIMD when the arity is a multiple of the
+     * vector width, otherwise a plain scan is used.
+     */
+    int findSmallest(const int* children, int count, std::true_type) const {
+#if defined(PRIORITY_QUEUE_SIMD_AVX2)
+      if (Arity % 8 == 0 && count == Arity) {
+        __m256i m = _mm256_loadu_si256((const __m256i*) children);
+        for (int k = 8; k < Arity; k += 8) {
+          m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i*) (children + k)));
+        }
+        __m128i half = min4(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+        __m256i smallest = _mm256_broadcastd_epi32(broadcastMin4(half));
+        for (int k = 0; k < Arity; k += 8) {
+          __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (children + k)), smallest);
+          int mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+          if (mask != 0) {
+            return k + lowestBit(mask);
+          }
+        }
+      }
+#endif
+#if defined(PRIORITY_QUEUE_SIMD_AVX2) || defined(PRIORITY_QUEUE_SIMD_SSE2)
+      if (Arity % 4 == 0 && count == Arity) {
+        __m128i m = _mm_loadu_si128((const __m128i*) children);
+        for (int k = 4; k < Arity; k += 4) {
+          m = min4(m, _mm_loadu_si128((const __m128i*) (children + k)));
+        }
+        __m128i smallest = broadcastMin4(m);
+        for (int k = 0; k < Arity; k += 4) {
+          __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (children + k)), smallest);
+          int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+          if (mask != 0) {
+            return k + lowestBit(mask);
+          }
+        }
+      }
+#endif
+#if defined(PRIORITY_QUEUE_SIMD_NEON)
+      if (Arity % 4 == 0 && count == Arity) {
+        int32x4_t m = vld1q_s32(children);
+        for (int k = 4; k < Arity; k += 4) {
+          m = vminq_s32(m, vld1q_s32(children + k));
+        }
+        int smallest = vminvq_s32(m);
+        for (int k = 0; k < Arity; k++) {
+          if (children[k] == smallest) {
+            return k;
+          }
+        }
+      }
+#endif
+      int smallest = 0;
+      for (int k = 1; k < count; k++) {
+        if (children[k] < children[smallest]) {
+          smallest = k;
+        }
+      }
+      return smallest;
+    }
+
+    /*
+     * Private helper method that places the node with key "key" and payload
+     * "payload" at heap index "index", keeping the position map up to date.
+     */
+    void place(int index, const Key& key, int payload) {
+      keys[index] = key;
+      order[index] = payload;
+      positions[payload] = index;
+    }
+
+    /*
+     * Private helper method that hands out a slot for the payload at
+     * "payload". Slots of removed nodes are reused first.
+     */
+    int acquireSlot(int payload) {
+      int slot;
+      if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+      }
+      else {
+        slot = slotPayloads.size();
+        slotPayloads.push_back(-1);
+        generations.push_back(0);
+      }
+      slotPayloads[slot] = payload;
+      return slot;
+    }
+
+    /*
+     * Private helper method that gives back the slot of a removed node.
+     * Bumping the generation invalidates any handle still holding the slot.
+     */
+    void releaseSlot(int slot) {
+      slotPayloads[slot] = -1;
+      generations[slot]++;
+      freeSlots.push_back(slot);
+    }
+
+    /*
+     * Private helper method that appends a payload built from "args" and
+     * returns its index, without placing it in the heap yet.
+     */
+    template <typename... Args>
+    int addPayload(Args&&... args) {
+      int payload = values.size();
+      values.emplace_back(std::forward<Args>(args)...);
+      slots.push_back(acquireSlot(payload));
+      positions.push_back(-1);
+      return payload;
+    }
+
+    /*
+     * Private helper method that drops the payload at "payload" once its node
+     * has left the heap. The last payload is moved into the gap so the
+     * payload vector stays dense.
+     */
+    void removePayload(int payload) {
+      // A tombstone gave its slot back when it was buried
+      if (slots[payload] != -1) {
+        releaseSlot(slots[payload]);
+      }
+
+      int last = values.size() - 1;
+      if (payload != last) {
+        values[payload] = std::move(values[last]);
+        slots[payload] = slots[last];
+        positions[payload] = positions[last];
+        if (slots[payload] != -1) {
+          slotPayloads[slots[payload]] = payload;
+        }
+        order[positions[payload]] = payload;
+      }
+      values.pop_back();
+      slots.pop_back();
+      positions.pop_back();
+    }
+
+    /*
+     * Helper method that returns the highest priority instance of a particular value
+     */
+    int findFirst(const E& element) const {
+      instruments().countScan(getSize());
+      int first = -1;
+      for (int i = 0; i < getSize(); i++) {
+        if (isLive(i) && getValue(i) == element && (first == -1 || before(getPriority(i), getPriority(first)))) {
+          first = i;
+        }
+      }
+      return first;
+    }
+
+    /*
+     * Private siftUp method that follows a node up the heap until it finds a
+     * parent that is not bigger, at which point it knows the heap is sorted.
+     * Parents are shifted down into the hole rather than swapped, and the node
+     * is written once at the end. Takes at most O(log n) steps.
+     */
+    void siftUp(int index) {
+      Key key = keys[index];
+      int payload = order[index];
+      instruments().countSift();
+
+      while (index > 0) {
+        int parent = getParent(index);
+
+        // Is parent already in order?
+        instruments().countComparisons(1);
+        if (!keyBefore(key, keys[parent])) {
+          break;
+        }
+        place(index, keys[parent], order[parent]);
+        instruments().countMoves(1);
+        index = parent;
+      }
+      place(index, key, payload);
+    }
+
+    /*
+     * Private siftDown method that follows a node down the heap, shifting its
+     * smallest child up into the hole until no child is smaller.
+     * Takes at most O(log n) steps.
+     */
+    void siftDown(int index) {
+      int size = keys.size();
+      if (index >= size) {
+        return;
+      }
+      Key key = keys[index];
+      int payload = order[index];
+      instruments().countSift();
+
+      while (true) {
+        int first = getFirstChild(index);
+        if (first >= size) {
+          break;
+        }
+
+        // Find the smallest of the (up to Arity) children
+        int count = std::min(Arity, size - first);
+        int smallest = first + findSmallest(&keys[first], count, SimdKeys());
+
+        // Is the smallest child already in order?
+        instruments().countComparisons(count);
+        if (!keyBefore(keys[smallest], key)) {
+          break;
+        }
+        place(index, keys[smallest], order[smallest]);
+        instruments().countMoves(1);
+        index = smallest;
+      }
+      place(index, key, payload);
+    }
+
+    /*
+     * Private heapify method to order the values of the entire heap.
+     * Uses Floyd's bottom-up build, sifting down every internal node starting
+     * from the last parent and working its way up to the root. This is O(n)
+     * overall, so it is only used for bulk inserts.
+     */
+    void heapify() {
+      if (keys.size() < 2) {
+        return;
+      }
+      for (int i = getParent(keys.size() - 1); i >= 0; i--) {
+        siftDown(i);
+      }
+    }
+
+    /*
+     * Private helper method that returns true if the last "appended" nodes,
+     * just added behind an existing heap, are cheaper to sift up one at a
+     * time than to rebuild everything with heapify(). Sifting costs about
+     * k log2(n) for k new nodes in a heap of n, and the rebuild about n, so
+     * sifting wins while k log2(n) < n. Into an empty heap it is always a
+     * rebuild.
+     */
+    bool siftsAppended(int appended) const {
+      int size = keys.size();
+      if (appended <= 0 || appended >= size) {
+        return false;
+      }
+      int height = 1;
+      for (int n = size; n > 1; n /= 2) {
+        height++;
+      }
+      return (long long)appended * height < size;
+    }
+
+    /*
+     * Private helper method that sifts up each of the last "appended" nodes
+     * in turn, oldest first.
+     */
+    void siftUpAppended(int appended) {
+      for (int i = keys.size() - appended; i < keys.size(); i++) {
+        siftUp(i);
+      }
+    }
+
+    /*
+     * Private helper method that removes the node at heap index "index" by
+     * moving the last node into its place and sifting that one node.
+     */
+    void removeAt(int index) {
+      int payload = order[index];
+      int last = keys.size() - 1;
+      forgetWorst(payload);
+
+      if (index != last) {
+        Key oldKey = keys[index];
+        place(index, keys[last], order[last]);
+        keys.pop_back();
+        order.pop_back();
+
+        if (keyBefore(keys[index], oldKey)) {
+          siftUp(index);
+        }
+        else {
+          siftDown(index);
+        }
+      }
+      else {
+        keys.pop_back();
+        order.pop_back();
+      }
+      removePayload(payload);
+    }
+
+    /*
+     * Private helper method that removes every node marked in "doomed" (there
+     * are "count" of them) by compacting the rest to the front of the heap
+     * arrays and rebuilding them with one Floyd build.
+     */
+    void rebuildWithout(const std::vector<bool>& doomed, int count) {
+      std::vector<int> taken;
+      taken.reserve(count);
+      int kept = 0;
+      for (int i = 0; i < keys.size(); i++) {
+        if (doomed[i]) {
+          taken.push_back(order[i]);
+        }
+        else {
+          place(kept++, keys[i], order[i]);
+        }
+      }
+      keys.resize(kept);
+      order.resize(kept);
+
+      // Highest payload indexes first, as in popFront()
+      std::sort(taken.begin(), taken.end());
+      for (int i = count - 1; i >= 0; i--) {
+        removePayload(taken[i]);
+      }
+
+      heapify();
+      rebuildWorst();
+    }
+
+    /*
+     * Private helper method that turns the node at heap index "index" into a
+     * tombstone. Its slot is given back straight away, so handles to it stop
+     * matching, but the node itself stays in the heap until it reaches the
+     * root or the heap is compacted.
+     */
+    void bury(int index) {
+      forgetWorst(order[index]);
+      releaseSlot(slots[order[index]]);
+      slots[order[index]] = -1;
+      deadCount++;
+    }
+
+    /*
+     * Private helper method that pops tombstones off the root until a live
+     * node is at the front, so getMin() never has to skip anything.
+     */
+    void purgeFront() {
+      while (deadCount > 0 && !keys.empty() && !isLive(0)) {
+        removeAt(0);
+        deadCount--;
+      }
+    }
+
+    /*
+     * Private helper method to call after burying nodes. Compacts the heap if
+     * tombstones have passed the compaction ratio, and otherwise just makes
+     * sure the root is live.
+     */
+    void settleDead() {
+      if (deadCount > compactionRatio * keys.size()) {
+        compact();
+      }
+      else {
+        purgeFront();
+      }
+    }
+
+    /*
+     * Private helper method that returns true if the heap keeps track of its
+     * worst node, which it only needs to as a bounded heap that evicts.
+     */
+    bool tracksWorst() const {
+      return bound > 0 && overflow == OverflowPolicy::EVICT_WORST;
+    }
+
+    /*
+     * Private helper method that returns the key of the node holding "slot".
+     */
+    const Key& slotKey(int slot) const {
+      return keys[positions[slotPayloads[slot]]];
+    }
+
+    /*
+     * Private helper method that returns true if the node holding slot "a"
+     * should come out after the one holding slot "b", which puts it nearer
+     * the root of the worst-first heap.
+     */
+    bool slotAfter(int a, int b) const {
+      return keyBefore(slotKey(b), slotKey(a));
+    }
+
+    /*
+     * Private helper method that puts "slot" at index "index" of the
+     * worst-first heap.
+     */
+    void placeWorst(int index, int slot) {
+      worst[index] = slot;
+      worstPositions[slot] = index;
+    }
+
+    /*
+     * Private helper methods that sift the slot at "index" of the worst-first
+     * heap up or down, the same way as the main heap's own sifts.
+     */
+    void worstUp(int index) {
+      int slot = worst[index];
+      while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!slotAfter(slot, worst[parent])) {
+          break;
+        }
+        placeWorst(index, worst[parent]);
+        index = parent;
+      }
+      placeWorst(index, slot);
+    }
+
+    void worstDown(int index) {
+      int slot = worst[index];
+      int count = worst.size();
+      while (true) {
+        int child = 2 * index + 1;
+        if (child >= count) {
+          break;
+        }
+        if (child + 1 < count && slotAfter(worst[child + 1], worst[child])) {
+          child++;
+        }
+        if (!slotAfter(worst[child], slot)) {
+          break;
+        }
+        placeWorst(index, worst[child]);
+        index = child;
+      }
+      placeWorst(index, slot);
+    }
+
+    /*
+     * Private helper method that adds the node that has just been given
+     * "slot" to the worst-first heap.
+     */
+    void trackWorst(int slot) {
+      if (worstPositions.size() < slotPayloads.size()) {
+        worstPositions.resize(slotPayloads.size(), -1);
+      }
+      worst.push_back(slot);
+      worstUp(worst.size() - 1);
+    }
+
+    /*
+     * Private helper method that takes the payload at "payload" out of the
+     * worst-first heap as its node stops being live. It must be called while
+     * every other live node is still where its position map says it is.
+     */
+    void forgetWorst(int payload) {
+      int slot = slots[payload];
+      if (!tracksWorst() || slot == -1) {
+        return;
+      }
+      int index = worstPositions[slot];
+      int last = worst.back();
+      worstPositions[slot] = -1;
+      worst.pop_back();
+      if (index < worst.size()) {
+        placeWorst(index, last);
+        worstUp(index);
+        worstDown(worstPositions[last]);
+      }
+    }
+
+    /*
+     * Private helper method that rebuilds the worst-first heap from scratch
+     * after a bulk change to the main heap.
+     */
+    void rebuildWorst() {
+      if (!tracksWorst()) {
+        return;
+      }
+      worst.clear();
+      worstPositions.assign(slotPayloads.size(), -1);
+      for (int i = 0; i < keys.size(); i++) {
+        if (isLive(i)) {
+          worstPositions[slots[order[i]]] = worst.size();
+          worst.push_back(slots[order[i]]);
+        }
+      }
+      for (int i = (int)worst.size() / 2 - 1; i >= 0; i--) {
+        worstDown(i);
+      }
+    }
+
+    /*
+     * Private helper method that makes room in a bounded heap for a new node
+     * with priority "priority", evicting the worst node if the heap is full.
+     * Returns false if the new node should be turned away instead, which
+     * only takes a look at the root of the worst-first heap.
+     */
+    bool makeRoom(const Priority& priority) {
+      if (getLiveSize() >= bound) {
+        if (overflow == OverflowPolicy::REJECT_NEW || !before(priority, Keys::priority(slotKey(worst[0])))) {
+          return false;
+        }
+        removeAt(positions[slotPayloads[worst[0]]]);
+        purgeFront();
+      }
+
+      // Tombstones count against the memory the bound allows for
+      if (getSize() >= bound) {
+        compact();
+      }
+      return true;
+    }
+
+    /*
+     * Private helper method that returns true if a snapshot of "count" nodes
+     * fits within the bound.
+     */
+    bool fits(std::uint64_t count) const {
+      return bound == 0 || count <= (std::uint64_t)bound;
+    }
+
+    /*
+     * Private helper method that notes a reallocation if pushing one more
+     * node just moved the key array, which had room for "oldCapacity".
+     */
+    void checkGrowth(std::size_t oldCapacity) const {
+      if (keys.capacity() != oldCapacity) {
+        instruments().countReallocation();
+      }
+    }
+
+    /*
+     * Fixed header at the start of every snapshot. Snapshots are in native
+     * byte order; a machine with the other order sees a bad magic number.
+     */
+    struct SnapshotHeader {
+      std::uint32_t magic;
+      std::uint32_t version;
+      std::uint32_t arity;
+      std::uint32_t keySize;
+      std::uint32_t payloadSize;
+      std::uint32_t flags;
+      std::uint64_t count;
+      std::uint64_t sequence;
+    };
+
+    // "PQSN" in little-endian order, and the current format version
+    static const std::uint32_t SNAPSHOT_MAGIC = 0x4E535150;
+    static const std::uint32_t SNAPSHOT_VERSION = 1;
+
+    // Snapshot flags
+    static const std::uint32_t SNAPSHOT_STABLE = 1;
+    static const std::uint32_t SNAPSHOT_HEAP_ORDERED = 2;
+    static const std::uint32_t SNAPSHOT_RAW_PAYLOADS = 4;
+
+    // Most nodes read from a stream before the arrays grow again, so a
+    // damaged count cannot ask for more memory than the stream backs up
+    static const std::size_t SNAPSHOT_CHUNK = 1 << 16;
+
+    typedef PayloadSerializer<E> Serializer;
+
+    /*
+     * Private helper method that returns true if "header" describes a
+     * snapshot this heap can read. Node indexes are ints, so no more than
+     * INT_MAX nodes can be read.
+     */
+    bool readable(const SnapshotHeader& header) const {
+      std::uint32_t expected = (Stable ? SNAPSHOT_STABLE : 0) | (Serializer::raw ? SNAPSHOT_RAW_PAYLOADS : 0);
+      return header.magic == SNAPSHOT_MAGIC && header.version == SNAPSHOT_VERSION &&
+             header.keySize == sizeof(Key) && header.payloadSize == (Serializer::raw ? sizeof(E) : 0) &&
+             (header.flags & ~SNAPSHOT_HEAP_ORDERED) == expected &&
+             header.count <= (std::uint64_t)std::numeric_limits<int>::max();
+    }
+
+    /*
+     * Private helper method that reads "count" packed values from "in" into
+     * "into", growing it by at most SNAPSHOT_CHUNK values at a time. Returns
+     * false if the stream runs out first.
+     */
+    template <typename T, typename A>
+    static bool readPacked(std::istream& in, std::vector<T, A>& into, std::uint64_t count) {
+      while (into.size() < count) {
+        std::size_t done = into.size();
+        std::size_t step = count - done < SNAPSHOT_CHUNK ? count - done : SNAPSHOT_CHUNK;
+        into.resize(done + step);
+        if (!in.read(reinterpret_cast<char*>(into.data() + done), step * sizeof(T))) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /*
+     * Private helper method that replaces everything in the heap with the
+     * nodes in "newKeys" and "newValues", which are in heap index order.
+     * Every slot is handed out afresh, and the old ones are released so
+     * handles from before stop matching. If the nodes are not already a
+     * valid heap for this arity they are rebuilt with one Floyd build.
+     */
+    void adopt(std::vector<Key, KeyAllocator>& newKeys, std::vector<E, Allocator>& newValues,
+               std::uint64_t newSequence, bool ordered) {
+      releaseAllSlots();
+
+      int count = newKeys.size();
+      keys.swap(newKeys);
+      values.swap(newValues);
+      order.resize(count);
+      positions.resize(count);
+      slots.resize(count);
+      for (int i = 0; i < count; i++) {
+        order[i] = i;
+        positions[i] = i;
+        slots[i] = acquireSlot(i);
+      }
+      sequence = newSequence;
+      deadCount = 0;
+
+      if (!ordered) {
+        heapify();
+      }
+      rebuildWorst();
+    }
+
+    /*
+     * Private helper method that releases the slot of every node, so every
+     * handle to the heap stops matching.
+     */
+    void releaseAllSlots() {
+      for (int payload = 0; payload < values.size(); payload++) {
+        if (slots[payload] != -1) {
+          releaseSlot(slots[payload]);
+        }
+      }
+      worst.clear();
+      worstPositions.assign(worstPositions.size(), -1);
+    }
+
+    // Smallest heap worth building on more than one thread, and the least
+    // work to give each thread
+    static const int PARALLEL_MINIMUM = 1 << 16;
+    static const int PARALLEL_GRAIN = 1 << 12;
+
+    // Instrumentation counters are not thread safe, so instrumented heaps
+    // always build on one thread
+    typedef std::is_same<Instrumentation, NoInstrumentation> Parallelisable;
+
+    /*
+     * Private helper method that returns how many threads to use for "work"
+     * items when "threads" were asked for, where 0 means one per core.
+     */
+    static int threadsFor(int threads, int work) {
+      if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+      }
+      int most = work / PARALLEL_GRAIN;
+      if (threads > most) {
+        threads = most;
+      }
+      return Parallelisable::value && threads > 1 ? threads : 1;
+    }
+
+    /*
+     * Private helper method that splits positions 0..count-1 into "threads"
+     * contiguous ranges and calls body(begin, end) on each, one range on
+     * this thread and the rest on threads of their own.
+     */
+    template <typename Body>
+    static void parallelFor(int threads, int count, const Body& body) {
+      if (threads <= 1) {
+        body(0, count);
+        return;
+      }
+      int chunk = (count + threads - 1) / threads;
+      std::vector<std::thread> workers;
+      for (int begin = chunk; begin < count; begin += chunk) {
+        int end = begin + chunk < count ? begin + chunk : count;
+        workers.push_back(std::thread([&body, begin, end]() { body(begin, end); }));
+      }
+      body(0, chunk < count ? chunk : count);
+      for (int i = 0; i < workers.size(); i++) {
+        workers[i].join();
+      }
+    }
+
+    /*
+     * Private helper method that is Floyd's build spread over "threads"
+     * threads. Parents are sifted down a level at a time from the bottom up.
+     * Nodes on the same level root subtrees that do not overlap, so each
+     * level is split between the threads, with a join before the level
+     * above. The top levels are too small to be worth splitting, and are
+     * done on this thread.
+     */
+    void parallelHeapify(int threads) {
+      if (keys.size() < 2) {
+        return;
+      }
+      long lastParent = getParent(keys.size() - 1);
+
+      std::vector<long> levelStarts(1, 0);
+      while (levelStarts.back() <= lastParent) {
+        levelStarts.push_back(levelStarts.back() * Arity + 1);
+      }
+
+      for (int level = levelStarts.size() - 2; level >= 0; level--) {
+        int begin = levelStarts[level];
+        int end = levelStarts[level + 1] - 1 < lastParent ? levelStarts[level + 1] - 1 : lastParent;
+        int levelThreads = threadsFor(threads, end - begin + 1);
+        parallelFor(levelThreads, end - begin + 1, [this, begin](int first, int last) {
+          for (int i = last - 1; i >= first; i--) {
+            siftDown(begin + i);
+          }
+        });
+      }
+    }
+
+    /*
+     * Private helper method that makes room for "count" more nodes at the
+     * end of the heap arrays, hands them slots, and returns the number of
+     * nodes there were before. Slots come off a shared free list, so that
+     * part is done on one thread; it is only a few integer writes each.
+     */
+    int growBy(int count) {
+      int base = keys.size();
+      keys.resize(base + count);
+      order.resize(base + count);
+      values.resize(base + count);
+      positions.resize(base + count);
+      slots.resize(base + count);
+      for (int i = base; i < base + count; i++) {
+        order[i] = i;
+        positions[i] = i;
+        slots[i] = acquireSlot(i);
+      }
+      return base;
+    }
+
+    /*
+     * Private helper method that makes sure stable mode has "count"
+     * sequence numbers left, renumbering if needed. Returns false if even
+     * renumbering leaves too few.
+     */
+    bool reserveSequence(std::uint64_t count) {
+      if (Stable && Keys::sequenceLimit - sequence < count) {
+        renumber();
+      }
+      return !Stable || Keys::sequenceLimit - sequence >= count;
+    }
+
+    /*
+     * Private helper method that returns true if key "a" should precede key "b".
+     */
+    bool keyBefore(const Key& a, const Key& b) const {
+      return Keys::before(*this, a, b);
+    }
+
+    /*
+     * Private helper method that builds the key for a new or re-prioritised node.
+     * In stable mode each call takes the next sequence number, so a node whose
+     * priority changes goes to the back of its new priority band.
+     */
+    Key makeKey(const Priority& priority) {
+      if (Stable && sequence == Keys::sequenceLimit) {
+        renumber();
+      }
+      return Keys::make(priority, sequence++);
+    }
+
+    /*
+     * Private helper method that hands out fresh sequence numbers 0..n-1 to the
+     * nodes in key order once the old ones run out. This keeps every key in
+     * the same relative order, so the heap stays valid without a rebuild.
+     */
+    void renumber() {
+      std::vector<int> byKey(keys.size());
+      for (int i = 0; i < byKey.size(); i++) {
+        byKey[i] = i;
+      }
+      std::sort(byKey.begin(), byKey.end(), KeyIndexBefore(*this));
+
+      sequence = 0;
+      for (int i = 0; i < byKey.size(); i++) {
+        keys[byKey[i]] = Keys::make(Keys::priority(keys[byKey[i]]), sequence++);
+      }
+    }
+
+    /*
+     * Orders (key, payload) pairs by their keys, for popFront(count, out).
+     */
+    class NodeBefore {
+    private:
+      const MinHeap& heap;
+
+    public:
+      NodeBefore(const MinHeap& newHeap) : heap(newHeap) {
+      }
+
+      bool operator()(const std::pair<Key, int>& a, const std::pair<Key, int>& b) const {
+        return heap.keyBefore(a.first, b.first);
+      }
+    };
+
+    /*
+     * Output iterator that drops everything written to it, for when
+     * popFront(count, out) has no use for the priorities.
+     */
+    class Discard {
+    public:
+      Discard& operator*() {
+        return *this;
+      }
+
+      Discard& operator++(int) {
+        return *this;
+      }
+
+      template <typename T>
+      Discard& operator=(const T&) {
+        return *this;
+      }
+    };
+
+    /*
+     * Orders heap indexes by their keys, for renumber().
+     */
+    class KeyIndexBefore {
+    private:
+      const MinHeap& heap;
+
+    public:
+      KeyIndexBefore(const MinHeap& newHeap) : heap(newHeap) {
+      }
+
+      bool operator()(int a, int b) const {
+        return heap.keyBefore(heap.keys[a], heap.keys[b]);
+      }
+    };
+
+    // Heap-ordered keys
+    std::vector<Key, KeyAllocator> keys;
+
+    // Heap-ordered payload indexes, parallel to keys
+    IntVector order;
+
+    // Dense payload storage
+    std::vector<E, Allocator> values;
+
+    // Heap index of each payload
+    IntVector positions;
+
+    // Slot owned by each payload
+    IntVector slots;
+
+    // Payload index held by each slot (-1 when the slot is free)
+    IntVector slotPayloads;
+
+    // Generation of each slot, bumped whenever the slot is released
+    IntVector generations;
+
+    // Released slots waiting to be reused
+    IntVector freeSlots;
+
+    // Next sequence number to hand out in stable mode
+    std::uint64_t sequence;
+
+    // Tombstones still in the heap, left behind by lazy erases
+    int deadCount;
+
+    // Whether erases leave tombstones, and the share of the heap they may
+    // take up before it is compacted
+    bool lazy;
+    double compactionRatio;
+
+    // Most live nodes the heap may hold (0 for no bound), and what an
+    // insert does once it is full
+    int bound;
+    OverflowPolicy overflow;
+
+    // Slots of the live nodes in a binary heap with the worst key at the
+    // root, and where each slot is in it, kept only by heaps that evict
+    IntVector worst;
+    IntVector worstPositions;
+
+  public:
+
+    /*
+     * MinHeap constructor that takes the comparator to order priorities with
+     * and the allocator to take memory from.
+     */
+    explicit MinHeap(const Compare& compare = Compare(), const Allocator& allocator = Allocator())
+      : Compare(compare), keys(KeyAllocator(allocator)), order(IntAllocator(allocator)),
+        values(allocator), positions(IntAllocator(allocator)), slots(IntAllocator(allocator)),
+        slotPayloads(IntAllocator(allocator)), generations(IntAllocator(allocator)),
+        freeSlots(IntAllocator(allocator)), sequence(0), deadCount(0), lazy(false),
+        compactionRatio(0.5), bound(0), overflow(OverflowPolicy::EVICT_WORST),
+        worst(IntAllocator(allocator)), worstPositions(IntAllocator(allocator)) {
+    }
+
+    /*
+     * Returns the instrumentation policy the heap reports to.
+     */
+    const Instrumentation& instruments() const {
+      return *this;
+    }
+
+    /*
+     * Returns the allocator elements are stored with.
+     */
+    Allocator getAllocator() const {
+      return values.get_allocator();
+    }
+
+    /*
+     * Returns true if priority "a" should precede priority "b".
+     */
+    bool before(const Priority& a, const Priority& b) const {
+      return static_cast<const Compare&>(*this)(a, b);
+    }
+
+    /*
+     * Returns the size of the MinHeap, which is the same as the size of the
+     * key vector it contains.
+     */
+    int getSize() const {
+      return keys.size();
+    }
+
+    /*
+     * Returns the number of live nodes, which is the size less any
+     * tombstones.
+     */
+    int getLiveSize() const {
+      return keys.size() - deadCount;
+    }
+
+    /*
+     * Returns the number of tombstones in the heap.
+     */
+    int getDeadCount() const {
+      return deadCount;
+    }
+
+    /*
+     * Returns true if the node at heap index "index" has not been erased.
+     */
+    bool isLive(int index) const {
+      return slots[order[index]] != -1;
+    }
+
+    /*
+     * Turns lazy erasing on or off. Turning it off compacts away any
+     * tombstones left over.
+     */
+    void setLazy(bool newLazy) {
+      lazy = newLazy;
+      if (!lazy) {
+        compact();
+      }
+    }
+
+    /*
+     * Returns true if erases leave tombstones.
+     */
+    bool isLazy() const {
+      return lazy;
+    }
+
+    /*
+     * Sets the share of the heap tombstones may take up before it is
+     * compacted.
+     */
+    void setCompactionRatio(double ratio) {
+      compactionRatio = ratio;
+      settleDead();
+    }
+
+    /*
+     * Returns the share of the heap tombstones may take up before it is
+     * compacted.
+     */
+    double getCompactionRatio() const {
+      return compactionRatio;
+    }
+
+    /*
+     * Removes every tombstone and rebuilds the heap once.
+     */
+    void compact() {
+      if (deadCount == 0) {
+        return;
+      }
+      std::vector<bool> doomed(keys.size());
+      for (int i = 0; i < keys.size(); i++) {
+        doomed[i] = !isLive(i);
+      }
+      int count = deadCount;
+      deadCount = 0;
+      rebuildWithout(doomed, count);
+    }
+
+    /*
+     * Returns the value of the highest priority node in the MinHeap.
+     * Otherwise known as the root.
+     */
+    const E& getMin() const {
+      return values[order[0]];
+    }
+
+    /*
+     * Returns the value of the node at a specific index in the heap.
+     * This was added because some of the PriorityQueue functionality is not
+     * generally performed by the MinHeap and so I 'pushed it left' in regard
+     * to the functionality.
+     */
+    const E& getValue(int index) const {
+      return values[order[index]];
+    }
+
+    /*
+     * This exists for a similar reason to getValue(), allowing the PriorityQueue to 
+     * view the values being iterated over.
+     */
+    Priority getPriority(int index) const {
+      return Keys::priority(keys[index]);
+    }
+
+    /*
+     * Returns the heap index of the node a handle refers to, or -1 if the
+     * node has since been removed. This is O(1) thanks to the position map.
+     */
+    int findHandle(int slot, int generation) const {
+      if (slot < 0 || slot >= slotPayloads.size() || generations[slot] != generation) {
+        return -1;
+      }
+      return positions[slotPayloads[slot]];
+    }
+
+    /*
+     * Returns true if the node at heap index "a" should come out before the
+     * node at heap index "b".
+     */
+    bool indexBefore(int a, int b) const {
+      return keyBefore(keys[a], keys[b]);
+    }
+
+    /*
+     * Returns the heap index of the first child of the node at "index".
+     */
+    int firstChildOf(int index) const {
+      return getFirstChild(index);
+    }
+
+    /*
+     * Returns the current generation of a slot, used to build handles.
+     */
+    int getGeneration(int slot) const {
+      return generations[slot];
+    }
+
+    /*
+     * Finds and changes the priority of an element in MinHeap.
+     */
+    void changePriority(const E& element, const Priority& newPriority) {
+      int nodeIndex = findFirst(element);
+      if (nodeIndex != -1) {
+        changePriorityAt(nodeIndex, newPriority);
+      }
+    }
+
+    /*
+     * Changes the priority of the node at a specific index in the heap.
+     */
+    void changePriorityAt(int index, const Priority& newPriority) {
+      Key newKey = makeKey(newPriority);
+      bool moveUp = keyBefore(newKey, keys[index]);
+      int slot = slots[order[index]];
+      keys[index] = newKey;
+
+      // Only the changed node can be out of place, so a single sift fixes it
+      if (moveUp) {
+        siftUp(index);
+      }
+      else {
+        siftDown(index);
+        purgeFront();
+      }
+      if (tracksWorst()) {
+        worstUp(worstPositions[slot]);
+        worstDown(worstPositions[slot]);
+      }
+    }
+
+    /*
+     * Removes the highest priority value from the MinHeap and resorts.
+     */
+    void removeFront() {
+      removeAt(0);
+      purgeFront();
+    }
+
+    /*
+     * Removes the node at heap index "index" with a single sift, or in lazy
+     * mode just marks it as a tombstone.
+     */
+    void eraseAt(int index) {
+      if (lazy) {
+        bury(index);
+        settleDead();
+      }
+      else {
+        removeAt(index);
+      }
+    }
+
+    /*
+     * Removes the highest priority node whose value is "element".
+     * Returns false if there is none.
+     */
+    bool eraseFirst(const E& element) {
+      int nodeIndex = findFirst(element);
+      if (nodeIndex == -1) {
+        return false;
+      }
+      eraseAt(nodeIndex);
+      return true;
+    }
+
+    /*
+     * Removes every node whose heap index is marked in "doomed", and returns
+     * how many that was. A few nodes are removed one at a time; for a
+     * sixteenth of the heap or more it is cheaper to compact what is left
+     * and rebuild it once with a Floyd build. In lazy mode the nodes are
+     * all marked as tombstones first, and compacted at most once after.
+     */
+    int eraseMarked(const std::vector<bool>& doomed) {
+      int count = std::count(doomed.begin(), doomed.end(), true);
+      if (count == 0) {
+        return 0;
+      }
+
+      if (lazy) {
+        for (int i = 0; i < doomed.size(); i++) {
+          if (doomed[i]) {
+            bury(i);
+          }
+        }
+        settleDead();
+        return count;
+      }
+
+      if (count * 16 < getSize()) {
+        // Slots stay put while other nodes move, so look each one up again
+        std::vector<int> doomedSlots;
+        doomedSlots.reserve(count);
+        for (int i = 0; i < doomed.size(); i++) {
+          if (doomed[i]) {
+            doomedSlots.push_back(slots[order[i]]);
+          }
+        }
+        for (int i = 0; i < doomedSlots.size(); i++) {
+          removeAt(positions[slotPayloads[doomedSlots[i]]]);
+        }
+        return count;
+      }
+
+      rebuildWithout(doomed, count);
+      return count;
+    }
 
-  /*
-   * Class for MinHeap internal structure.
-   */
-  class MinHeap {
-  private:
+    /*
+     * Removes the highest priority value from the MinHeap and returns it,
+     * moving it out rather than copying.
+     */
+    E popFront() {
+      E value = std::move(values[order[0]]);
+      removeAt(0);
+      purgeFront();
+      return value;
+    }
 
     /*
-     * Class for HeapNode - the object type this MinHeap implementation stores.
+     * Removes the "count" highest priority values from the MinHeap, moving them
+     * to "out" in priority order. Batches are normally popped one by one. Once
+     * the heap no longer fits in cache, every pop is a chain of cache misses,
+     * and for a batch of a sixteenth of the heap or more it becomes cheaper to
+     * select the smallest keys with nth_element, sort only those, and rebuild
+     * what is left with one Floyd build: O(n + k log k) of mostly sequential
+     * work instead of O(k log n) scattered work.
      */
-    class HeapNode {
-    private:
-      // Private fields
-      int priority;
-      E value;
+    template <typename OutputIt>
+    OutputIt popFront(int count, OutputIt out) {
+      return popFront(count, out, Discard());
+    }
 
-    public:
+    /*
+     * Same as above, but also writes the priority of each value to
+     * "priorities", in the same order.
+     */
+    template <typename OutputIt, typename PriorityIt>
+    OutputIt popFront(int count, OutputIt out, PriorityIt priorities) {
+      count = std::min(count, getLiveSize());
+      if (getSize() < (1 << 18) || count * 16 < getSize()) {
+        for (int i = 0; i < count; i++) {
+          *priorities++ = getPriority(0);
+          *out++ = popFront();
+        }
+        return out;
+      }
 
-      /*
-       * HeapNode constructor that takes a priority and a value.
-       */
-      HeapNode(int newPriority, E newValue) {
-        priority = newPriority;
-        value = newValue;
+      // The selection below must not pick tombstones
+      compact();
+
+      // Pick out the nodes with the smallest keys, in order
+      std::vector<std::pair<Key, int> > nodes;
+      nodes.reserve(keys.size());
+      for (int i = 0; i < keys.size(); i++) {
+        nodes.push_back(std::make_pair(keys[i], order[i]));
       }
+      std::nth_element(nodes.begin(), nodes.begin() + count, nodes.end(), NodeBefore(*this));
+      std::sort(nodes.begin(), nodes.begin() + count, NodeBefore(*this));
 
-      /*
-       * Priority getter.
-       */
-      int getPriority() {
-        return priority;
+      std::vector<int> taken(count);
+      for (int i = 0; i < count; i++) {
+        taken[i] = nodes[i].second;
+        *priorities++ = Keys::priority(nodes[i].first);
+        *out++ = std::move(values[taken[i]]);
       }
 
-      /*
-       * Priority setter.
-       */
-      void setPriority(int newPriority) {
-        priority = newPriority;
+      // Keep the rest of the nodes at the front of the heap arrays
+      keys.resize(nodes.size() - count);
+      order.resize(nodes.size() - count);
+      for (int i = 0; i < keys.size(); i++) {
+        place(i, nodes[count + i].first, nodes[count + i].second);
       }
 
-      /*
-       * Value getter.
-       */
-      E getValue() {
-        return value;
+      // Dropping the highest payload indexes first means the payload moved
+      // into each gap is never one that is still waiting to be dropped
+      std::sort(taken.begin(), taken.end());
+      for (int i = count - 1; i >= 0; i--) {
+        removePayload(taken[i]);
       }
-    };
+
+      heapify();
+      rebuildWorst();
+      return out;
+    }
 
     /*
-     * Private helper method for swapping two MinHeap elements.
-     * It uses a standard swap pattern, taking two indexes of the heap.
+     * Builds a new element in place at the end of the heap and resorts.
+     * Returns the slot of the new node, or -1 if it was rejected.
      */
-    void swap(int indexOne, int indexTwo) {
-      HeapNode tmp = heap[indexOne];
-      heap[indexOne] = heap[indexTwo];
-      heap[indexTwo] = tmp;
+    template <typename... Args>
+    int emplace(const Priority& priority, Args&&... args) {
+      // Check if incoming priority is legal
+      if (PriorityTraits<Priority, Compare>::isLegal(priority)) {
+        if (bound > 0 && !makeRoom(priority)) {
+          return -1;
+        }
+        int payload = addPayload(std::forward<Args>(args)...);
+        std::size_t oldCapacity = keys.capacity();
+        keys.push_back(makeKey(priority));
+        checkGrowth(oldCapacity);
+        order.push_back(payload);
+
+        // Use up-heaping on single values for greater insertion efficiency
+        siftUp(keys.size() - 1);
+        if (tracksWorst()) {
+          trackWorst(slots[payload]);
+        }
+        return slots[payload];
+      }
+      return -1;
     }
 
     /*
-     * Private helper method for calculating the location of a
-     * parent node from a given index.
+     * Inserts a series of new (priority, element) pairs into end of the heap
+     * and resorts. Pass move iterators to move the elements in.
+     * A bulk load is ordered with one O(n + k) Floyd build, but a small
+     * batch of k behind a heap of n is sifted up node by node in
+     * O(k log n) instead, once k log2(n + k) < n + k (see siftsAppended()).
      */
-    int getParent(int index) {
-      if (index % 2 == 1) {
-        return index / 2;
+    template <typename InputIt>
+    void insertAll(InputIt first, InputIt last) {
+      if (bound > 0) {
+        // Each insert may be turned away or evict, so they go one at a time
+        for (; first != last; ++first) {
+          emplace((*first).first, (*first).second);
+        }
+        return;
+      }
+      int before = keys.size();
+      for (; first != last; ++first) {
+        int payload = addPayload((*first).second);
+        positions[payload] = keys.size();
+        std::size_t oldCapacity = keys.capacity();
+        keys.push_back(makeKey((*first).first));
+        checkGrowth(oldCapacity);
+        order.push_back(payload);
       }
-      return (index - 1) / 2;
+      int appended = keys.size() - before;
+      if (siftsAppended(appended)) {
+        siftUpAppended(appended);
+      }
+      else {
+        heapify();
+      }
+      purgeFront();
     }
 
     /*
-     * Helper method that returns the highest priority instance of a particular value
+     * Writes the heap to "out" in the snapshot format: the header, every key
+     * as one packed block, then every payload, all in heap order. Tombstones
+     * are left out, in which case the snapshot is marked as needing a
+     * rebuild when it is loaded.
      */
-    int findFirst(E element) {
-      for (int i = 0; i < getSize(); i++) {
-        if (getValue(i) == element) {
-          return i;
+    void save(std::ostream& out) const {
+      SnapshotHeader header;
+      std::memset(&header, 0, sizeof(header));
+      header.magic = SNAPSHOT_MAGIC;
+      header.version = SNAPSHOT_VERSION;
+      header.arity = Arity;
+      header.keySize = sizeof(Key);
+      header.payloadSize = Serializer::raw ? sizeof(E) : 0;
+      header.flags = (Stable ? SNAPSHOT_STABLE : 0) | (Serializer::raw ? SNAPSHOT_RAW_PAYLOADS : 0) |
+                     (deadCount == 0 ? SNAPSHOT_HEAP_ORDERED : 0);
+      header.count = getLiveSize();
+      header.sequence = sequence;
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      if (deadCount == 0) {
+        out.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(Key));
+      }
+      else {
+        for (int i = 0; i < keys.size(); i++) {
+          if (isLive(i)) {
+            out.write(reinterpret_cast<const char*>(&keys[i]), sizeof(Key));
+          }
+        }
+      }
+      for (int i = 0; i < keys.size(); i++) {
+        if (isLive(i)) {
+          Serializer::write(out, values[order[i]]);
         }
       }
-      return -1;
     }
 
     /*
-     * Private heapify method to order the values of the entire heap.
-     * Finds the value of the second last floor in the heap and works its
-     * way up to the root from there, swapping elements as it goes.
-     * Will do this until it is entirely in order.
+     * Replaces the heap with a snapshot read from "in". Returns false, and
+     * leaves the heap as it was, if the snapshot is damaged, was saved by
+     * a queue with a different key type, stability or payload format, or
+     * holds more nodes than a bounded heap may.
      */
-    void heapify() {
-      bool solved = false;
-
-      // Checks for correctness
-      while (!solved) {
-        solved = true;
+    bool load(std::istream& in) {
+      SnapshotHeader header;
+      if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || !readable(header) ||
+          !fits(header.count)) {
+        return false;
+      }
 
-        // Iterates up from second last floor
-        for (int i = heap.size()/2; i > 0; i--) {
-          int index = i-1;
+      std::vector<Key, KeyAllocator> newKeys(keys.get_allocator());
+      if (!readPacked(in, newKeys, header.count)) {
+        return false;
+      }
 
-          // Is left child smaller?
-          if (heap[index].getPriority() > heap[index*2].getPriority()) {
-            swap(index, index*2);
-            solved = false;
+      std::vector<E, Allocator> newValues(values.get_allocator());
+      if (Serializer::raw) {
+        if (!readPacked(in, newValues, header.count)) {
+          return false;
+        }
+      }
+      else {
+        newValues.reserve(header.count);
+        for (std::uint64_t i = 0; i < header.count; i++) {
+          E element;
+          if (!Serializer::read(in, element)) {
+            return false;
           }
+          newValues.push_back(std::move(element));
+        }
+      }
+
+      bool ordered = (header.flags & SNAPSHOT_HEAP_ORDERED) && header.arity == Arity;
+      adopt(newKeys, newValues, header.sequence, ordered);
+      return true;
+    }
+
+    /*
+     * Same as above, but copies the snapshot out of the "size" bytes at
+     * "data" with two block copies. Only raw payloads can be read this way.
+     */
+    bool load(const char* data, std::size_t size) {
+      static_assert(Serializer::raw, "loading from memory needs trivially copyable elements");
+
+      SnapshotHeader header;
+      if (size < sizeof(header)) {
+        return false;
+      }
+      std::memcpy(&header, data, sizeof(header));
+      if (!readable(header) || !fits(header.count) ||
+          (size - sizeof(header)) / (sizeof(Key) + sizeof(E)) < header.count) {
+        return false;
+      }
 
-          // Is right child smaller?
-          else if (heap[index].getPriority() > heap[index*2+1].getPriority()) {
-            swap(index, index*2+1);
-            solved = false;
+      const char* block = data + sizeof(header);
+      std::vector<Key, KeyAllocator> newKeys(header.count, Key(), keys.get_allocator());
+      std::memcpy(newKeys.data(), block, header.count * sizeof(Key));
+      block += header.count * sizeof(Key);
+
+      std::vector<E, Allocator> newValues(header.count, E(), values.get_allocator());
+      std::memcpy(static_cast<void*>(newValues.data()), block, header.count * sizeof(E));
+
+      bool ordered = (header.flags & SNAPSHOT_HEAP_ORDERED) && header.arity == Arity;
+      adopt(newKeys, newValues, header.sequence, ordered);
+      return true;
+    }
+
+    /*
+     * Same as insertAll(), but for the (priority, element) pairs in
+     * "pairs", using up to "threads" threads. The elements are moved out of
+     * "pairs" if "move" is set. Each thread copies one slice of the pairs
+     * into the heap arrays, and the heap is then built with
+     * parallelHeapify(), unless the pairs are few enough next to the heap
+     * to be sifted up one by one, as in insertAll().
+     */
+    template <typename Pairs>
+    void insertAllParallel(Pairs& pairs, bool move, int threads) {
+      int count = pairs.size();
+      threads = threadsFor(threads, count);
+      if (threads == 1 || bound > 0 || keys.size() + count < PARALLEL_MINIMUM || !reserveSequence(count)) {
+        if (move) {
+          insertAll(std::make_move_iterator(pairs.begin()), std::make_move_iterator(pairs.end()));
+        }
+        else {
+          insertAll(pairs.begin(), pairs.end());
+        }
+        return;
+      }
+
+      int base = growBy(count);
+      std::uint64_t firstSequence = sequence;
+      sequence += count;
+      parallelFor(threads, count, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+          keys[base + i] = Keys::make(pairs[i].first, firstSequence + i);
+          if (move) {
+            values[base + i] = std::move(pairs[i].second);
           }
+          else {
+            values[base + i] = pairs[i].second;
+          }
+        }
+      });
+
+      if (siftsAppended(count)) {
+        siftUpAppended(count);
+      }
+      else {
+        parallelHeapify(threadsFor(threads, keys.size()));
+      }
+      purgeFront();
+    }
+
+    /*
+     * Moves every node of "other" into this heap, using up to "threads"
+     * threads, and leaves "other" empty with its handles invalidated.
+     * Handles to this heap keep working. In stable mode the nodes from
+     * "other" go behind this heap's own among equal priorities, and keep
+     * their order among themselves.
+     */
+    void absorb(MinHeap& other, int threads) {
+      if (bound > 0) {
+        while (other.getLiveSize() > 0) {
+          Priority priority = other.getPriority(0);
+          emplace(priority, other.popFront());
+        }
+        return;
+      }
+      other.compact();
+      int count = other.keys.size();
+      if (count == 0) {
+        return;
+      }
+      if (!reserveSequence(other.sequence)) {
+        other.renumber();
+        reserveSequence(other.sequence);
+      }
+
+      int base = growBy(count);
+      std::uint64_t offset = sequence;
+      sequence += other.sequence;
+      parallelFor(threadsFor(threads, count), count, [&](int first, int last) {
+        for (int i = first; i < last; i++) {
+          const Key& key = other.keys[i];
+          keys[base + i] = Keys::make(Keys::priority(key), offset + Keys::sequence(key));
+          values[base + i] = std::move(other.values[other.order[i]]);
         }
+      });
+
+      other.releaseAllSlots();
+      other.keys.clear();
+      other.order.clear();
+      other.values.clear();
+      other.positions.clear();
+      other.slots.clear();
+
+      if (keys.size() < PARALLEL_MINIMUM) {
+        heapify();
+      }
+      else {
+        parallelHeapify(threadsFor(threads, keys.size()));
+      }
+      purgeFront();
+    }
+
+    /*
+     * Reserves room for "extra" more nodes ahead of a bulk insert.
+     */
+    void reserveExtra(int extra) {
+      // A bounded heap already has room for as many nodes as it may hold
+      if (bound > 0) {
+        return;
+      }
+      int needed = keys.size() + extra;
+      if (needed > keys.capacity()) {
+        // Keep geometric growth so repeated bulk inserts stay amortised
+        reserve(std::max<std::size_t>(needed, keys.capacity() * 2));
+      }
+    }
+
+    /*
+     * Reserves room for "capacity" nodes in every array, so the heap can grow
+     * to that size without reallocating.
+     */
+    void reserve(std::size_t capacity) {
+      if (capacity > keys.capacity()) {
+        instruments().countReallocation();
+      }
+      keys.reserve(capacity);
+      order.reserve(capacity);
+      values.reserve(capacity);
+      positions.reserve(capacity);
+      slots.reserve(capacity);
+      slotPayloads.reserve(capacity);
+      generations.reserve(capacity);
+    }
+
+    /*
+     * Bounds the heap to "newBound" live nodes, with "policy" deciding what
+     * an insert does once it is full, and reserves room for all of them up
+     * front so the heap never allocates again. The heap must be empty.
+     */
+    void setBound(int newBound, OverflowPolicy policy) {
+      bound = newBound < 1 ? 1 : newBound;
+      overflow = policy;
+      reserve(bound);
+      freeSlots.reserve(bound);
+      if (tracksWorst()) {
+        worst.reserve(bound);
+        worstPositions.reserve(bound);
+      }
+    }
+
+    /*
+     * Returns the most live nodes the heap may hold, or 0 if it is unbounded.
+     */
+    int getBound() const {
+      return bound;
+    }
+
+    /*
+     * Returns what an insert into a full bounded heap does.
+     */
+    OverflowPolicy getOverflowPolicy() const {
+      return overflow;
+    }
+
+    /*
+     * Returns the priority of the worst live node, which is what a new node
+     * has to beat once the heap is full. Only heaps that evict keep track of
+     * it, and the heap must not be empty.
+     */
+    Priority getWorstPriority() const {
+      return Keys::priority(slotKey(worst[0]));
+    }
+
+    /*
+     * Returns how many nodes the heap can hold without reallocating.
+     */
+    std::size_t getCapacity() const {
+      return keys.capacity();
+    }
+
+    /*
+     * Gives back memory the heap arrays are not using. The slot table is kept
+     * as it is, since outstanding handles may still refer to its slots.
+     * Tombstones are compacted away first.
+     */
+    void shrinkToFit() {
+      compact();
+      keys.shrink_to_fit();
+      order.shrink_to_fit();
+      values.shrink_to_fit();
+      positions.shrink_to_fit();
+      slots.shrink_to_fit();
+    }
+
+  };
+
+  // Private MinHeap for PriorityQueue
+  MinHeap minHeap;
+
+  // Times a public operation while in scope, if instrumentation is on
+  typedef typename Instrumentation::Timer Timer;
+
+
+public:
+
+  /*
+   * Opaque reference to a single element in the queue, returned by insert().
+   * A handle lets the element be found in O(1) without comparing values, and
+   * stops matching anything once its element has left the queue.
+   */
+  class Handle {
+  private:
+    // Private fields
+    int slot;
+    int generation;
+
+    friend class PriorityQueue;
+
+    /*
+     * Handle constructor used by the queue itself.
+     */
+    Handle(int newSlot, int newGeneration) {
+      slot = newSlot;
+      generation = newGeneration;
+    }
+
+  public:
+
+    /*
+     * Default constructor for a handle that refers to nothing.
+     */
+    Handle() {
+      slot = -1;
+      generation = 0;
+    }
+
+    bool operator==(const Handle& other) const {
+      return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+      return !(*this == other);
+    }
+  };
+
+private:
+
+  /*
+   * Readers that pick what a view yields for the node at a heap index: the
+   * element itself, its priority, or both as a pair.
+   */
+  class ElementReader {
+  public:
+    typedef E value_type;
+    typedef const E& reference;
+    typedef std::forward_iterator_tag category;
+
+    static reference read(const MinHeap& heap, int index) {
+      return heap.getValue(index);
+    }
+  };
+
+  class PriorityReader {
+  public:
+    typedef Priority value_type;
+    typedef Priority reference;
+    typedef std::input_iterator_tag category;
+
+    static reference read(const MinHeap& heap, int index) {
+      return heap.getPriority(index);
+    }
+  };
+
+  class EntryReader {
+  public:
+    typedef std::pair<Priority, const E&> value_type;
+    typedef std::pair<Priority, const E&> reference;
+    typedef std::input_iterator_tag category;
+
+    static reference read(const MinHeap& heap, int index) {
+      return reference(heap.getPriority(index), heap.getValue(index));
+    }
+  };
+
+public:
+
+  /*
+   * Iterator over the nodes of the heap in heap order, reading straight from
+   * the queue's own storage. Tombstones are skipped.
+   */
+  template <typename Reader>
+  class ViewIterator {
+  private:
+    // Private fields
+    const MinHeap* heap;
+    int index;
+
+    friend class PriorityQueue;
+
+    /*
+     * ViewIterator constructor used by the views, which moves on to the first
+     * live node at or after "newIndex".
+     */
+    ViewIterator(const MinHeap* newHeap, int newIndex) : heap(newHeap), index(newIndex) {
+      skipDead();
+    }
+
+    /*
+     * Private helper method that moves past any tombstones.
+     */
+    void skipDead() {
+      while (index < heap->getSize() && !heap->isLive(index)) {
+        index++;
+      }
+    }
+
+  public:
+    typedef typename Reader::category iterator_category;
+    typedef typename Reader::value_type value_type;
+    typedef typename Reader::reference reference;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+
+    /*
+     * Default constructor for an iterator that refers to nothing.
+     */
+    ViewIterator() : heap(nullptr), index(0) {
+    }
+
+    reference operator*() const {
+      return Reader::read(*heap, index);
+    }
+
+    ViewIterator& operator++() {
+      index++;
+      skipDead();
+      return *this;
+    }
+
+    ViewIterator operator++(int) {
+      ViewIterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const ViewIterator& other) const {
+      return index == other.index;
+    }
+
+    bool operator!=(const ViewIterator& other) const {
+      return !(*this == other);
+    }
+  };
+
+  /*
+   * Read-only range over the queue, in the same order as get_all_elements().
+   * A view copies nothing and allocates nothing. It is only good until the
+   * queue is next changed.
+   */
+  template <typename Reader>
+  class View {
+  private:
+    // Private fields
+    const MinHeap* heap;
+
+    friend class PriorityQueue;
+
+    /*
+     * View constructor used by the queue itself.
+     */
+    explicit View(const MinHeap* newHeap) : heap(newHeap) {
+    }
+
+  public:
+    typedef ViewIterator<Reader> iterator;
+    typedef ViewIterator<Reader> const_iterator;
+
+    iterator begin() const {
+      return iterator(heap, 0);
+    }
+
+    iterator end() const {
+      return iterator(heap, heap->getSize());
+    }
+
+    /*
+     * Returns the number of elements in the view.
+     */
+    int size() const {
+      return heap->getLiveSize();
+    }
+
+    /*
+     * Returns true if the view has no elements, false otherwise.
+     */
+    bool empty() const {
+      return heap->getLiveSize() == 0;
+    }
+  };
+
+  typedef View<ElementReader> ElementsView;
+  typedef View<PriorityReader> PrioritiesView;
+  typedef View<EntryReader> EntriesView;
+
+private:
+
+  /*
+   * Class for walking the heap in priority order without changing it.
+   * The frontier is a small heap of its own holding the heap indexes of
+   * nodes that could come next: the root to start with, then the children
+   * of every node taken. The node at its front is always the next one in
+   * priority order, and after k steps it holds at most k * (Arity - 1) + 1
+   * indexes, so each step is O(log k). Tombstones are walked through but
+   * never stopped at.
+   */
+  class Frontier {
+  private:
+
+    /*
+     * Orders heap indexes so the one that comes out first is at the front.
+     */
+    class IndexAfter {
+    private:
+      const MinHeap* heap;
+
+    public:
+      IndexAfter(const MinHeap* newHeap) : heap(newHeap) {
+      }
+
+      bool operator()(int a, int b) const {
+        return heap->indexBefore(b, a);
+      }
+    };
+
+    // Private fields
+    const MinHeap* heap;
+    std::vector<int> nodes;
+
+    /*
+     * Private helper method that takes the front node off the frontier and
+     * puts its children on.
+     */
+    void expand() {
+      int index = nodes.front();
+      std::pop_heap(nodes.begin(), nodes.end(), IndexAfter(heap));
+      nodes.pop_back();
+
+      int first = heap->firstChildOf(index);
+      for (int child = first; child < first + Arity && child < heap->getSize(); child++) {
+        nodes.push_back(child);
+        std::push_heap(nodes.begin(), nodes.end(), IndexAfter(heap));
       }
     }
 
     /*
-     * Private upHeap method that is basically a miniaturised version of the full
-     * heapify method for efficiency reasons. Only ever used when inserting new nodes.
-     * Follows the node up the heap because when it finds a parent that is smaller, it
-     * knows that the heap is sorted.
+     * Private helper method that expands past any tombstones at the front.
      */
-    void upHeap() {
-      int i = heap.size() - 1;
-      int parent = getParent(i);
-
-      // Is parent bigger than the node?
-      while (parent != i && heap[i].getPriority() < heap[parent].getPriority()) {
-        swap(i, parent);
-        i = parent;
-        parent = getParent(i);
+    void skipDead() {
+      while (!nodes.empty() && !heap->isLive(nodes.front())) {
+        expand();
       }
     }
 
-    // Private heap vector for MinHeap class
-    std::vector<HeapNode> heap;
-
   public:
 
     /*
-     * MinHeap constructor that takes no paramaters.
+     * Frontier constructor for a walk that has not started, or for none at
+     * all if "newHeap" is null.
      */
-    MinHeap() {
-      heap = std::vector<HeapNode>();
+    explicit Frontier(const MinHeap* newHeap = nullptr) : heap(newHeap) {
+      if (heap != nullptr && heap->getSize() > 0) {
+        nodes.push_back(0);
+        skipDead();
+      }
     }
 
     /*
-     * Returns the size of the MinHeap, which is the same as the size of the
-     * heap vector it contains.
+     * Returns true once every node has been walked.
      */
-    int getSize() {
-      return heap.size();
+    bool done() const {
+      return nodes.empty();
     }
 
     /*
-     * Returns the value of the highest priority node in the MinHeap.
-     * Otherwise known as the root.
+     * Returns the heap index of the next node in priority order.
      */
-    E getMin() {
-      return heap[0].getValue();
+    int next() const {
+      return nodes.front();
     }
 
     /*
-     * Returns the value of a HeapNode at a specific index in the vector.
-     * This was added because some of the PriorityQueue functionality is not
-     * generally performed by the MinHeap and so I 'pushed it left' in regard
-     * to the functionality.
+     * Moves on to the node after next().
      */
-    E getValue(int index) {
-      return heap[index].getValue();
+    void advance() {
+      expand();
+      skipDead();
     }
 
     /*
-     * This exists for a similar reason to getValue(), allowing the PriorityQueue to 
-     * view the values being iterated over.
+     * Makes room for a walk of "count" nodes.
      */
-    int getPriority(int index) {
-      return heap[index].getPriority();
+    void reserve(int count) {
+      nodes.reserve(count * (Arity - 1) + 1);
     }
+  };
+
+public:
+
+  /*
+   * Iterator that yields the elements of the queue lazily in priority order,
+   * without touching the queue. Each step is O(log k) after k steps, so
+   * reading only the first few elements is cheap. It is only good until the
+   * queue is next changed.
+   */
+  class SortedIterator {
+  private:
+    // Private fields
+    const MinHeap* heap;
+    Frontier frontier;
+
+    friend class PriorityQueue;
 
     /*
-     * Finds and changes the priority of an element in MinHeap.
+     * SortedIterator constructor used by the queue itself.
      */
-    void changePriority(E element, int newPriority) {
-      int nodeIndex = findFirst(element);
-      if (nodeIndex != -1) {
-        heap[nodeIndex].setPriority(newPriority);
-        heapify();
-      }
+    explicit SortedIterator(const MinHeap* newHeap) : heap(newHeap), frontier(newHeap) {
     }
 
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef E value_type;
+    typedef const E& reference;
+    typedef std::ptrdiff_t difference_type;
+    typedef const E* pointer;
+
     /*
-     * Removes the highest priority value from the MinHeap and resorts.
+     * Default constructor for the iterator past the last element.
      */
-    void removeFront() {
-      // Swap lowest and highest priority nodes
-      swap(0, heap.size()-1);
-      // Remove highest priority node
-      heap.pop_back();
-      heapify();
+    SortedIterator() : heap(nullptr) {
+    }
+
+    reference operator*() const {
+      return heap->getValue(frontier.next());
+    }
+
+    pointer operator->() const {
+      return &heap->getValue(frontier.next());
     }
 
     /*
-     * Inserts a new element into end of the heap and resorts.
+     * Returns the priority of the element the iterator is at.
      */
-    void insert(int priority, E element) {
-      // Check if incoming priority is legal
-      if (priority >= 0) {
-        heap.push_back(HeapNode(priority, element));
+    Priority priority() const {
+      return heap->getPriority(frontier.next());
+    }
 
-        // Use up-heaping on single values for greater insertion efficiency
-        upHeap();
-      }
+    SortedIterator& operator++() {
+      frontier.advance();
+      return *this;
+    }
+
+    SortedIterator operator++(int) {
+      SortedIterator old = *this;
+      ++*this;
+      return old;
     }
 
     /*
-     * Inserts a series of new elements into end of the heap and resorts.
+     * Iterators are equal once both have run off the end. Two that are
+     * still going are equal if they are at the same node.
      */
-    void insertAll(std::vector<std::pair<int,E> > newValues) {
-      for (int i = 0; i < newValues.size(); i++) {
-        heap.push_back(HeapNode(newValues[i].first, newValues[i].second));
+    bool operator==(const SortedIterator& other) const {
+      if (frontier.done() || other.frontier.done()) {
+        return frontier.done() && other.frontier.done();
       }
-      heapify();
+      return frontier.next() == other.frontier.next();
     }
 
+    bool operator!=(const SortedIterator& other) const {
+      return !(*this == other);
+    }
   };
 
-  // Private MinHeap for PriorityQueue
-  MinHeap minHeap;
+  /*
+   * A constructor, if you need it.
+   */
+  PriorityQueue() {
+  }
 
+  /*
+   * Constructor that takes the allocator to store elements with, such as
+   * an arena or a per-thread pool.
+   */
+  explicit PriorityQueue(const Allocator& allocator) : minHeap(Compare(), allocator) {
+  }
 
-public:
+  /*
+   * Constructor that takes the comparator to order priorities with, for
+   * comparators that carry state, and optionally an allocator.
+   */
+  explicit PriorityQueue(const Compare& compare, const Allocator& allocator = Allocator())
+    : minHeap(compare, allocator) {
+  }
 
   /*
-   * A constructor, if you need it.
+   * Constructor for a bounded queue that holds at most "capacity" elements
+   * (at least 1), for keeping the best K of a stream. Memory for all of
+   * them is reserved up front, and the queue never grows past it.
+   * Once the queue is full, "policy" decides what an insert does:
+   * EVICT_WORST turns away an element that is no better than the current
+   * worst in O(1), and otherwise evicts the worst to make room, in
+   * O(log n); REJECT_NEW turns every insert away. Rejected inserts return
+   * a handle that refers to nothing, the same as for an illegal priority.
+   * Bulk inserts and merge() go through the same rule one element at a time.
    */
-  PriorityQueue() {
-    minHeap = MinHeap();
+  PriorityQueue(int capacity, OverflowPolicy policy, const Compare& compare = Compare(),
+                const Allocator& allocator = Allocator())
+    : minHeap(compare, allocator) {
+    minHeap.setBound(capacity, policy);
   }
 
   /*
    * This function adds a new element "element" to the queue
    * with priorioty "priority".
+   * Returns a handle to the new element, which refers to nothing if
+   * the priority was rejected.
+   */
+  Handle insert(const Priority& priority, const E& element) {
+    return emplace(priority, element);
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of
+   * copying it.
+   */
+  Handle insert(const Priority& priority, E&& element) {
+    return emplace(priority, std::move(element));
+  }
+
+  /*
+   * Builds a new element in place from "args" with priority "priority",
+   * so the element is never copied or moved on the way in.
    */
-  void insert(int priority, E element) {
-    minHeap.insert(priority, element);
+  template <typename... Args>
+  Handle emplace(const Priority& priority, Args&&... args) {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::INSERT);
+    int slot = minHeap.emplace(priority, std::forward<Args>(args)...);
+    if (slot == -1) {
+      return Handle();
+    }
+    return Handle(slot, minHeap.getGeneration(slot));
   }
 
   /*
    * Similar to insert, but takes a whole vector of new things to
    * add.
+   * Large batches can be built on up to "threads" threads (0 for one per
+   * core). The elements are copied in by slices in parallel, and the heap
+   * is then built a level at a time with each level split between the
+   * threads. Queues with instrumentation always use one thread.
+   */
+  void insert_all(const std::vector<std::pair<Priority,E> >& new_elements, int threads = 1) {
+    minHeap.reserveExtra(new_elements.size());
+    minHeap.insertAllParallel(new_elements, false, threads);
+  }
+
+  /*
+   * Same as above, but moves the elements out of "new_elements".
+   */
+  void insert_all(std::vector<std::pair<Priority,E> >&& new_elements, int threads = 1) {
+    minHeap.reserveExtra(new_elements.size());
+    minHeap.insertAllParallel(new_elements, true, threads);
+  }
+
+  /*
+   * Same as above, but takes any range of (priority, element) pairs.
+   */
+  template <typename InputIt>
+  void insert_all(InputIt first, InputIt last) {
+    minHeap.insertAll(first, last);
+  }
+
+  /*
+   * Moves every element of "other" into this queue, leaving "other" empty,
+   * with an O(n) rebuild spread over up to "threads" threads as for
+   * insert_all(). Handles to this queue keep working, and handles to
+   * "other" stop matching. In a stable queue, elements from "other" go
+   * after this queue's own among equal priorities.
    */
-  void insert_all(std::vector<std::pair<int,E> > new_elements) {
-    minHeap.insertAll(new_elements);
+  void merge(PriorityQueue&& other, int threads = 1) {
+    if (&other != this) {
+      minHeap.reserveExtra(other.minHeap.getSize());
+      minHeap.absorb(other.minHeap, threads);
+    }
   }
 
   /*
@@ -281,32 +2819,189 @@ public:
    * and returns it.
    */
   E remove_front() {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::POP);
     if (!empty()) {
-      E lowestPriorityValue = minHeap.getMin();
-      minHeap.removeFront();
-      return lowestPriorityValue;
+      return minHeap.popFront();
     }
     return E();
   }
 
+  /*
+   * Takes the lowest priority value element off the queue and moves
+   * it out. The queue must not be empty.
+   */
+  E pop() {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::POP);
+    return minHeap.popFront();
+  }
+
+  /*
+   * Takes up to "count" of the lowest priority value elements off the
+   * queue in one go, moving them to "out" in priority order. Returns the
+   * output iterator past the last element written. This is cheaper than
+   * calling remove_front() in a loop, especially for large batches.
+   */
+  template <typename OutputIt>
+  OutputIt pop_n(int count, OutputIt out) {
+    return minHeap.popFront(count, out);
+  }
+
+  /*
+   * Same as above, but also writes the priority of each element taken to
+   * "priorities", in the same order.
+   */
+  template <typename OutputIt, typename PriorityIt>
+  OutputIt pop_n(int count, OutputIt out, PriorityIt priorities) {
+    return minHeap.popFront(count, out, priorities);
+  }
+
+  /*
+   * Empties the queue into the back of "container", in priority order.
+   */
+  template <typename Container>
+  void drain_into(Container& container) {
+    minHeap.popFront(size(), std::back_inserter(container));
+  }
+
+  /*
+   * Removes the element referred to by "handle" with a single sift, or in
+   * lazy mode by marking it as a tombstone in O(1).
+   * Returns false if it was no longer in the queue.
+   */
+  bool erase(Handle handle) {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::ERASE);
+    int index = minHeap.findHandle(handle.slot, handle.generation);
+    if (index == -1) {
+      return false;
+    }
+    minHeap.eraseAt(index);
+    return true;
+  }
+
+  /*
+   * Removes the first (in priority order) element that matches "element".
+   * Returns false if no element matched.
+   */
+  bool erase(const E& element) {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::ERASE);
+    return minHeap.eraseFirst(element);
+  }
+
+  /*
+   * Removes every element referred to by the handles in a range, and
+   * returns how many were still in the queue. A large batch rebuilds the
+   * heap once instead of sifting for each element.
+   */
+  template <typename InputIt>
+  int erase_all(InputIt first, InputIt last) {
+    std::vector<bool> doomed(minHeap.getSize(), false);
+    for (; first != last; ++first) {
+      int index = minHeap.findHandle(first->slot, first->generation);
+      if (index != -1) {
+        doomed[index] = true;
+      }
+    }
+    return minHeap.eraseMarked(doomed);
+  }
+
+  /*
+   * Removes every element for which "predicate" returns true, and returns
+   * how many were removed. Like erase_all(), a large batch rebuilds the heap
+   * once.
+   */
+  template <typename Predicate>
+  int erase_if(Predicate predicate) {
+    std::vector<bool> doomed(minHeap.getSize(), false);
+    for (int i = 0; i < minHeap.getSize(); i++) {
+      doomed[i] = minHeap.isLive(i) && predicate(minHeap.getValue(i));
+    }
+    return minHeap.eraseMarked(doomed);
+  }
+
   /*
    * Returns the lowest priority value element in the queue, but leaves
    * it in the queue.
    */
-  E peek() {
+  const E& peek() const {
     return minHeap.getMin();
   }
 
   /*
-   * Returns a vector containing all the elements in the queue.
+   * Returns the priority of the element peek() would return.
+   * The queue must not be empty.
    */
-  std::vector<E> get_all_elements() {
-    std::vector<E> elements;
+  Priority peek_priority() const {
+    return minHeap.getPriority(0);
+  }
 
-    for (int i = 0; i < minHeap.getSize(); i++) {
-      elements.push_back(minHeap.getValue(i));
+  /*
+   * Returns a view of all the elements in the queue, in heap order, without
+   * copying them.
+   */
+  ElementsView elements_view() const {
+    return ElementsView(&minHeap);
+  }
+
+  /*
+   * Returns a view of all the priorities, in the same order as
+   * elements_view().
+   */
+  PrioritiesView priorities_view() const {
+    return PrioritiesView(&minHeap);
+  }
+
+  /*
+   * Returns a view of (priority, element) pairs, in the same order as
+   * elements_view(). The elements are references into the queue.
+   */
+  EntriesView entries() const {
+    return EntriesView(&minHeap);
+  }
+
+  /*
+   * Returns an iterator to the lowest priority value element, which walks
+   * the queue in priority order as it is incremented.
+   */
+  SortedIterator sorted_begin() const {
+    return SortedIterator(&minHeap);
+  }
+
+  /*
+   * Returns the iterator past the last element in priority order.
+   */
+  SortedIterator sorted_end() const {
+    return SortedIterator();
+  }
+
+  /*
+   * Copies the "k" lowest priority value elements (or all of them, if there
+   * are fewer) to "out" in priority order, leaving the queue as it was.
+   * This is O(k log k), however big the queue is. Returns the output
+   * iterator past the last element written.
+   */
+  template <typename OutputIt>
+  OutputIt top_k(int k, OutputIt out) const {
+    if (k <= 0) {
+      return out;
+    }
+    Frontier frontier(&minHeap);
+    frontier.reserve(k < minHeap.getSize() ? k : minHeap.getSize());
+    for (int i = 0; i < k && !frontier.done(); i++) {
+      *out++ = minHeap.getValue(frontier.next());
+      frontier.advance();
     }
+    return out;
+  }
+
+  /*
+   * Returns a vector containing all the elements in the queue.
+   */
+  std::vector<E> get_all_elements() const {
+    std::vector<E> elements;
+    elements.reserve(minHeap.getLiveSize());
 
+    ElementsView view = elements_view();
+    elements.assign(view.begin(), view.end());
     return elements;
   }
 
@@ -314,35 +3009,59 @@ public:
    * Returns true if the queue contains element "element", false
    * otherwise.
    */
-  bool contains(E element){
-    bool found = false;
+  bool contains(const E& element) const {
     for (int i = 0; i < minHeap.getSize(); i++) {
-      if (minHeap.getValue(i) == element) {
+      if (minHeap.isLive(i) && minHeap.getValue(i) == element) {
+        minHeap.instruments().countScan(i + 1);
         return true;
       }
     }
+    minHeap.instruments().countScan(minHeap.getSize());
     return false;
   }
 
+  /*
+   * Returns true if the element referred to by "handle" is still
+   * in the queue, false otherwise. This is O(1).
+   */
+  bool contains(Handle handle) const {
+    return minHeap.findHandle(handle.slot, handle.generation) != -1;
+  }
+
   /*
    * Returns the priority of the element that matches
    * "element". If there is more than one, return it returns
    * the lowest priority value.
-   * If no element matches, return -1.
+   * If no element matches, return -1 (or whatever
+   * PriorityTraits<Priority, Compare>::none() gives for other priority types
+   * and orders).
    */
-  int get_priority(E element){
+  Priority get_priority(const E& element) const {
     int lowest = -1;
+    minHeap.instruments().countScan(minHeap.getSize());
     for (int i = 0; i < minHeap.getSize(); i++) {
-      if (minHeap.getValue(i) == element) {
-        if (lowest == -1) {
-          lowest = minHeap.getPriority(i);
-        }
-        else if (minHeap.getPriority(i) < lowest) {
-
+      if (minHeap.isLive(i) && minHeap.getValue(i) == element) {
+        if (lowest == -1 || minHeap.before(minHeap.getPriority(i), minHeap.getPriority(lowest))) {
+          lowest = i;
         }
       }
     }
-    return lowest;
+    if (lowest == -1) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return minHeap.getPriority(lowest);
+  }
+
+  /*
+   * Returns the priority of the element referred to by "handle",
+   * or -1 as above if it is no longer in the queue. This is O(1).
+   */
+  Priority get_priority(Handle handle) const {
+    int index = minHeap.findHandle(handle.slot, handle.generation);
+    if (index == -1) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return minHeap.getPriority(index);
   }
 
   /*
@@ -352,13 +3071,12 @@ public:
    * That is, the priority of the element
    * get_all_elements()[i] should be get_all_prriorities()[i].
    */
-  std::vector<int> get_all_priorities(){
-    std::vector<int> priorities;
-
-    for (int i = 0; i < minHeap.getSize(); i++) {
-      priorities.push_back(minHeap.getPriority(i));
-    }
+  std::vector<Priority> get_all_priorities() const {
+    std::vector<Priority> priorities;
+    priorities.reserve(minHeap.getLiveSize());
 
+    PrioritiesView view = priorities_view();
+    priorities.assign(view.begin(), view.end());
     return priorities;
   }
 
@@ -366,24 +3084,226 @@ public:
    * Finds the first (in priority order) element that matches
    * "element", and changes its priority to "new_priority".
    */
-  void change_priority(E element, int new_priority) {
+  void change_priority(const E& element, const Priority& new_priority) {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::CHANGE_PRIORITY);
     minHeap.changePriority(element, new_priority);
   }
 
   /*
-   * Returns the number of elements in the queue.
+   * Changes the priority of the element referred to by "handle" to
+   * "new_priority" with a single O(log n) sift. Does nothing if the
+   * element is no longer in the queue.
    */
-  int size() {
-    return minHeap.getSize();
+  void change_priority(Handle handle, const Priority& new_priority) {
+    Timer timer(minHeap.instruments(), PriorityQueueStats::CHANGE_PRIORITY);
+    int index = minHeap.findHandle(handle.slot, handle.generation);
+    if (index != -1) {
+      minHeap.changePriorityAt(index, new_priority);
+    }
+  }
+
+  /*
+   * Returns the number of elements in the queue, not counting tombstones.
+   */
+  int size() const {
+    return minHeap.getLiveSize();
   }
 
   /*
    * Returns true if the queue has no elements, false otherwise.
    */
-  bool empty() {
-    return minHeap.getSize() == 0;
+  bool empty() const {
+    return minHeap.getLiveSize() == 0;
+  }
+
+  /*
+   * Returns the most elements a bounded queue may hold, or 0 if the queue
+   * is unbounded.
+   */
+  int bound() const {
+    return minHeap.getBound();
+  }
+
+  /*
+   * Returns true if the queue is bounded and holds as many elements as it
+   * may.
+   */
+  bool full() const {
+    return bound() > 0 && size() >= bound();
+  }
+
+  /*
+   * Returns what an insert into a full bounded queue does.
+   */
+  OverflowPolicy overflow_policy() const {
+    return minHeap.getOverflowPolicy();
+  }
+
+  /*
+   * Returns the priority of the worst element in a bounded EVICT_WORST
+   * queue, which is what a new element has to beat once the queue is full.
+   * This is O(1). The queue must not be empty.
+   */
+  Priority worst_priority() const {
+    return minHeap.getWorstPriority();
+  }
+
+  /*
+   * Returns the number of nodes the heap really holds, tombstones
+   * included. This is what the queue costs in memory and sift depth.
+   */
+  int physical_size() const {
+    return minHeap.getSize();
+  }
+
+  /*
+   * Returns the number of tombstones waiting to be compacted away.
+   */
+  int tombstone_count() const {
+    return minHeap.getDeadCount();
+  }
+
+  /*
+   * Turns lazy erase mode on or off. In lazy mode erase() only marks an
+   * element as a tombstone, which is O(1). Tombstones are skipped by
+   * peek() and remove_front() and dropped when they reach the front, and
+   * once they pass the compaction ratio the heap is compacted and rebuilt
+   * with a single Floyd build. Turning lazy mode off compacts straight away.
+   */
+  void set_lazy_erase(bool lazy) {
+    minHeap.setLazy(lazy);
+  }
+
+  /*
+   * Returns true if the queue is in lazy erase mode.
+   */
+  bool lazy_erase() const {
+    return minHeap.isLazy();
+  }
+
+  /*
+   * Sets the share of the heap tombstones may take up before it is
+   * compacted. The default is 0.5, so the heap is never more than twice
+   * its live size; 0 compacts on every erase.
+   */
+  void set_compaction_ratio(double ratio) {
+    minHeap.setCompactionRatio(ratio);
+  }
+
+  /*
+   * Returns the share of the heap tombstones may take up before it is
+   * compacted.
+   */
+  double compaction_ratio() const {
+    return minHeap.getCompactionRatio();
+  }
+
+  /*
+   * Removes every tombstone now, rebuilding the heap once.
+   */
+  void compact() {
+    minHeap.compact();
+  }
+
+  /*
+   * Makes room for at least "capacity" elements up front, so the queue can
+   * grow to that size without any reallocation.
+   */
+  void reserve(std::size_t capacity) {
+    minHeap.reserve(capacity);
+  }
+
+  /*
+   * Returns how many elements the queue can hold without reallocating.
+   */
+  std::size_t capacity() const {
+    return minHeap.getCapacity();
+  }
+
+  /*
+   * Releases memory the queue is not using at its current size.
+   */
+  void shrink_to_fit() {
+    minHeap.shrinkToFit();
+  }
+
+  /*
+   * Writes the queue to "out" in a versioned binary snapshot format: packed
+   * priority keys followed by the serialized elements, in heap order, so
+   * loading it back needs no rebuild. Elements are written with
+   * PayloadSerializer<E>, and priorities must be trivially copyable.
+   */
+  void save(std::ostream& out) const {
+    static_assert(std::is_trivially_copyable<Priority>::value, "save() needs trivially copyable priorities");
+    minHeap.save(out);
+  }
+
+  /*
+   * Replaces the contents of the queue with a snapshot from save(), taken
+   * with the same template parameters. This is O(n) and never compares a
+   * priority. Handles from before the load stop matching, and the loaded
+   * elements get new ones (so only the value-based lookups can find them).
+   * Returns false, leaving the queue as it was, if the snapshot is damaged
+   * or does not match this queue's type.
+   */
+  bool load(std::istream& in) {
+    static_assert(std::is_trivially_copyable<Priority>::value, "load() needs trivially copyable priorities");
+    return minHeap.load(in);
+  }
+
+#if defined(PRIORITY_QUEUE_HAVE_MMAP)
+  /*
+   * Same as above, but maps the snapshot file at "path" into memory and
+   * copies the key and element arrays straight out of it, two memcpy()s in
+   * all. The elements must be trivially copyable. Returns false if the file
+   * cannot be mapped either.
+   */
+  bool load_mapped(const char* path) {
+    static_assert(std::is_trivially_copyable<Priority>::value, "load_mapped() needs trivially copyable priorities");
+
+    int file = ::open(path, O_RDONLY);
+    if (file == -1) {
+      return false;
+    }
+    struct stat info;
+    if (::fstat(file, &info) != 0 || info.st_size == 0) {
+      ::close(file);
+      return false;
+    }
+
+    void* data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+    bool loaded = minHeap.load(static_cast<const char*>(data), info.st_size);
+    ::munmap(data, info.st_size);
+    return loaded;
+  }
+#endif
+
+  /*
+   * Returns a snapshot of the counters and latency histograms kept by the
+   * Instrumentation policy. Without instrumentation this is all zeroes.
+   */
+  PriorityQueueStats stats() const {
+    return minHeap.instruments().snapshot();
+  }
+
+  /*
+   * Returns a copy of the allocator elements are stored with.
+   */
+  Allocator get_allocator() const {
+    return minHeap.getAllocator();
   }
 
 };
 
+/*
+ * Shorthand for a PriorityQueue that keeps equal int priorities in
+ * first in, first out order.
+ */
+template <typename E, int Arity = 2>
+using StablePriorityQueue = PriorityQueue<E, Arity, int, std::less<int>, true>;
+
 #endif
\ No newline at end of file
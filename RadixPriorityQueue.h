@@ -0,0 +1,592 @@
+#ifndef _RADIX_PR_QUEUE_H
+#define _RADIX_PR_QUEUE_H
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a monotone priority queue for integer priorities,
+ * as a radix heap.
+ * It only works when priorities never go below the last one taken off the
+ * queue, as in Dijkstra's algorithm or a timer queue, and rejects any insert
+ * or change_priority() that would. In return each operation is amortised
+ * O(log C) for priorities up to C, with no comparisons between elements at
+ * all, which is much faster than a heap on these workloads.
+ * Elements are kept in buckets by the highest bit at which their priority
+ * differs from the last one taken. Bucket 0 holds the elements tied with it,
+ * and the others cover ranges that double in size. A removal that finds
+ * bucket 0 empty splits the first non-empty bucket into the buckets below it,
+ * and each element can only move down as many times as there are buckets.
+ * The public interface is the same as PriorityQueue's, including handles.
+ * Equal priorities come out in no particular order.
+ */
+template <typename E, typename Priority = int>
+class RadixPriorityQueue {
+
+  static_assert(std::is_integral<Priority>::value, "RadixPriorityQueue needs an integer priority type");
+
+private:
+
+  // One bucket for the last priority taken, plus one per bit
+  static const int BUCKETS = 65;
+
+  /*
+   * Class for a bucket entry: an element's priority and the slot holding it.
+   */
+  class Entry {
+  public:
+    std::uint64_t key;
+    int slot;
+
+    Entry(std::uint64_t newKey, int newSlot) : key(newKey), slot(newSlot) {
+    }
+  };
+
+  /*
+   * Class for the bookkeeping of one slot: where its entry is, and how many
+   * elements have used the slot, so stale handles can be told apart.
+   */
+  class Place {
+  public:
+    int bucket;
+    int position;
+    int generation;
+
+    Place() : bucket(-1), position(-1), generation(0) {
+    }
+  };
+
+  /*
+   * Private helper method that returns which bucket priority "key" goes in,
+   * relative to the last priority taken.
+   */
+  int bucketOf(std::uint64_t key) const {
+    std::uint64_t difference = key ^ last;
+    if (difference == 0) {
+      return 0;
+    }
+#if defined(__GNUC__)
+    return 64 - __builtin_clzll(difference);
+#else
+    int bucket = 0;
+    while (difference != 0) {
+      bucket++;
+      difference >>= 1;
+    }
+    return bucket;
+#endif
+  }
+
+  /*
+   * Private helper method that files the element in slot "slot" under
+   * priority "key".
+   */
+  void place(std::uint64_t key, int slot) {
+    int bucket = bucketOf(key);
+    buckets[bucket].push_back(Entry(key, slot));
+    places[slot].bucket = bucket;
+    places[slot].position = buckets[bucket].size() - 1;
+  }
+
+  /*
+   * Private helper method that takes the entry for slot "slot" out of its
+   * bucket, filling the gap with the bucket's last entry.
+   */
+  void unplace(int slot) {
+    std::vector<Entry>& bucket = buckets[places[slot].bucket];
+    int position = places[slot].position;
+    bucket[position] = bucket.back();
+    places[bucket[position].slot].position = position;
+    bucket.pop_back();
+    places[slot].bucket = -1;
+  }
+
+  /*
+   * Private helper method that returns a free slot for a new element.
+   */
+  int acquireSlot() {
+    if (!freeSlots.empty()) {
+      int slot = freeSlots.back();
+      freeSlots.pop_back();
+      return slot;
+    }
+    places.push_back(Place());
+    return places.size() - 1;
+  }
+
+  /*
+   * Private helper method that returns slot "slot" to the free list, so
+   * handles to its old element stop matching.
+   */
+  void releaseSlot(int slot) {
+    places[slot].generation++;
+    freeSlots.push_back(slot);
+  }
+
+  /*
+   * Private helper method that returns the index of the first non-empty
+   * bucket, or BUCKETS if every bucket is empty.
+   */
+  int firstBucket() const {
+    int bucket = 0;
+    while (bucket < BUCKETS && buckets[bucket].empty()) {
+      bucket++;
+    }
+    return bucket;
+  }
+
+  /*
+   * Private helper method that returns the slot of the front element. When
+   * bucket 0 is empty this is the smallest entry of the first bucket, which
+   * is looked up once and remembered until the queue changes.
+   */
+  int frontSlot() const {
+    if (!buckets[0].empty()) {
+      return buckets[0].back().slot;
+    }
+    if (front == -1) {
+      const std::vector<Entry>& bucket = buckets[firstBucket()];
+      int smallest = 0;
+      for (int i = 1; i < (int)bucket.size(); i++) {
+        if (bucket[i].key < bucket[smallest].key) {
+          smallest = i;
+        }
+      }
+      front = bucket[smallest].slot;
+    }
+    return front;
+  }
+
+  /*
+   * Private helper method that makes bucket 0 hold the front element, by
+   * moving the last priority taken up to the smallest priority left and
+   * splitting the first non-empty bucket around it. The queue must not be
+   * empty.
+   */
+  void settle() {
+    if (!buckets[0].empty()) {
+      return;
+    }
+
+    int bucket = firstBucket();
+    last = buckets[bucket][places[frontSlot()].position].key;
+    front = -1;
+
+    // Every entry of the split bucket lands in a lower one
+    scratch.swap(buckets[bucket]);
+    for (std::size_t i = 0; i < scratch.size(); i++) {
+      place(scratch[i].key, scratch[i].slot);
+    }
+    scratch.clear();
+  }
+
+  /*
+   * Private helper method that returns true if "priority" may be added now.
+   */
+  bool accepts(const Priority& priority) const {
+    return PriorityTraits<Priority>::isLegal(priority) && std::uint64_t(priority) >= last;
+  }
+
+  /*
+   * Private helper method that moves the element in slot "slot" to priority
+   * "key". The new priority must be accepted.
+   */
+  void changeSlotPriority(int slot, std::uint64_t key) {
+    unplace(slot);
+    place(key, slot);
+    front = -1;
+  }
+
+  /*
+   * Private helper method that returns the slot of the element equal to
+   * "element" with the lowest priority, or -1 if there is none.
+   */
+  int findFirst(const E& element) const {
+    int lowest = -1;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+      for (std::size_t i = 0; i < buckets[bucket].size(); i++) {
+        const Entry& entry = buckets[bucket][i];
+        if (values[entry.slot] == element &&
+            (lowest == -1 || entry.key < buckets[places[lowest].bucket][places[lowest].position].key)) {
+          lowest = entry.slot;
+        }
+      }
+    }
+    return lowest;
+  }
+
+  /*
+   * Private helper method that returns the priority of the element in
+   * slot "slot".
+   */
+  Priority priorityOf(int slot) const {
+    return Priority(buckets[places[slot].bucket][places[slot].position].key);
+  }
+
+  // Entries grouped by how far their priority is from "last"
+  std::vector<Entry> buckets[BUCKETS];
+
+  // Elements by slot, and the bookkeeping for each slot
+  std::vector<E> values;
+  std::vector<Place> places;
+  std::vector<int> freeSlots;
+
+  // Spare bucket reused when splitting one
+  std::vector<Entry> scratch;
+
+  // The last priority taken off the queue, which no new priority may be below
+  std::uint64_t last;
+
+  // Slot of the front element when it is not in bucket 0, or -1 if unknown
+  mutable int front;
+
+  // Number of elements in the queue
+  int count;
+
+public:
+
+  /*
+   * Opaque reference to a single element in the queue, returned by insert().
+   * A handle lets the element be found in O(1) without comparing values, and
+   * stops matching anything once its element has left the queue.
+   */
+  class Handle {
+  private:
+    // Private fields
+    int slot;
+    int generation;
+
+    friend class RadixPriorityQueue;
+
+    /*
+     * Handle constructor used by the queue itself.
+     */
+    Handle(int newSlot, int newGeneration) {
+      slot = newSlot;
+      generation = newGeneration;
+    }
+
+  public:
+
+    /*
+     * Default constructor for a handle that refers to nothing.
+     */
+    Handle() {
+      slot = -1;
+      generation = 0;
+    }
+
+    bool operator==(const Handle& other) const {
+      return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+      return !(*this == other);
+    }
+  };
+
+private:
+
+  /*
+   * Private helper method that returns the slot "handle" refers to, or -1
+   * if its element is no longer in the queue.
+   */
+  int findHandle(Handle handle) const {
+    if (handle.slot < 0 || handle.slot >= (int)places.size() ||
+        places[handle.slot].generation != handle.generation || places[handle.slot].bucket == -1) {
+      return -1;
+    }
+    return handle.slot;
+  }
+
+public:
+
+  /*
+   * A constructor, if you need it.
+   */
+  RadixPriorityQueue() : last(0), front(-1), count(0) {
+  }
+
+  /*
+   * This function adds a new element "element" to the queue
+   * with priority "priority".
+   * Returns a handle to the new element, which refers to nothing if the
+   * priority was negative or below the last priority taken off the queue.
+   */
+  Handle insert(const Priority& priority, const E& element) {
+    return emplace(priority, element);
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of
+   * copying it.
+   */
+  Handle insert(const Priority& priority, E&& element) {
+    return emplace(priority, std::move(element));
+  }
+
+  /*
+   * Builds a new element from "args" with priority "priority".
+   */
+  template <typename... Args>
+  Handle emplace(const Priority& priority, Args&&... args) {
+    if (!accepts(priority)) {
+      return Handle();
+    }
+
+    int slot = acquireSlot();
+    if (slot == (int)values.size()) {
+      values.emplace_back(std::forward<Args>(args)...);
+    }
+    else {
+      values[slot] = E(std::forward<Args>(args)...);
+    }
+
+    // A new smallest element outside bucket 0 becomes the remembered front.
+    // One in bucket 0 is the front anyway, and is never remembered
+    std::uint64_t key = priority;
+    if (front != -1 && bucketOf(key) != 0 && key < buckets[places[front].bucket][places[front].position].key) {
+      front = slot;
+    }
+    place(key, slot);
+    count++;
+    return Handle(slot, places[slot].generation);
+  }
+
+  /*
+   * Similar to insert, but takes a whole vector of new things to
+   * add.
+   */
+  void insert_all(const std::vector<std::pair<Priority,E> >& new_elements) {
+    insert_all(new_elements.begin(), new_elements.end());
+  }
+
+  /*
+   * Same as above, but moves the elements out of "new_elements".
+   */
+  void insert_all(std::vector<std::pair<Priority,E> >&& new_elements) {
+    insert_all(std::make_move_iterator(new_elements.begin()),
+               std::make_move_iterator(new_elements.end()));
+  }
+
+  /*
+   * Same as above, but takes any range of (priority, element) pairs.
+   */
+  template <typename InputIt>
+  void insert_all(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      typename std::iterator_traits<InputIt>::value_type entry = *first;
+      emplace(entry.first, std::move(entry.second));
+    }
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue,
+   * and returns it.
+   */
+  E remove_front() {
+    if (!empty()) {
+      return pop();
+    }
+    return E();
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves
+   * it out. The queue must not be empty.
+   */
+  E pop() {
+    settle();
+    int slot = buckets[0].back().slot;
+    buckets[0].pop_back();
+    places[slot].bucket = -1;
+    if (front == slot) {
+      front = -1;
+    }
+    releaseSlot(slot);
+    count--;
+    return std::move(values[slot]);
+  }
+
+  /*
+   * Takes up to "count" of the lowest priority value elements off the
+   * queue in one go, moving them to "out" in priority order. Returns the
+   * output iterator past the last element written.
+   */
+  template <typename OutputIt>
+  OutputIt pop_n(int count, OutputIt out) {
+    for (int i = 0; i < count && !empty(); i++) {
+      *out++ = pop();
+    }
+    return out;
+  }
+
+  /*
+   * Empties the queue into the back of "container", in priority order.
+   */
+  template <typename Container>
+  void drain_into(Container& container) {
+    pop_n(size(), std::back_inserter(container));
+  }
+
+  /*
+   * Returns the lowest priority value element in the queue, but leaves
+   * it in the queue.
+   */
+  const E& peek() const {
+    return values[frontSlot()];
+  }
+
+  /*
+   * Returns the priority of the element peek() would return.
+   * The queue must not be empty.
+   */
+  Priority peek_priority() const {
+    return priorityOf(frontSlot());
+  }
+
+  /*
+   * Returns the lowest priority insert() will currently accept, which is
+   * the priority of the last element taken off the queue.
+   */
+  Priority lowest_allowed_priority() const {
+    return Priority(last);
+  }
+
+  /*
+   * Returns a vector containing all the elements in the queue.
+   */
+  std::vector<E> get_all_elements() const {
+    std::vector<E> elements;
+    elements.reserve(count);
+
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+      for (std::size_t i = 0; i < buckets[bucket].size(); i++) {
+        elements.push_back(values[buckets[bucket][i].slot]);
+      }
+    }
+
+    return elements;
+  }
+
+  /*
+   * Returns true if the queue contains element "element", false
+   * otherwise.
+   */
+  bool contains(const E& element) const {
+    return findFirst(element) != -1;
+  }
+
+  /*
+   * Returns true if the element referred to by "handle" is still
+   * in the queue, false otherwise. This is O(1).
+   */
+  bool contains(Handle handle) const {
+    return findHandle(handle) != -1;
+  }
+
+  /*
+   * Returns the priority of the element that matches "element", the
+   * lowest one if there is more than one, or -1 if no element matches.
+   */
+  Priority get_priority(const E& element) const {
+    int slot = findFirst(element);
+    if (slot == -1) {
+      return PriorityTraits<Priority>::none();
+    }
+    return priorityOf(slot);
+  }
+
+  /*
+   * Returns the priority of the element referred to by "handle",
+   * or -1 if it is no longer in the queue. This is O(1).
+   */
+  Priority get_priority(Handle handle) const {
+    int slot = findHandle(handle);
+    if (slot == -1) {
+      return PriorityTraits<Priority>::none();
+    }
+    return priorityOf(slot);
+  }
+
+  /*
+   * Returns a vector containing all the priorities.
+   * The priority of the element get_all_elements()[i] is
+   * get_all_priorities()[i].
+   */
+  std::vector<Priority> get_all_priorities() const {
+    std::vector<Priority> priorities;
+    priorities.reserve(count);
+
+    for (int bucket = 0; bucket < BUCKETS; bucket++) {
+      for (std::size_t i = 0; i < buckets[bucket].size(); i++) {
+        priorities.push_back(Priority(buckets[bucket][i].key));
+      }
+    }
+
+    return priorities;
+  }
+
+  /*
+   * Finds the first (in priority order) element that matches
+   * "element", and changes its priority to "new_priority". Does nothing if
+   * the new priority is below the last priority taken off the queue.
+   */
+  void change_priority(const E& element, const Priority& new_priority) {
+    int slot = findFirst(element);
+    if (slot != -1 && accepts(new_priority)) {
+      changeSlotPriority(slot, new_priority);
+    }
+  }
+
+  /*
+   * Changes the priority of the element referred to by "handle" to
+   * "new_priority" in O(1). Does nothing if the element is no longer in the
+   * queue, or if the new priority is below the last priority taken off it.
+   */
+  void change_priority(Handle handle, const Priority& new_priority) {
+    int slot = findHandle(handle);
+    if (slot != -1 && accepts(new_priority)) {
+      changeSlotPriority(slot, new_priority);
+    }
+  }
+
+  /*
+   * Returns the number of elements in the queue.
+   */
+  int size() const {
+    return count;
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  bool empty() const {
+    return count == 0;
+  }
+
+  /*
+   * Makes room for at least "capacity" elements up front.
+   */
+  void reserve(std::size_t capacity) {
+    values.reserve(capacity);
+    places.reserve(capacity);
+  }
+
+  /*
+   * Returns how many elements the queue can hold without reallocating
+   * its element storage.
+   */
+  std::size_t capacity() const {
+    return values.capacity();
+  }
+
+};
+
+#endif
@@ -0,0 +1,189 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "RadixPriorityQueue.h"
+
+class RadixPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testRemovesInPriorityOrder(){
+
+    RadixPriorityQueue<int> pq;
+
+    for (int i = 0; i < 1000; i++){
+
+      pq.insert((i * 7919) % 1000, (i * 7919) % 1000);
+
+    }
+
+    TS_ASSERT_EQUALS(pq.size(), 1000);
+    TS_ASSERT_EQUALS(pq.peek(), 0);
+    TS_ASSERT_EQUALS(pq.peek_priority(), 0);
+
+    for (int i = 0; i < 1000; i++){
+
+      TS_ASSERT_EQUALS(pq.peek(), i);
+      TS_ASSERT_EQUALS(pq.remove_front(), i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testRejectsNonMonotoneInserts(){
+
+    RadixPriorityQueue<std::string> pq;
+
+    TS_ASSERT(pq.insert(-1, "negative") == RadixPriorityQueue<std::string>::Handle());
+    pq.insert(5, "five");
+    pq.insert(9, "nine");
+    TS_ASSERT_EQUALS(pq.lowest_allowed_priority(), 0);
+
+    TS_ASSERT_EQUALS(pq.pop(), "five");
+    TS_ASSERT_EQUALS(pq.lowest_allowed_priority(), 5);
+
+    // Below the last priority taken, so it would break the order
+    TS_ASSERT(pq.insert(4, "four") == RadixPriorityQueue<std::string>::Handle());
+    TS_ASSERT(pq.insert(5, "five again") != RadixPriorityQueue<std::string>::Handle());
+    TS_ASSERT_EQUALS(pq.size(), 2);
+
+    pq.change_priority("nine", 3);
+    TS_ASSERT_EQUALS(pq.get_priority("nine"), 9);
+
+    TS_ASSERT_EQUALS(pq.pop(), "five again");
+    TS_ASSERT_EQUALS(pq.pop(), "nine");
+
+  }
+
+  void testMonotoneWorkload(){
+
+    // Each new priority is the one just taken plus a random step, like
+    // Dijkstra's algorithm
+    RadixPriorityQueue<int> pq;
+    PriorityQueue<int> reference;
+
+    for (int i = 0; i < 100; i++){
+
+      int priority = rand()%100000;
+      pq.insert(priority, priority);
+      reference.insert(priority, priority);
+
+    }
+
+    for (int i = 0; i < 20000; i++){
+
+      int element = pq.remove_front();
+      TS_ASSERT_EQUALS(element, reference.remove_front());
+
+      for (int j = 0; j < 1 + i % 2; j++){
+
+	int priority = element + rand()%5000;
+	pq.insert(priority, priority);
+	reference.insert(priority, priority);
+
+      }
+
+    }
+
+    TS_ASSERT_EQUALS(pq.size(), reference.size());
+
+  }
+
+  void testHandlesAndChangePriority(){
+
+    RadixPriorityQueue<std::string> pq;
+
+    RadixPriorityQueue<std::string>::Handle a = pq.insert(100, "a");
+    RadixPriorityQueue<std::string>::Handle b = pq.insert(200, "b");
+    pq.insert(150, "c");
+
+    TS_ASSERT(pq.contains(a));
+    TS_ASSERT_EQUALS(pq.get_priority(b), 200);
+
+    pq.change_priority(b, 50);
+    TS_ASSERT_EQUALS(pq.peek(), "b");
+    TS_ASSERT_EQUALS(pq.get_priority(b), 50);
+
+    pq.change_priority("a", 300);
+    TS_ASSERT_EQUALS(pq.get_priority(a), 300);
+
+    TS_ASSERT_EQUALS(pq.pop(), "b");
+    TS_ASSERT(!pq.contains(b));
+    TS_ASSERT_EQUALS(pq.get_priority(b), -1);
+
+    TS_ASSERT_EQUALS(pq.pop(), "c");
+    TS_ASSERT_EQUALS(pq.pop(), "a");
+    TS_ASSERT(!pq.contains(a));
+
+    // A reused slot does not bring an old handle back to life
+    RadixPriorityQueue<std::string>::Handle d = pq.insert(400, "d");
+    TS_ASSERT(!pq.contains(a));
+    TS_ASSERT(pq.contains(d));
+
+  }
+
+  void testWholeQueueAccessors(){
+
+    RadixPriorityQueue<int> pq;
+    std::vector<std::pair<int,int> > elements;
+
+    for (int i = 0; i < 50; i++){
+
+      elements.push_back(std::make_pair(i * 3, i));
+
+    }
+
+    pq.insert_all(elements);
+    TS_ASSERT_EQUALS(pq.size(), 50);
+    TS_ASSERT(pq.contains(49));
+    TS_ASSERT(!pq.contains(50));
+
+    std::vector<int> all = pq.get_all_elements();
+    std::vector<int> priorities = pq.get_all_priorities();
+    TS_ASSERT_EQUALS(all.size(), 50);
+
+    for (int i = 0; i < all.size(); i++){
+
+      TS_ASSERT_EQUALS(priorities[i], all[i] * 3);
+
+    }
+
+    std::vector<int> out;
+    pq.pop_n(10, std::back_inserter(out));
+    TS_ASSERT_EQUALS(out.size(), 10);
+    TS_ASSERT_EQUALS(out[9], 9);
+
+    pq.drain_into(out);
+    TS_ASSERT_EQUALS(out.size(), 50);
+    TS_ASSERT(std::is_sorted(out.begin(), out.end()));
+    TS_ASSERT(pq.empty());
+
+  }
+
+  void testFrontStaysCurrent(){
+
+    RadixPriorityQueue<std::string> pq;
+    pq.insert(5, "a");
+    pq.insert(10, "b");
+    TS_ASSERT_EQUALS(pq.pop(), "a");
+    TS_ASSERT_EQUALS(pq.peek(), "b");
+
+    // An element at the last priority taken goes straight into bucket 0,
+    // and must not be remembered as the front once it has been popped
+    pq.insert(5, "c");
+    TS_ASSERT_EQUALS(pq.peek(), "c");
+    TS_ASSERT_EQUALS(pq.pop(), "c");
+    TS_ASSERT_EQUALS(pq.peek_priority(), 10);
+    TS_ASSERT_EQUALS(pq.pop(), "b");
+    TS_ASSERT(pq.empty());
+
+  }
+
+};
@@ -0,0 +1,330 @@
+#ifndef _STATIC_PR_QUEUE_H
+#define _STATIC_PR_QUEUE_H
+
+#include <array>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * Members that change the queue can only be constexpr from C++17, which is
+ * when std::array's mutable accessors became constexpr.
+ */
+#if __cplusplus >= 201703L
+#define PRIORITY_QUEUE_CONSTEXPR constexpr
+#else
+#define PRIORITY_QUEUE_CONSTEXPR
+#endif
+
+/*
+ * This class implements a fixed-capacity priority queue of at most N
+ * elements, for small per-request queues such as the top few results of
+ * one query.
+ * The heap lives inline in two std::arrays, one of priorities and one of
+ * elements, so the queue never allocates and can sit on the stack.
+ * The height of the heap is known at compile time, so the sifts are
+ * written as a chain of templates one level deep each, which the compiler
+ * unrolls completely.
+ * From C++17 every member apart from the vector copies is constexpr, so a
+ * queue can be filled and drained at compile time, for example to build
+ * a scheduling table. Elements then need to be literal types.
+ * Method names match PriorityQueue's, so the two can be swapped, apart
+ * from handles, which a queue this small does without. insert() returns
+ * false instead when the priority is rejected or the queue is full.
+ */
+template <typename E, int N, typename Priority = int, typename Compare = std::less<Priority> >
+class StaticPriorityQueue {
+
+  static_assert(N >= 1, "StaticPriorityQueue needs room for at least one element");
+
+private:
+
+  /*
+   * Private helper method that returns the height of a binary heap of "n"
+   * nodes, which is how many levels a sift can move a node.
+   */
+  static constexpr int heightOf(int n) {
+    return n <= 1 ? 0 : 1 + heightOf(n / 2);
+  }
+
+  // Most levels a sift can move a node
+  static const int HEIGHT = heightOf(N);
+
+  // The level a sift has got to, as a type
+  template <int Level>
+  using LevelsLeft = std::integral_constant<int, Level>;
+
+  /*
+   * Private helper method that swaps the nodes at "a" and "b". std::swap
+   * is not constexpr before C++20, so the moves are written out.
+   */
+  PRIORITY_QUEUE_CONSTEXPR void swapNodes(int a, int b) {
+    Priority priority = std::move(priorities[a]);
+    priorities[a] = std::move(priorities[b]);
+    priorities[b] = std::move(priority);
+
+    E element = std::move(elements[a]);
+    elements[a] = std::move(elements[b]);
+    elements[b] = std::move(element);
+  }
+
+  /*
+   * Private siftUp method that moves the node at "index" up one level at
+   * a time while it is smaller than its parent. Each level is a separate
+   * instantiation, so there is no loop left to run.
+   */
+  template <int Level>
+  PRIORITY_QUEUE_CONSTEXPR void siftUp(int index, LevelsLeft<Level>) {
+    if (index == 0) {
+      return;
+    }
+    int parent = (index - 1) / 2;
+    if (!compare(priorities[index], priorities[parent])) {
+      return;
+    }
+    swapNodes(index, parent);
+    siftUp(parent, LevelsLeft<Level - 1>());
+  }
+
+  PRIORITY_QUEUE_CONSTEXPR void siftUp(int, LevelsLeft<0>) {
+  }
+
+  /*
+   * Private siftDown method that moves the node at "index" down one level
+   * at a time while a child is smaller, unrolled the same way.
+   */
+  template <int Level>
+  PRIORITY_QUEUE_CONSTEXPR void siftDown(int index, LevelsLeft<Level>) {
+    int smallest = 2 * index + 1;
+    if (smallest >= count) {
+      return;
+    }
+    if (smallest + 1 < count && compare(priorities[smallest + 1], priorities[smallest])) {
+      smallest++;
+    }
+    if (!compare(priorities[smallest], priorities[index])) {
+      return;
+    }
+    swapNodes(index, smallest);
+    siftDown(smallest, LevelsLeft<Level - 1>());
+  }
+
+  PRIORITY_QUEUE_CONSTEXPR void siftDown(int, LevelsLeft<0>) {
+  }
+
+  /*
+   * Private helper method that removes the node at "index" by moving the
+   * last node into its place and sifting that one node.
+   */
+  PRIORITY_QUEUE_CONSTEXPR void removeAt(int index) {
+    count--;
+    if (index == count) {
+      return;
+    }
+    Priority old = priorities[index];
+    priorities[index] = std::move(priorities[count]);
+    elements[index] = std::move(elements[count]);
+    if (compare(priorities[index], old)) {
+      siftUp(index, LevelsLeft<HEIGHT>());
+    }
+    else {
+      siftDown(index, LevelsLeft<HEIGHT>());
+    }
+  }
+
+  /*
+   * Private helper method that returns the index of the highest priority
+   * node whose value is "element", or -1 if there is none.
+   */
+  PRIORITY_QUEUE_CONSTEXPR int findFirst(const E& element) const {
+    int first = -1;
+    for (int i = 0; i < count; i++) {
+      if (elements[i] == element && (first == -1 || compare(priorities[i], priorities[first]))) {
+        first = i;
+      }
+    }
+    return first;
+  }
+
+  // Heap-ordered priorities and elements, side by side
+  std::array<Priority, N> priorities;
+  std::array<E, N> elements;
+
+  // Number of nodes in use
+  int count;
+
+  Compare compare;
+
+public:
+
+  /*
+   * Constructor for an empty queue.
+   */
+  constexpr StaticPriorityQueue() : priorities(), elements(), count(0), compare() {
+  }
+
+  /*
+   * This function adds a new element "element" to the queue with priority
+   * "priority". Returns false if the priority was rejected or the queue is
+   * full.
+   */
+  PRIORITY_QUEUE_CONSTEXPR bool insert(const Priority& priority, const E& element) {
+    return insert(priority, E(element));
+  }
+
+  /*
+   * Same as above, but moves "element" into the queue instead of copying it.
+   */
+  PRIORITY_QUEUE_CONSTEXPR bool insert(const Priority& priority, E&& element) {
+    if (!PriorityTraits<Priority, Compare>::isLegal(priority) || count == N) {
+      return false;
+    }
+    priorities[count] = priority;
+    elements[count] = std::move(element);
+    count++;
+    siftUp(count - 1, LevelsLeft<HEIGHT>());
+    return true;
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue, and returns it.
+   */
+  PRIORITY_QUEUE_CONSTEXPR E remove_front() {
+    if (!empty()) {
+      return pop();
+    }
+    return E();
+  }
+
+  /*
+   * Takes the lowest priority value element off the queue and moves it out.
+   * The queue must not be empty.
+   */
+  PRIORITY_QUEUE_CONSTEXPR E pop() {
+    E element = std::move(elements[0]);
+    removeAt(0);
+    return element;
+  }
+
+  /*
+   * Returns the lowest priority value element in the queue, but leaves it
+   * in the queue. The queue must not be empty.
+   */
+  constexpr const E& peek() const {
+    return elements[0];
+  }
+
+  /*
+   * Returns the priority of the element peek() would return.
+   * The queue must not be empty.
+   */
+  constexpr Priority peek_priority() const {
+    return priorities[0];
+  }
+
+  /*
+   * Removes the first (in priority order) element that matches "element".
+   * Returns false if no element matched.
+   */
+  PRIORITY_QUEUE_CONSTEXPR bool erase(const E& element) {
+    int index = findFirst(element);
+    if (index == -1) {
+      return false;
+    }
+    removeAt(index);
+    return true;
+  }
+
+  /*
+   * Returns true if the queue contains element "element", false otherwise.
+   */
+  PRIORITY_QUEUE_CONSTEXPR bool contains(const E& element) const {
+    for (int i = 0; i < count; i++) {
+      if (elements[i] == element) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /*
+   * Returns the priority of the element that matches "element". If there
+   * is more than one, it returns the lowest priority value. If no element
+   * matches, it returns PriorityTraits<Priority, Compare>::none().
+   */
+  PRIORITY_QUEUE_CONSTEXPR Priority get_priority(const E& element) const {
+    int index = findFirst(element);
+    if (index == -1) {
+      return PriorityTraits<Priority, Compare>::none();
+    }
+    return priorities[index];
+  }
+
+  /*
+   * Finds the first (in priority order) element that matches "element",
+   * and changes its priority to "new_priority".
+   */
+  PRIORITY_QUEUE_CONSTEXPR void change_priority(const E& element, const Priority& new_priority) {
+    int index = findFirst(element);
+    if (index == -1 || !PriorityTraits<Priority, Compare>::isLegal(new_priority)) {
+      return;
+    }
+    bool moveUp = compare(new_priority, priorities[index]);
+    priorities[index] = new_priority;
+    if (moveUp) {
+      siftUp(index, LevelsLeft<HEIGHT>());
+    }
+    else {
+      siftDown(index, LevelsLeft<HEIGHT>());
+    }
+  }
+
+  /*
+   * Returns a vector containing all the elements in the queue.
+   */
+  std::vector<E> get_all_elements() const {
+    return std::vector<E>(elements.begin(), elements.begin() + count);
+  }
+
+  /*
+   * Returns a vector containing all the priorities, in the same order as
+   * get_all_elements().
+   */
+  std::vector<Priority> get_all_priorities() const {
+    return std::vector<Priority>(priorities.begin(), priorities.begin() + count);
+  }
+
+  /*
+   * Returns the number of elements in the queue.
+   */
+  constexpr int size() const {
+    return count;
+  }
+
+  /*
+   * Returns true if the queue has no elements, false otherwise.
+   */
+  constexpr bool empty() const {
+    return count == 0;
+  }
+
+  /*
+   * Returns true if the queue cannot take any more elements.
+   */
+  constexpr bool full() const {
+    return count == N;
+  }
+
+  /*
+   * Returns how many elements the queue can hold, which is always N.
+   */
+  constexpr int capacity() const {
+    return N;
+  }
+
+};
+
+#endif
@@ -0,0 +1,169 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <functional>
+
+#include "StaticPriorityQueue.h"
+
+class StaticPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testInsertAndRemoveInOrder(){
+
+    StaticPriorityQueue<int, 64> pq;
+    TS_ASSERT_EQUALS(pq.capacity(), 64);
+    TS_ASSERT(pq.empty());
+
+    for (int i = 0; i < 64; i++){
+
+      TS_ASSERT(pq.insert((i * 37) % 64, (i * 37) % 64));
+
+    }
+
+    TS_ASSERT(pq.full());
+    TS_ASSERT(!pq.insert(0, 100));
+    TS_ASSERT_EQUALS(pq.size(), 64);
+
+    for (int i = 0; i < 64; i++){
+
+      TS_ASSERT_EQUALS(pq.peek(), i);
+      TS_ASSERT_EQUALS(pq.peek_priority(), i);
+      TS_ASSERT_EQUALS(pq.remove_front(), i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.remove_front(), 0);
+
+  }
+
+  void testIllegalPriority(){
+
+    StaticPriorityQueue<int, 4> pq;
+    TS_ASSERT(!pq.insert(-1, 5));
+    TS_ASSERT(pq.empty());
+    TS_ASSERT_EQUALS(pq.get_priority(5), -1);
+
+    pq.insert(3, 5);
+    pq.change_priority(5, -2);
+    TS_ASSERT_EQUALS(pq.get_priority(5), 3);
+
+  }
+
+  void testChangePriorityAndErase(){
+
+    StaticPriorityQueue<std::string, 16> pq;
+    for (int i = 0; i < 16; i++){
+
+      std::stringstream ss;
+      ss << "element " << i;
+      pq.insert(i, ss.str());
+
+    }
+
+    TS_ASSERT(pq.contains("element 7"));
+    TS_ASSERT(!pq.contains("element 16"));
+    TS_ASSERT_EQUALS(pq.get_priority("element 7"), 7);
+
+    pq.change_priority("element 15", 0);
+    pq.change_priority("element 0", 20);
+    TS_ASSERT_EQUALS(pq.peek(), "element 15");
+
+    TS_ASSERT(pq.erase("element 15"));
+    TS_ASSERT(!pq.erase("element 15"));
+    TS_ASSERT_EQUALS(pq.size(), 15);
+    TS_ASSERT_EQUALS(pq.get_all_elements().size(), 15);
+    TS_ASSERT_EQUALS(pq.get_all_priorities().size(), 15);
+
+    int last = -1;
+    while (!pq.empty()){
+
+      int priority = pq.peek_priority();
+      TS_ASSERT(last <= priority);
+      last = priority;
+      pq.pop();
+
+    }
+    TS_ASSERT_EQUALS(last, 20);
+
+  }
+
+  void testMatchesPriorityQueue(){
+
+    StaticPriorityQueue<int, 33, int, std::greater<int> > fixed;
+    PriorityQueue<int, 2, int, std::greater<int> > reference;
+
+    for (int i = 0; i < 10000; i++){
+
+      int action = rand() % 4;
+      if (action < 2 && !fixed.full()){
+
+	int priority = rand() % 100;
+	fixed.insert(priority, i);
+	reference.insert(priority, i);
+
+      }
+      else if (action == 2 && !reference.empty()){
+
+	TS_ASSERT_EQUALS(fixed.peek_priority(), reference.peek_priority());
+	fixed.pop();
+	reference.pop();
+
+      }
+      else if (!reference.empty()){
+
+	int element = reference.get_all_elements()[rand() % reference.size()];
+	int priority = rand() % 100;
+	fixed.change_priority(element, priority);
+	reference.change_priority(element, priority);
+
+      }
+      TS_ASSERT_EQUALS(fixed.size(), reference.size());
+
+    }
+
+    while (!reference.empty()){
+
+      TS_ASSERT_EQUALS(fixed.peek_priority(), reference.peek_priority());
+      fixed.pop();
+      reference.pop();
+
+    }
+
+  }
+
+  void testConstexpr(){
+
+#if __cplusplus >= 201703L
+    // A queue filled and drained by the compiler
+    constexpr int drained = [](){
+      StaticPriorityQueue<int, 8> pq;
+      int order[] = {5, 3, 7, 1, 6, 0, 2, 4};
+      for (int i = 0; i < 8; i++){
+	pq.insert(order[i], order[i] * 10);
+      }
+      pq.change_priority(70, 0);
+      pq.erase(0);
+      int digits = 0;
+      while (!pq.empty()){
+	digits = digits * 10 + pq.pop() / 10;
+      }
+      return digits;
+    }();
+    static_assert(drained == 7123456, "drained at compile time");
+    TS_ASSERT_EQUALS(drained, 7123456);
+#endif
+
+    constexpr StaticPriorityQueue<int, 4> empty;
+    static_assert(empty.capacity() == 4, "capacity is a constant");
+    static_assert(empty.empty(), "empty is a constant");
+    TS_ASSERT_EQUALS(empty.size(), 0);
+
+  }
+
+};
@@ -0,0 +1,453 @@
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a hierarchical timing wheel, for queues of timeouts
+ * that are mostly cancelled or rescheduled before they fire.
+ * The priority of an element is the tick it is due at. insert(), cancel()
+ * and change_priority() are all O(1): a timer is just linked into or out of
+ * a list, and nothing is ever compared or sifted.
+ * There are several wheels of 2^Bits slots each. The first has one slot per
+ * tick, and each wheel after it has slots 2^Bits times as wide as the one
+ * before. A timer goes in the finest wheel whose coverage reaches its due
+ * tick. As time moves on, each slot of a coarser wheel is emptied into the
+ * finer wheels when time first reaches it, so every timer ends up in the
+ * first wheel by the time it is due.
+ * pop_expired() moves time forward to "now" and hands back every timer that
+ * is due by then, in order of due tick. Ticks where nothing can happen
+ * are skipped, so a long jump costs little more than a short one.
+ * Priorities follow PriorityQueue's rules, so negative ones are rejected.
+ * A timer whose tick has already passed is treated as due at
+ * current_tick(), so it fires on the next pop_expired() that reaches that
+ * tick, not on one for an earlier "now".
+ */
+template <typename E, typename Priority = int, int Bits = 6>
+class TimerWheel {
+
+  static_assert(std::is_integral<Priority>::value, "TimerWheel needs an integer priority type");
+  static_assert(Bits >= 1 && Bits <= 16, "each wheel needs between 2 and 65536 slots");
+
+private:
+
+  // Slots per wheel, and enough wheels to cover every 64-bit tick
+  static const int SLOTS = 1 << Bits;
+  static const int WHEELS = (64 + Bits - 1) / Bits;
+  static const std::uint64_t MASK = SLOTS - 1;
+
+  /*
+   * Class for the bookkeeping of one timer slot: its due tick, its place in
+   * a wheel slot's list, and how many timers have used the slot so stale
+   * handles can be told apart.
+   */
+  class Timer {
+  public:
+    std::uint64_t due;
+    int list;
+    int previous;
+    int next;
+    int generation;
+
+    Timer() : due(0), list(-1), previous(-1), next(-1), generation(0) {
+    }
+  };
+
+  /*
+   * Class for a list of timers sharing a wheel slot, first in, first out.
+   */
+  class List {
+  public:
+    int first;
+    int last;
+
+    List() : first(-1), last(-1) {
+    }
+  };
+
+  /*
+   * Private helper method that returns the list of slot "slot" on wheel
+   * "wheel".
+   */
+  static int listOf(int wheel, std::uint64_t slot) {
+    return wheel * SLOTS + int(slot);
+  }
+
+  /*
+   * Private helper method that links timer "timer" onto the end of list
+   * "list".
+   */
+  void link(int timer, int list) {
+    Timer& entry = timers[timer];
+    entry.list = list;
+    entry.previous = lists[list].last;
+    entry.next = -1;
+    if (lists[list].last != -1) {
+      timers[lists[list].last].next = timer;
+    }
+    else {
+      lists[list].first = timer;
+    }
+    lists[list].last = timer;
+    wheelCounts[list / SLOTS]++;
+  }
+
+  /*
+   * Private helper method that unlinks timer "timer" from its list.
+   */
+  void unlink(int timer) {
+    Timer& entry = timers[timer];
+    List& list = lists[entry.list];
+    if (entry.previous != -1) {
+      timers[entry.previous].next = entry.next;
+    }
+    else {
+      list.first = entry.next;
+    }
+    if (entry.next != -1) {
+      timers[entry.next].previous = entry.previous;
+    }
+    else {
+      list.last = entry.previous;
+    }
+    wheelCounts[entry.list / SLOTS]--;
+    entry.list = -1;
+  }
+
+  /*
+   * Private helper method that files timer "timer" in the finest wheel
+   * that reaches its due tick from the current one. Timers already due go
+   * in the current tick's slot.
+   */
+  void place(int timer) {
+    std::uint64_t due = timers[timer].due;
+    if (due < current) {
+      due = current;
+    }
+
+    // The first wheel above which the due tick and now agree
+    int wheel = 0;
+    while (wheel < WHEELS - 1 && (due >> (Bits * (wheel + 1))) != (current >> (Bits * (wheel + 1)))) {
+      wheel++;
+    }
+    link(timer, listOf(wheel, (due >> (Bits * wheel)) & MASK));
+  }
+
+  /*
+   * Private helper method that empties slot "slot" of wheel "wheel" into
+   * the finer wheels.
+   */
+  void cascade(int wheel, std::uint64_t slot) {
+    List& list = lists[listOf(wheel, slot)];
+    int timer = list.first;
+    while (timer != -1) {
+      int next = timers[timer].next;
+      unlink(timer);
+      place(timer);
+      timer = next;
+    }
+  }
+
+  /*
+   * Private helper method that moves time on to tick "tick", bringing down
+   * every coarser slot that starts there, coarsest first. Time only ever
+   * moves through here, so a coarse slot is always emptied before any timer
+   * can be filed straight into the finer slots it covers, and timers due at
+   * the same tick stay in the order they were scheduled.
+   */
+  void advanceTo(std::uint64_t tick) {
+    current = tick;
+    for (int wheel = WHEELS - 1; wheel > 0; wheel--) {
+      if ((tick & ((std::uint64_t(1) << (Bits * wheel)) - 1)) == 0) {
+        cascade(wheel, (tick >> (Bits * wheel)) & MASK);
+      }
+    }
+  }
+
+  /*
+   * Private helper method that returns the first tick after "tick" at
+   * which anything can happen, given which wheels have timers in them.
+   */
+  std::uint64_t nextEvent(std::uint64_t tick) const {
+    int wheel = 0;
+    while (wheel < WHEELS && wheelCounts[wheel] == 0) {
+      wheel++;
+    }
+    if (wheel == 0) {
+      return tick + 1;
+    }
+    if (wheel == WHEELS) {
+      return UINT64_MAX;
+    }
+
+    // Nothing happens until the next slot boundary of that wheel
+    int shift = Bits * wheel;
+    std::uint64_t next = ((tick >> shift) + 1) << shift;
+    return next > tick ? next : UINT64_MAX;
+  }
+
+  /*
+   * Private helper method that returns a free slot for a new timer.
+   */
+  int acquireSlot() {
+    if (!freeSlots.empty()) {
+      int slot = freeSlots.back();
+      freeSlots.pop_back();
+      return slot;
+    }
+    timers.push_back(Timer());
+    return timers.size() - 1;
+  }
+
+  /*
+   * Private helper method that returns slot "slot" to the free list, so
+   * handles to its old timer stop matching.
+   */
+  void releaseSlot(int slot) {
+    timers[slot].generation++;
+    freeSlots.push_back(slot);
+  }
+
+  // Timers by slot, with their elements alongside
+  std::vector<Timer> timers;
+  std::vector<E> values;
+  std::vector<int> freeSlots;
+
+  // Every wheel's slots end to end, and how many timers each wheel holds
+  std::vector<List> lists;
+  int wheelCounts[WHEELS];
+
+  // The next tick that has not been expired yet
+  std::uint64_t current;
+
+  // Number of timers waiting
+  int count;
+
+public:
+
+  /*
+   * Opaque reference to a single timer, returned by insert().
+   * A handle stops matching anything once its timer has fired or been
+   * cancelled.
+   */
+  class Handle {
+  private:
+    // Private fields
+    int slot;
+    int generation;
+
+    friend class TimerWheel;
+
+    /*
+     * Handle constructor used by the wheel itself.
+     */
+    Handle(int newSlot, int newGeneration) {
+      slot = newSlot;
+      generation = newGeneration;
+    }
+
+  public:
+
+    /*
+     * Default constructor for a handle that refers to nothing.
+     */
+    Handle() {
+      slot = -1;
+      generation = 0;
+    }
+
+    bool operator==(const Handle& other) const {
+      return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const Handle& other) const {
+      return !(*this == other);
+    }
+  };
+
+private:
+
+  /*
+   * Private helper method that returns the slot "handle" refers to, or -1
+   * if its timer has fired or been cancelled.
+   */
+  int findHandle(Handle handle) const {
+    if (handle.slot < 0 || handle.slot >= (int)timers.size() ||
+        timers[handle.slot].generation != handle.generation || timers[handle.slot].list == -1) {
+      return -1;
+    }
+    return handle.slot;
+  }
+
+public:
+
+  /*
+   * Constructor for a wheel whose time starts at tick "start".
+   */
+  explicit TimerWheel(Priority start = 0) : lists(WHEELS * SLOTS), current(PriorityTraits<Priority>::isLegal(start) ? start : 0), count(0) {
+    for (int wheel = 0; wheel < WHEELS; wheel++) {
+      wheelCounts[wheel] = 0;
+    }
+  }
+
+  /*
+   * Schedules "element" to fire at tick "priority".
+   * Returns a handle to the new timer, which refers to nothing if the
+   * priority was rejected.
+   */
+  Handle insert(const Priority& priority, const E& element) {
+    return emplace(priority, element);
+  }
+
+  /*
+   * Same as above, but moves "element" into the wheel instead of
+   * copying it.
+   */
+  Handle insert(const Priority& priority, E&& element) {
+    return emplace(priority, std::move(element));
+  }
+
+  /*
+   * Builds a new timer element from "args", due at tick "priority".
+   */
+  template <typename... Args>
+  Handle emplace(const Priority& priority, Args&&... args) {
+    if (!PriorityTraits<Priority>::isLegal(priority)) {
+      return Handle();
+    }
+
+    int slot = acquireSlot();
+    if (slot == (int)values.size()) {
+      values.emplace_back(std::forward<Args>(args)...);
+    }
+    else {
+      values[slot] = E(std::forward<Args>(args)...);
+    }
+
+    timers[slot].due = priority;
+    place(slot);
+    count++;
+    return Handle(slot, timers[slot].generation);
+  }
+
+  /*
+   * Cancels the timer referred to by "handle" in O(1). Returns false if it
+   * had already fired or been cancelled.
+   */
+  bool cancel(Handle handle) {
+    int slot = findHandle(handle);
+    if (slot == -1) {
+      return false;
+    }
+    unlink(slot);
+    values[slot] = E();
+    releaseSlot(slot);
+    count--;
+    return true;
+  }
+
+  /*
+   * Moves the timer referred to by "handle" to tick "new_priority" in O(1).
+   * Does nothing if it has already fired or been cancelled, or if the new
+   * priority is rejected.
+   */
+  void change_priority(Handle handle, const Priority& new_priority) {
+    int slot = findHandle(handle);
+    if (slot != -1 && PriorityTraits<Priority>::isLegal(new_priority)) {
+      unlink(slot);
+      timers[slot].due = new_priority;
+      place(slot);
+    }
+  }
+
+  /*
+   * Moves time forward to tick "now", and moves every timer due by then to
+   * "out", in order of due tick. Timers due at the same tick come out in the
+   * order they were scheduled. Returns the output iterator past the last
+   * element written.
+   */
+  template <typename OutputIt>
+  OutputIt pop_expired(const Priority& now, OutputIt out) {
+    if (!PriorityTraits<Priority>::isLegal(now) || std::uint64_t(now) < current) {
+      return out;
+    }
+    std::uint64_t end = now;
+
+    // The current tick has already been moved on to, so its coarse slots
+    // have been brought down
+    std::uint64_t tick = current;
+    while (true) {
+      // Everything in this tick's slot is due
+      int list = listOf(0, tick & MASK);
+      while (lists[list].first != -1) {
+        int slot = lists[list].first;
+        unlink(slot);
+        *out++ = std::move(values[slot]);
+        releaseSlot(slot);
+        count--;
+      }
+
+      std::uint64_t next = nextEvent(tick);
+      if (next > end) {
+        break;
+      }
+      tick = next;
+      advanceTo(tick);
+    }
+
+    // Nothing can happen between "tick" and "end", so the tick after "end"
+    // is the only one left that may start a coarse slot holding timers
+    advanceTo(end + 1);
+    return out;
+  }
+
+  /*
+   * Returns true if the timer referred to by "handle" is still waiting,
+   * false otherwise. This is O(1).
+   */
+  bool contains(Handle handle) const {
+    return findHandle(handle) != -1;
+  }
+
+  /*
+   * Returns the tick the timer referred to by "handle" is due at,
+   * or -1 if it has already fired or been cancelled.
+   */
+  Priority get_priority(Handle handle) const {
+    int slot = findHandle(handle);
+    if (slot == -1) {
+      return PriorityTraits<Priority>::none();
+    }
+    return Priority(timers[slot].due);
+  }
+
+  /*
+   * Returns the next tick pop_expired() has not reached yet.
+   */
+  Priority current_tick() const {
+    return Priority(current);
+  }
+
+  /*
+   * Returns the number of timers waiting.
+   */
+  int size() const {
+    return count;
+  }
+
+  /*
+   * Returns true if no timers are waiting, false otherwise.
+   */
+  bool empty() const {
+    return count == 0;
+  }
+
+};
+
+#endif
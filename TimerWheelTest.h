@@ -0,0 +1,211 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <string>
+#include <iterator>
+#include <algorithm>
+
+#include "TimerWheel.h"
+
+class TimerWheelTests : public CxxTest::TestSuite{
+
+public:
+
+  void testFiresInTickOrder(){
+
+    TimerWheel<int> wheel;
+
+    for (int i = 0; i < 1000; i++){
+
+      wheel.insert((i * 7919) % 1000, (i * 7919) % 1000);
+
+    }
+
+    TS_ASSERT(wheel.insert(-1, 0) == TimerWheel<int>::Handle());
+    TS_ASSERT_EQUALS(wheel.size(), 1000);
+
+    std::vector<int> fired;
+    wheel.pop_expired(499, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 500);
+    TS_ASSERT_EQUALS(wheel.current_tick(), 500);
+
+    wheel.pop_expired(100000, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 1000);
+    TS_ASSERT(wheel.empty());
+
+    for (int i = 0; i < fired.size(); i++){
+
+      TS_ASSERT_EQUALS(fired[i], i);
+
+    }
+
+  }
+
+  void testCascadesFromCoarseWheels(){
+
+    TimerWheel<std::string, long> wheel;
+
+    wheel.insert(5000000000L, "far");
+    wheel.insert(300000, "middle");
+    wheel.insert(70, "near");
+    wheel.insert(4096, "boundary");
+    wheel.insert(70, "near again");
+
+    std::vector<std::string> fired;
+    wheel.pop_expired(69, std::back_inserter(fired));
+    TS_ASSERT(fired.empty());
+
+    wheel.pop_expired(4096, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 3);
+    TS_ASSERT_EQUALS(fired[0], "near");
+    TS_ASSERT_EQUALS(fired[1], "near again");
+    TS_ASSERT_EQUALS(fired[2], "boundary");
+
+    wheel.pop_expired(4999999999L, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 4);
+    TS_ASSERT_EQUALS(fired[3], "middle");
+
+    wheel.pop_expired(5000000000L, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 5);
+    TS_ASSERT_EQUALS(fired[4], "far");
+
+  }
+
+  void testCancelAndReschedule(){
+
+    TimerWheel<int> wheel;
+
+    TimerWheel<int>::Handle a = wheel.insert(10, 1);
+    TimerWheel<int>::Handle b = wheel.insert(20, 2);
+    TimerWheel<int>::Handle c = wheel.insert(30, 3);
+
+    TS_ASSERT(wheel.cancel(b));
+    TS_ASSERT(!wheel.cancel(b));
+    TS_ASSERT(!wheel.contains(b));
+    TS_ASSERT_EQUALS(wheel.size(), 2);
+
+    wheel.change_priority(c, 5);
+    TS_ASSERT_EQUALS(wheel.get_priority(c), 5);
+    wheel.change_priority(a, -1);
+    TS_ASSERT_EQUALS(wheel.get_priority(a), 10);
+
+    std::vector<int> fired;
+    wheel.pop_expired(100, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 2);
+    TS_ASSERT_EQUALS(fired[0], 3);
+    TS_ASSERT_EQUALS(fired[1], 1);
+    TS_ASSERT(!wheel.contains(a));
+    TS_ASSERT_EQUALS(wheel.get_priority(a), -1);
+
+    // A reused slot does not bring an old handle back to life
+    TimerWheel<int>::Handle d = wheel.insert(200, 4);
+    TS_ASSERT(!wheel.contains(a));
+    TS_ASSERT(wheel.contains(d));
+
+  }
+
+  void testLateTimersFireNext(){
+
+    TimerWheel<int> wheel(1000);
+
+    std::vector<int> fired;
+    wheel.insert(10, 1);
+    wheel.pop_expired(1000, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 1);
+
+    wheel.insert(500, 2);
+    wheel.pop_expired(999, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 1);
+    wheel.pop_expired(1001, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 2);
+
+    // A late timer is due at the current tick, which a repeat of the last
+    // "now" has not reached
+    wheel.pop_expired(1010, std::back_inserter(fired));
+    wheel.insert(5, 3);
+    TS_ASSERT_EQUALS(wheel.get_priority(wheel.insert(1011, 4)), 1011);
+    wheel.pop_expired(1010, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 2);
+    wheel.pop_expired(1011, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 4);
+    TS_ASSERT_EQUALS(fired[2], 3);
+    TS_ASSERT_EQUALS(fired[3], 4);
+
+  }
+
+  void testSameTickOrderAcrossPops(){
+
+    // Stopping just short of a coarse slot must still bring it down before
+    // a later timer can be filed ahead of the ones already in it
+    TimerWheel<int> wheel;
+    std::vector<int> fired;
+    wheel.insert(150, 1);
+    wheel.pop_expired(127, std::back_inserter(fired));
+    wheel.insert(150, 2);
+    wheel.pop_expired(150, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 2);
+    TS_ASSERT_EQUALS(fired[0], 1);
+    TS_ASSERT_EQUALS(fired[1], 2);
+
+    TimerWheel<int, long> far;
+    far.insert(5000000, 1);
+    far.pop_expired(4194303, std::back_inserter(fired));
+    far.insert(5000000, 2);
+    far.pop_expired(5000000, std::back_inserter(fired));
+    TS_ASSERT_EQUALS(fired.size(), 4);
+    TS_ASSERT_EQUALS(fired[2], 1);
+    TS_ASSERT_EQUALS(fired[3], 2);
+
+  }
+
+  void testRollingTimeouts(){
+
+    // A rolling set of timeouts, most of which are cancelled
+    TimerWheel<int> wheel;
+    std::vector<TimerWheel<int>::Handle> handles;
+    std::vector<int> due;
+    std::vector<bool> cancelled;
+    std::vector<int> fired(20000, 0);
+
+    int now = 0;
+    for (int i = 0; i < 20000; i++){
+
+      int when = now + rand()%100000;
+      handles.push_back(wheel.insert(when, i));
+      due.push_back(when);
+      cancelled.push_back(false);
+
+      if (i % 3 != 0){
+	int victim = rand()%handles.size();
+	if (wheel.cancel(handles[victim])){
+	  cancelled[victim] = true;
+	}
+      }
+
+      if (i % 100 == 0 || i == 19999){
+	now += (i == 19999) ? 200000 : rand()%5000;
+	std::vector<int> batch;
+	wheel.pop_expired(now, std::back_inserter(batch));
+
+	// Each batch comes out in order of due tick, and only once due
+	for (int j = 0; j < batch.size(); j++){
+	  TS_ASSERT(due[batch[j]] <= now);
+	  TS_ASSERT(j == 0 || due[batch[j - 1]] <= due[batch[j]]);
+	  fired[batch[j]]++;
+	}
+      }
+
+    }
+
+    TS_ASSERT(wheel.empty());
+
+    for (int i = 0; i < fired.size(); i++){
+
+      TS_ASSERT_EQUALS(fired[i], cancelled[i] ? 0 : 1);
+
+    }
+
+  }
+
+};
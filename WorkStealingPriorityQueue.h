@@ -0,0 +1,346 @@
+#ifndef _WORK_STEALING_PR_QUEUE_H
+#define _WORK_STEALING_PR_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * This class implements a set of per-worker priority queues for a thread
+ * pool, with work stealing between them.
+ * Each worker pushes to and pops from its own PriorityQueue. When a worker's
+ * queue runs dry it steals from a victim: it takes the top half of the
+ * victim's queue (up to "maxStealBatch" elements) in one go, keeps the best
+ * one and moves the rest into its own queue, so it does not have to come
+ * back for each element.
+ * Thieves never wait. A victim whose queue is busy is skipped rather than
+ * waited on, and empty victims are skipped without touching their lock at all,
+ * so a steal only ever locks a queue that has work in it and is free.
+ * Workers can be given a NUMA node each. A thief tries every victim on its own
+ * node before any on a remote node, so work stays local to its memory
+ * where possible.
+ * Per-worker statistics count steal attempts and how each one ended, to help
+ * tune how work is first handed out.
+ * The template parameters are the same as for PriorityQueue.
+ */
+template <typename E, int Arity = 2, typename Priority = int, typename Compare = std::less<Priority> >
+class WorkStealingPriorityQueue {
+
+public:
+
+  /*
+   * Class for a snapshot of one worker's steal statistics, counted from the
+   * worker's side as a thief.
+   */
+  class StealStats {
+  public:
+
+    // Steals tried because the local queue was empty
+    long attempts;
+
+    // Steals that came back with at least one element
+    long successes;
+
+    // Steals that found every victim empty or busy
+    long failures;
+
+    // Victims skipped because another thread held their queue
+    long contended;
+
+    // Elements taken, including the ones moved into the local queue
+    long stolen;
+
+    // Successful steals from a worker on another NUMA node
+    long remote;
+
+    /*
+     * StealStats constructor with every count at zero.
+     */
+    StealStats() : attempts(0), successes(0), failures(0), contended(0), stolen(0), remote(0) {
+    }
+  };
+
+private:
+
+  typedef PriorityQueue<E, Arity, Priority, Compare> Queue;
+
+  /*
+   * Class for one worker's queue and counters, padded to its own cache line
+   * so workers do not false-share.
+   */
+  class alignas(64) Worker {
+  public:
+    std::mutex lock;
+    Queue queue;
+
+    // Size of "queue", readable without the lock
+    std::atomic<int> count;
+
+    // Steal statistics, only written by this worker
+    std::atomic<long> attempts;
+    std::atomic<long> successes;
+    std::atomic<long> failures;
+    std::atomic<long> contended;
+    std::atomic<long> stolen;
+    std::atomic<long> remote;
+
+    // Other workers in the order this one steals from them: same node first
+    std::vector<int> victims;
+    int localVictims;
+
+    /*
+     * Worker constructor with an empty queue.
+     */
+    Worker() : count(0), attempts(0), successes(0), failures(0), contended(0), stolen(0), remote(0),
+               localVictims(0) {
+    }
+  };
+
+  /*
+   * Private helper method that returns a random number, using a per-thread
+   * xorshift generator so threads never share random state.
+   */
+  static std::uint64_t random() {
+    static thread_local std::uint64_t state =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+
+  /*
+   * Private helper method that bumps one of a worker's own counters. Only the
+   * worker writes them, so there is no need for a locked add.
+   */
+  static void bump(std::atomic<long>& counter, long amount = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  /*
+   * Private helper method that tries to steal a batch from "victim" into
+   * "thief". Returns true and the best stolen element in "element" on success.
+   * Sets "busy" if the victim's lock was held.
+   */
+  bool stealFrom(Worker& thief, Worker& victim, E& element, bool& busy) {
+    busy = false;
+    int expected = victim.count.load(std::memory_order_relaxed);
+    if (expected == 0) {
+      return false;
+    }
+
+    // Make room before taking the lock, so it is only held for one pop_n()
+    std::vector<E> taken;
+    std::vector<Priority> priorities;
+    taken.reserve(std::min(maxStealBatch, (expected + 1) / 2));
+    priorities.reserve(taken.capacity());
+    if (!victim.lock.try_lock()) {
+      busy = true;
+      return false;
+    }
+    int batch = std::min(maxStealBatch, (victim.queue.size() + 1) / 2);
+    victim.queue.pop_n(batch, std::back_inserter(taken), std::back_inserter(priorities));
+    victim.count.store(victim.queue.size(), std::memory_order_relaxed);
+    victim.lock.unlock();
+
+    if (taken.empty()) {
+      return false;
+    }
+
+    // Keep the best element and queue up the rest locally
+    element = std::move(taken[0]);
+    if (taken.size() > 1) {
+      std::lock_guard<std::mutex> guard(thief.lock);
+      for (std::size_t i = 1; i < taken.size(); i++) {
+        thief.queue.insert(priorities[i], std::move(taken[i]));
+      }
+      thief.count.store(thief.queue.size(), std::memory_order_relaxed);
+    }
+    bump(thief.stolen, taken.size());
+    return true;
+  }
+
+  /*
+   * Private helper method that goes through "thief"'s victims, nearest first,
+   * until one of them gives up a batch.
+   */
+  bool steal(Worker& thief, E& element) {
+    bump(thief.attempts);
+
+    // Start each group at a random victim so thieves spread out
+    int victimCount = thief.victims.size();
+    int groups[2][2] = {{0, thief.localVictims}, {thief.localVictims, victimCount}};
+    for (int group = 0; group < 2; group++) {
+      int begin = groups[group][0];
+      int length = groups[group][1] - begin;
+      if (length == 0) {
+        continue;
+      }
+
+      int start = random() % length;
+      for (int i = 0; i < length; i++) {
+        Worker& victim = workers[thief.victims[begin + (start + i) % length]];
+        bool busy;
+        if (stealFrom(thief, victim, element, busy)) {
+          bump(thief.successes);
+          if (group == 1) {
+            bump(thief.remote);
+          }
+          return true;
+        }
+        if (busy) {
+          bump(thief.contended);
+        }
+      }
+    }
+
+    bump(thief.failures);
+    return false;
+  }
+
+  // One queue per worker
+  AlignedArray<Worker> workers;
+  int workerCount;
+
+  // Most elements one steal takes
+  int maxStealBatch;
+
+public:
+
+  /*
+   * Constructor that takes the number of workers and, optionally, the NUMA
+   * node of each worker and the most elements one steal may take. Workers
+   * without a node given all count as being on node 0.
+   */
+  explicit WorkStealingPriorityQueue(int newWorkerCount, const std::vector<int>& workerNodes = std::vector<int>(),
+                                     int newMaxStealBatch = 32)
+    : workers(std::max(1, newWorkerCount)), workerCount(std::max(1, newWorkerCount)),
+      maxStealBatch(std::max(1, newMaxStealBatch)) {
+    for (int i = 0; i < workerCount; i++) {
+      int node = i < (int)workerNodes.size() ? workerNodes[i] : 0;
+      std::vector<int>& victims = workers[i].victims;
+      for (int j = 0; j < workerCount; j++) {
+        int otherNode = j < (int)workerNodes.size() ? workerNodes[j] : 0;
+        if (j != i && otherNode == node) {
+          victims.push_back(j);
+        }
+      }
+      workers[i].localVictims = victims.size();
+      for (int j = 0; j < workerCount; j++) {
+        int otherNode = j < (int)workerNodes.size() ? workerNodes[j] : 0;
+        if (otherNode != node) {
+          victims.push_back(j);
+        }
+      }
+    }
+  }
+
+  /*
+   * Adds "element" with priority "priority" to the queue of worker "worker".
+   * Returns false if the priority was rejected.
+   */
+  bool push(int worker, const Priority& priority, E element) {
+    Worker& owner = workers[worker];
+    std::lock_guard<std::mutex> guard(owner.lock);
+    if (owner.queue.insert(priority, std::move(element)) == typename Queue::Handle()) {
+      return false;
+    }
+    owner.count.store(owner.queue.size(), std::memory_order_relaxed);
+    return true;
+  }
+
+  /*
+   * Takes the lowest priority value element from the queue of worker
+   * "worker" and moves it into "element", stealing from another worker if
+   * that queue is empty. Returns false if nothing could be found.
+   */
+  bool try_pop(int worker, E& element) {
+    Worker& owner = workers[worker];
+    if (owner.count.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> guard(owner.lock);
+      if (!owner.queue.empty()) {
+        element = owner.queue.pop();
+        owner.count.store(owner.queue.size(), std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return steal(owner, element);
+  }
+
+  /*
+   * Returns the number of elements across every worker's queue. With other
+   * threads running this is only a snapshot.
+   */
+  int size() const {
+    int total = 0;
+    for (int i = 0; i < workerCount; i++) {
+      total += workers[i].count.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /*
+   * Returns true if every worker's queue is empty, false otherwise.
+   */
+  bool empty() const {
+    return size() == 0;
+  }
+
+  /*
+   * Returns the number of elements in the queue of worker "worker".
+   */
+  int size(int worker) const {
+    return workers[worker].count.load(std::memory_order_relaxed);
+  }
+
+  /*
+   * Returns the number of workers.
+   */
+  int worker_count() const {
+    return workerCount;
+  }
+
+  /*
+   * Returns the steal statistics of worker "worker".
+   */
+  StealStats stats(int worker) const {
+    const Worker& thief = workers[worker];
+    StealStats result;
+    result.attempts = thief.attempts.load(std::memory_order_relaxed);
+    result.successes = thief.successes.load(std::memory_order_relaxed);
+    result.failures = thief.failures.load(std::memory_order_relaxed);
+    result.contended = thief.contended.load(std::memory_order_relaxed);
+    result.stolen = thief.stolen.load(std::memory_order_relaxed);
+    result.remote = thief.remote.load(std::memory_order_relaxed);
+    return result;
+  }
+
+  /*
+   * Returns the steal statistics of every worker added together.
+   */
+  StealStats stats() const {
+    StealStats total;
+    for (int i = 0; i < workerCount; i++) {
+      StealStats one = stats(i);
+      total.attempts += one.attempts;
+      total.successes += one.successes;
+      total.failures += one.failures;
+      total.contended += one.contended;
+      total.stolen += one.stolen;
+      total.remote += one.remote;
+    }
+    return total;
+  }
+
+};
+
+#endif
@@ -0,0 +1,167 @@
+#define CXXTEST_HAVE_EH
+#define CXXTEST_ABORT_TEST_ON_FAIL
+#include <cxxtest/TestSuite.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "WorkStealingPriorityQueue.h"
+
+class WorkStealingPriorityQueueTests : public CxxTest::TestSuite{
+
+public:
+
+  void testLocalPopsInPriorityOrder(){
+
+    WorkStealingPriorityQueue<int> pq(2);
+
+    for (int i = 0; i < 100; i++){
+
+      pq.push(0, (i * 37) % 100, (i * 37) % 100);
+
+    }
+
+    TS_ASSERT(!pq.push(0, -1, 0));
+    TS_ASSERT_EQUALS(pq.size(), 100);
+    TS_ASSERT_EQUALS(pq.size(0), 100);
+
+    int element;
+
+    for (int i = 0; i < 100; i++){
+
+      TS_ASSERT(pq.try_pop(0, element));
+      TS_ASSERT_EQUALS(element, i);
+
+    }
+
+    TS_ASSERT(pq.empty());
+    TS_ASSERT(!pq.try_pop(0, element));
+    TS_ASSERT_EQUALS(pq.stats(0).attempts, 1);
+    TS_ASSERT_EQUALS(pq.stats(0).failures, 1);
+
+  }
+
+  void testStealTakesTopHalf(){
+
+    WorkStealingPriorityQueue<int> pq(2, std::vector<int>(), 100);
+
+    for (int i = 0; i < 10; i++){
+
+      pq.push(0, i, i);
+
+    }
+
+    int element;
+
+    // Worker 1 is empty, so it steals 0 to 4 and keeps 1 to 4 for later
+    TS_ASSERT(pq.try_pop(1, element));
+    TS_ASSERT_EQUALS(element, 0);
+    TS_ASSERT_EQUALS(pq.size(0), 5);
+    TS_ASSERT_EQUALS(pq.size(1), 4);
+
+    for (int i = 1; i < 5; i++){
+
+      TS_ASSERT(pq.try_pop(1, element));
+      TS_ASSERT_EQUALS(element, i);
+
+    }
+
+    TS_ASSERT(pq.try_pop(0, element));
+    TS_ASSERT_EQUALS(element, 5);
+
+    WorkStealingPriorityQueue<int>::StealStats stats = pq.stats(1);
+    TS_ASSERT_EQUALS(stats.attempts, 1);
+    TS_ASSERT_EQUALS(stats.successes, 1);
+    TS_ASSERT_EQUALS(stats.stolen, 5);
+    TS_ASSERT_EQUALS(stats.remote, 0);
+
+  }
+
+  void testStealBatchIsCapped(){
+
+    WorkStealingPriorityQueue<int> pq(2, std::vector<int>(), 3);
+
+    for (int i = 0; i < 100; i++){
+
+      pq.push(0, i, i);
+
+    }
+
+    int element;
+    TS_ASSERT(pq.try_pop(1, element));
+    TS_ASSERT_EQUALS(pq.size(0), 97);
+    TS_ASSERT_EQUALS(pq.size(1), 2);
+
+  }
+
+  void testStealsFromSameNodeFirst(){
+
+    std::vector<int> nodes;
+    nodes.push_back(0);
+    nodes.push_back(1);
+    nodes.push_back(0);
+    WorkStealingPriorityQueue<int> pq(3, nodes, 1);
+
+    pq.push(1, 0, 100);
+    pq.push(2, 5, 200);
+
+    int element;
+
+    // Worker 2 is on node 0 with worker 0, even though worker 1 has the
+    // better element
+    TS_ASSERT(pq.try_pop(0, element));
+    TS_ASSERT_EQUALS(element, 200);
+    TS_ASSERT_EQUALS(pq.stats(0).remote, 0);
+
+    TS_ASSERT(pq.try_pop(0, element));
+    TS_ASSERT_EQUALS(element, 100);
+    TS_ASSERT_EQUALS(pq.stats(0).remote, 1);
+    TS_ASSERT_EQUALS(pq.stats().successes, 2);
+
+  }
+
+  void testConcurrentWorkers(){
+
+    WorkStealingPriorityQueue<int> pq(4);
+    std::vector<std::atomic<int> > seen(16000);
+    std::atomic<int> removed(0);
+    std::vector<std::thread> threads;
+
+    // Only worker 0 is handed work, so the others have to steal it
+    for (int i = 0; i < 16000; i++){
+
+      pq.push(0, i % 50, i);
+
+    }
+
+    for (int t = 0; t < 4; t++){
+
+      threads.push_back(std::thread([&, t](){
+	int element;
+	while (removed.load() < 16000){
+	  if (pq.try_pop(t, element)){
+	    seen[element]++;
+	    removed++;
+	  }
+	}
+      }));
+
+    }
+
+    for (int i = 0; i < threads.size(); i++){
+
+      threads[i].join();
+
+    }
+
+    TS_ASSERT(pq.empty());
+
+    for (int i = 0; i < seen.size(); i++){
+
+      TS_ASSERT_EQUALS(seen[i].load(), 1);
+
+    }
+
+  }
+
+};
@@ -0,0 +1,56 @@
+/*
+ * Benchmark comparing heap arities on a mixed insert/pop workload.
+ * Each round keeps the queue at roughly N elements by pushing one new
+ * element for every one it pops, so both sift directions are exercised.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/ArityBenchmark.cpp -o arity_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+
+/*
+ * Runs the insert/pop mix on a queue of arity "Arity" holding "n" elements
+ * and returns the average nanoseconds per insert/pop pair.
+ */
+template <int Arity>
+double runMix(int n, int operations) {
+  PriorityQueue<int, Arity> pq;
+  std::srand(42);
+
+  for (int i = 0; i < n; i++) {
+    pq.insert(std::rand() % n, i);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < operations; i++) {
+    checksum += pq.remove_front();
+    pq.insert(std::rand() % n, i);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+int main() {
+  const int operations = 100000;
+
+  std::cout << "N\tarity 2\tarity 4\tarity 8\t(ns per insert+pop)" << std::endl;
+
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    std::cout << n << "\t" << runMix<2>(n, operations)
+              << "\t" << runMix<4>(n, operations)
+              << "\t" << runMix<8>(n, operations) << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Benchmark for AsyncPriorityQueue with small batches going into a large
+ * heap. The queue is filled to N elements, and then either each push is
+ * followed by a try_pop(), which drains a one-element staging buffer, or
+ * whole batches are pushed and flushed. Either way the time per batch
+ * should grow with log N, not N, since the heap lock is held for one sift
+ * per element.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -pthread -I. bench/AsyncBenchmark.cpp -o async_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "AsyncPriorityQueue.h"
+
+/*
+ * Fills "pq" with "n" elements of random priority.
+ */
+void fill(AsyncPriorityQueue<int>& pq, int n) {
+  std::srand(42);
+  for (int i = 0; i < n; i++) {
+    pq.push(std::rand() % 1000000, i);
+  }
+  pq.flush();
+}
+
+/*
+ * Returns the average nanoseconds per push and try_pop() pair with the
+ * queue kept at "n" elements.
+ */
+double runPushPop(int n, int operations) {
+  AsyncPriorityQueue<int> pq(64, 1);
+  fill(pq, n);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < operations; i++) {
+    pq.push(std::rand() % 1000000, i);
+    int element = 0;
+    pq.try_pop(element);
+    checksum += element;
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+/*
+ * Returns the average nanoseconds to push and flush one batch of "batch"
+ * elements into a queue that starts at "n" elements.
+ */
+double runBatches(int n, int batch, int batches) {
+  AsyncPriorityQueue<int> pq(batch, 1);
+  fill(pq, n);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < batches; i++) {
+    for (int j = 0; j < batch; j++) {
+      pq.push(std::rand() % 1000000, j);
+    }
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / batches;
+}
+
+int main() {
+  std::cout << "N\tpush+pop\t64-batch\t(ns)" << std::endl;
+
+  for (int n = 100000; n <= 4000000; n *= 2) {
+    std::cout << n << "\t" << runPushPop(n, 100000) << "\t" << runBatches(n, 64, 2000) << std::endl;
+  }
+
+  return 0;
+}
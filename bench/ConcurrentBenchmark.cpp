@@ -0,0 +1,125 @@
+/*
+ * Multi-threaded throughput benchmark for ConcurrentPriorityQueue,
+ * MultiQueue and LockFreePriorityQueue.
+ * Every thread alternates push and try_pop on a shared queue that starts
+ * with some elements in it. The same workload also runs against a plain
+ * PriorityQueue behind one global mutex for comparison.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -pthread -I. bench/ConcurrentBenchmark.cpp -o concurrent_benchmark
+ */
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentPriorityQueue.h"
+#include "LockFreePriorityQueue.h"
+#include "MultiQueue.h"
+
+/*
+ * PriorityQueue behind a single mutex, the baseline being replaced.
+ */
+class GlobalLockQueue {
+private:
+  PriorityQueue<int> queue;
+  std::mutex mutex;
+
+public:
+  bool push(int priority, int element) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.contains(queue.insert(priority, element));
+  }
+
+  bool try_pop(int& element) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty()) {
+      return false;
+    }
+    element = queue.pop();
+    return true;
+  }
+};
+
+/*
+ * MultiQueue under the push/try_pop names the benchmark uses.
+ */
+class RelaxedQueue {
+private:
+  MultiQueue<int> queue;
+
+public:
+  bool push(int priority, int element) {
+    return queue.insert(priority, element);
+  }
+
+  bool try_pop(int& element) {
+    return queue.try_remove_front(element);
+  }
+};
+
+/*
+ * LockFreePriorityQueue under the push/try_pop names the benchmark uses.
+ */
+class SkiplistQueue {
+private:
+  LockFreePriorityQueue<int> queue;
+
+public:
+  bool push(int priority, int element) {
+    return queue.insert(priority, element);
+  }
+
+  bool try_pop(int& element) {
+    return queue.try_remove_front(element);
+  }
+};
+
+/*
+ * Runs "threads" threads doing "operations" push/try_pop pairs each and
+ * returns the throughput in millions of operations per second.
+ */
+template <typename Queue>
+double runThreads(int threads, int operations) {
+  Queue queue;
+  for (int i = 0; i < 10000; i++) {
+    queue.push((i * 7919) % 10000, i);
+  }
+
+  std::vector<std::thread> workers;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread([&queue, t, operations]() {
+      unsigned seed = t + 1;
+      int element;
+      for (int i = 0; i < operations; i++) {
+        seed = seed * 1103515245 + 12345;
+        queue.push((seed >> 8) % 10000, i);
+        queue.try_pop(element);
+      }
+    }));
+  }
+  for (int t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  return 2.0 * threads * operations / seconds / 1e6;
+}
+
+int main() {
+  const int operations = 200000;
+
+  std::cout << "threads\tglobal mutex\tflat combining\tmultiqueue\tskiplist\t(Mops/s)" << std::endl;
+
+  for (int threads = 1; threads <= 32; threads *= 2) {
+    std::cout << threads << "\t" << runThreads<GlobalLockQueue>(threads, operations / threads)
+              << "\t" << runThreads<ConcurrentPriorityQueue<int> >(threads, operations / threads)
+              << "\t" << runThreads<RelaxedQueue>(threads, operations / threads)
+              << "\t" << runThreads<SkiplistQueue>(threads, operations / threads) << std::endl;
+  }
+
+  return 0;
+}
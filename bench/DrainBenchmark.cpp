@@ -0,0 +1,66 @@
+/*
+ * Benchmark for pulling batches off the front of a queue.
+ * Compares calling remove_front() K times against one pop_n(K) call, for
+ * batch sizes from 64 to 1024, for large fractions of the queue, and for
+ * draining the whole queue.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/DrainBenchmark.cpp -o drain_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+#include "PriorityQueue.h"
+
+/*
+ * Builds a queue of "n" random priorities.
+ */
+void fill(PriorityQueue<int>& pq, int n) {
+  std::srand(42);
+  std::vector<std::pair<int, int> > pairs;
+  for (int i = 0; i < n; i++) {
+    pairs.push_back(std::pair<int, int>(std::rand(), i));
+  }
+  pq.insert_all(std::move(pairs));
+}
+
+/*
+ * Returns the average nanoseconds per element for taking "batch" elements
+ * off a queue of "n", either with a remove_front() loop or with pop_n().
+ */
+double runBatch(int n, int batch, bool batched) {
+  PriorityQueue<int> pq;
+  fill(pq, n);
+
+  std::vector<int> output;
+  output.reserve(batch);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (batched) {
+    pq.pop_n(batch, std::back_inserter(output));
+  }
+  else {
+    for (int i = 0; i < batch; i++) {
+      output.push_back(pq.remove_front());
+    }
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / batch;
+}
+
+int main() {
+  std::cout << "N\tK\tremove_front\tpop_n\t(ns per element)" << std::endl;
+
+  for (int n = 100000; n <= 1000000; n *= 10) {
+    int batches[] = { 64, 256, 1024, n / 16, n / 4, n };
+    for (int i = 0; i < 6; i++) {
+      std::cout << n << "\t" << batches[i] << "\t" << runBatch(n, batches[i], false)
+                << "\t" << runBatch(n, batches[i], true) << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Benchmark for merging per-shard queues into one. PriorityQueue has to copy
+ * every element out with get_all_elements()/get_all_priorities() and
+ * insert_all() them, while PairingPriorityQueue melds in O(1). A plain
+ * insert/pop mix is timed too, to show what the pairing heap costs there.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/MergeBenchmark.cpp -o merge_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "PriorityQueue.h"
+#include "PairingPriorityQueue.h"
+
+/*
+ * Merges "other" into "into" the only way PriorityQueue allows.
+ */
+void mergeInto(PriorityQueue<int>& into, PriorityQueue<int>& other) {
+  std::vector<int> elements = other.get_all_elements();
+  std::vector<int> priorities = other.get_all_priorities();
+  std::vector<std::pair<int,int> > pairs;
+  pairs.reserve(elements.size());
+  for (std::size_t i = 0; i < elements.size(); i++) {
+    pairs.push_back(std::make_pair(priorities[i], elements[i]));
+  }
+  into.insert_all(std::move(pairs));
+  other = PriorityQueue<int>();
+}
+
+/*
+ * Same as above for PairingPriorityQueue.
+ */
+void mergeInto(PairingPriorityQueue<int>& into, PairingPriorityQueue<int>& other) {
+  into.merge(std::move(other));
+}
+
+/*
+ * Fills "shards" queues of "n" elements each, then returns the average
+ * microseconds to merge them all into one.
+ */
+template <typename Queue>
+double runMerge(int shards, int n) {
+  std::vector<Queue> queues(shards);
+  std::srand(42);
+  for (int s = 0; s < shards; s++) {
+    for (int i = 0; i < n; i++) {
+      queues[s].insert(std::rand() % 1000000, i);
+    }
+  }
+
+  Queue all;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int s = 0; s < shards; s++) {
+    mergeInto(all, queues[s]);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the merge from being optimised away
+  if (all.size() != shards * n) {
+    std::cout << "lost elements" << std::endl;
+  }
+
+  return std::chrono::duration<double, std::micro>(end - start).count() / shards;
+}
+
+/*
+ * Keeps "Queue" at "n" elements and returns the average nanoseconds per
+ * insert/pop pair.
+ */
+template <typename Queue>
+double runMix(int n, int operations) {
+  Queue pq;
+  std::srand(42);
+  for (int i = 0; i < n; i++) {
+    pq.insert(std::rand() % 1000000, i);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < operations; i++) {
+    checksum += pq.pop();
+    pq.insert(std::rand() % 1000000, i);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+int main() {
+  std::cout << "shard size\tbinary heap\tpairing heap\t(us per shard merged, 16 shards)" << std::endl;
+  for (int n = 1000; n <= 100000; n *= 10) {
+    std::cout << n << "\t" << runMerge<PriorityQueue<int> >(16, n)
+              << "\t" << runMerge<PairingPriorityQueue<int> >(16, n) << std::endl;
+  }
+
+  std::cout << std::endl << "N\tbinary heap\tpairing heap\t(ns per insert+pop)" << std::endl;
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    std::cout << n << "\t" << runMix<PriorityQueue<int> >(n, 200000)
+              << "\t" << runMix<PairingPriorityQueue<int> >(n, 200000) << std::endl;
+  }
+
+  return 0;
+}
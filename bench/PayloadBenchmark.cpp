@@ -0,0 +1,57 @@
+/*
+ * Benchmark for queues carrying large payloads.
+ * Uses a ~200 byte job descriptor as the element type and times a mixed
+ * insert/pop workload, which is dominated by how much memory each sift
+ * step has to touch.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/PayloadBenchmark.cpp -o payload_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+
+/*
+ * Stand-in for a scheduler job descriptor.
+ */
+struct Job {
+  long id;
+  char data[192];
+
+  bool operator==(const Job& other) const {
+    return id == other.id;
+  }
+};
+
+int main() {
+  const int operations = 100000;
+
+  std::cout << "N\tns per insert+pop\t(payload " << sizeof(Job) << " bytes)" << std::endl;
+
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    PriorityQueue<Job> pq;
+    std::srand(42);
+
+    Job job = Job();
+    for (int i = 0; i < n; i++) {
+      job.id = i;
+      pq.insert(std::rand() % n, job);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long checksum = 0;
+    for (int i = 0; i < operations; i++) {
+      checksum += pq.remove_front().id;
+      job.id = i;
+      pq.insert(std::rand() % n, job);
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    double nanos = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << n << "\t" << nanos / operations << "\t(checksum " << checksum << ")" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Benchmark for PriorityQueue::remove_front().
+ * Fills a queue with N random priorities and then times a fixed number of
+ * pops, so the reported cost per pop should only grow with log(N).
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/PopBenchmark.cpp -o pop_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+
+int main() {
+  const int pops = 10000;
+  std::srand(42);
+
+  std::cout << "N\tns/pop" << std::endl;
+
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    PriorityQueue<int> pq;
+    for (int i = 0; i < n + pops; i++) {
+      pq.insert(std::rand() % n, i);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long checksum = 0;
+    for (int i = 0; i < pops; i++) {
+      checksum += pq.remove_front();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    double nanos = std::chrono::duration<double, std::nano>(end - start).count();
+    std::cout << n << "\t" << nanos / pops << "\t(checksum " << checksum << ")" << std::endl;
+  }
+
+  return 0;
+}
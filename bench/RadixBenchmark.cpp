@@ -0,0 +1,61 @@
+/*
+ * Benchmark for RadixPriorityQueue against the heap-based PriorityQueue on
+ * a monotone workload. The queue is kept at N elements, and each new
+ * priority is the one just taken plus a random step, the way Dijkstra's
+ * algorithm and timer queues use a priority queue.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/RadixBenchmark.cpp -o radix_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+#include "RadixPriorityQueue.h"
+
+/*
+ * Keeps "Queue" at "n" elements with steps of up to "step" and returns the
+ * average nanoseconds per pop/insert pair.
+ */
+template <typename Queue>
+double runMonotone(int n, int step, int operations) {
+  Queue pq;
+  std::srand(42);
+
+  for (int i = 0; i < n; i++) {
+    pq.insert(std::rand() % step, i);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < operations; i++) {
+    int priority = pq.peek_priority();
+    checksum += pq.pop();
+    pq.insert(priority + std::rand() % step, i);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+int main() {
+  const int operations = 1000000;
+
+  std::cout << "N\tstep\theap\tradix\t(ns per pop+insert)" << std::endl;
+
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    for (int step = 100; step <= 100000; step *= 1000) {
+      std::cout << n << "\t" << step
+                << "\t" << runMonotone<PriorityQueue<int> >(n, step, operations)
+                << "\t" << runMonotone<RadixPriorityQueue<int> >(n, step, operations) << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Microbenchmark for the SIMD child search in wide heaps.
+ * Times remove_front() on 4, 8 and 16-ary heaps. Build it twice, once as
+ * normal and once with the scalar path forced, and compare the two runs:
+ *   g++ -O2 -std=c++11 -mavx2 -I. bench/SimdBenchmark.cpp -o simd_benchmark
+ *   g++ -O2 -std=c++11 -mavx2 -DPRIORITY_QUEUE_NO_SIMD -I. bench/SimdBenchmark.cpp -o scalar_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+
+/*
+ * Fills a queue of arity "Arity" with "n" random priorities and returns the
+ * average nanoseconds per remove_front() while draining half of it.
+ */
+template <int Arity>
+double runPops(int n) {
+  PriorityQueue<int, Arity> pq;
+  std::srand(42);
+
+  std::vector<std::pair<int, int> > pairs;
+  for (int i = 0; i < n; i++) {
+    pairs.push_back(std::pair<int, int>(std::rand(), i));
+  }
+  pq.insert_all(std::move(pairs));
+
+  int pops = n / 2;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < pops; i++) {
+    checksum += pq.remove_front();
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / pops;
+}
+
+int main() {
+#if defined(PRIORITY_QUEUE_SIMD_AVX2)
+  std::cout << "child search: AVX2" << std::endl;
+#elif defined(PRIORITY_QUEUE_SIMD_SSE2)
+  std::cout << "child search: SSE" << std::endl;
+#elif defined(PRIORITY_QUEUE_SIMD_NEON)
+  std::cout << "child search: NEON" << std::endl;
+#else
+  std::cout << "child search: scalar" << std::endl;
+#endif
+
+  std::cout << "N\tarity 4\tarity 8\tarity 16\t(ns per remove_front)" << std::endl;
+
+  for (int n = 10000; n <= 1000000; n *= 10) {
+    std::cout << n << "\t" << runPops<4>(n)
+              << "\t" << runPops<8>(n)
+              << "\t" << runPops<16>(n) << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Benchmark for the cost of stable (FIFO within a priority) ordering.
+ * Runs the same insert/pop mix through the default queue and the stable
+ * queue, once with few distinct priorities (lots of ties) and once with
+ * many.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/StableBenchmark.cpp -o stable_benchmark
+ */
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "PriorityQueue.h"
+
+/*
+ * Keeps "Queue" at "n" elements with priorities below "distinct" and
+ * returns the average nanoseconds per insert/pop pair.
+ */
+template <typename Queue>
+double runMix(int n, int distinct, int operations) {
+  Queue pq;
+  std::srand(42);
+
+  for (int i = 0; i < n; i++) {
+    pq.insert(std::rand() % distinct, i);
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  long checksum = 0;
+  for (int i = 0; i < operations; i++) {
+    checksum += pq.remove_front();
+    pq.insert(std::rand() % distinct, i);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  // Keeps the loop from being optimised away
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+
+  return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+int main() {
+  const int operations = 100000;
+
+  std::cout << "N\tpriorities\tdefault\tstable\t(ns per insert+pop)" << std::endl;
+
+  for (int n = 1000; n <= 1000000; n *= 10) {
+    for (int distinct = 4; distinct <= 1000000; distinct *= 250000) {
+      std::cout << n << "\t" << distinct
+                << "\t" << runMix<PriorityQueue<int> >(n, distinct, operations)
+                << "\t" << runMix<StablePriorityQueue<int> >(n, distinct, operations) << std::endl;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,316 @@
+/*
+ * Benchmark suite for PriorityQueue, for tracking regressions between
+ * releases. Covers insert, remove_front, change_priority, insert_all,
+ * contains and a mixed workload at N = 1e3 up to 1e7, with int and
+ * std::string payloads.
+ *
+ * Prints a table by default. With --json it prints the results in the same
+ * layout as Google Benchmark's --benchmark_format=json, so its compare.py
+ * and any dashboards built for it can read them. --max-n lowers the largest
+ * N for quick runs.
+ *
+ * Build from the repository root with:
+ *   g++ -O2 -std=c++11 -I. bench/SuiteBenchmark.cpp -o suite_benchmark
+ * and run with:
+ *   ./suite_benchmark --json > results.json
+ */
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "PriorityQueue.h"
+
+/*
+ * Builds the payload for element "i". Strings are long enough to be kept
+ * on the heap rather than inline.
+ */
+template <typename T>
+T makePayload(int i);
+
+template <>
+int makePayload<int>(int i) {
+  return i;
+}
+
+template <>
+std::string makePayload<std::string>(int i) {
+  return "benchmark-payload-" + std::to_string(i);
+}
+
+/*
+ * Returns the name a payload type goes by in the results.
+ */
+template <typename T>
+const char* payloadName();
+
+template <>
+const char* payloadName<int>() {
+  return "int";
+}
+
+template <>
+const char* payloadName<std::string>() {
+  return "string";
+}
+
+/*
+ * Class for one measurement: nanoseconds per operation over "iterations"
+ * operations.
+ */
+class Result {
+public:
+  std::string name;
+  long iterations;
+  double nanoseconds;
+
+  Result(const std::string& newName, long newIterations, double newNanoseconds)
+    : name(newName), iterations(newIterations), nanoseconds(newNanoseconds) {
+  }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+ * Returns the nanoseconds from "start" to now, divided by "operations".
+ */
+double perOperation(Clock::time_point start, long operations) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / operations;
+}
+
+// Keeps results from being optimised away
+long checksum = 0;
+
+/*
+ * Fills "pq" with "n" elements at random priorities, keeping their handles
+ * in "handles" if it is not null.
+ */
+template <typename T>
+void fill(PriorityQueue<T>& pq, int n, std::vector<typename PriorityQueue<T>::Handle>* handles) {
+  pq.reserve(n);
+  for (int i = 0; i < n; i++) {
+    typename PriorityQueue<T>::Handle handle = pq.insert(std::rand() % n, makePayload<T>(i));
+    if (handles != nullptr) {
+      handles->push_back(handle);
+    }
+  }
+}
+
+/*
+ * Inserts "n" elements one at a time into an empty queue.
+ */
+template <typename T>
+Result benchInsert(int n) {
+  std::vector<T> payloads;
+  for (int i = 0; i < n; i++) {
+    payloads.push_back(makePayload<T>(i));
+  }
+
+  PriorityQueue<T> pq;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < n; i++) {
+    pq.insert(std::rand() % n, std::move(payloads[i]));
+  }
+  double time = perOperation(start, n);
+  checksum += pq.size();
+  return Result("insert", n, time);
+}
+
+/*
+ * Empties a queue of "n" elements with remove_front().
+ */
+template <typename T>
+Result benchRemoveFront(int n) {
+  PriorityQueue<T> pq;
+  fill(pq, n, nullptr);
+
+  Clock::time_point start = Clock::now();
+  while (!pq.empty()) {
+    T element = pq.remove_front();
+    checksum += sizeof(element);
+  }
+  return Result("remove_front", n, perOperation(start, n));
+}
+
+/*
+ * Changes the priority of random elements through their handles.
+ */
+template <typename T>
+Result benchChangePriority(int n) {
+  PriorityQueue<T> pq;
+  std::vector<typename PriorityQueue<T>::Handle> handles;
+  fill(pq, n, &handles);
+
+  int operations = n < 1000000 ? n : 1000000;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < operations; i++) {
+    pq.change_priority(handles[std::rand() % n], std::rand() % n);
+  }
+  double time = perOperation(start, operations);
+  checksum += pq.peek_priority();
+  return Result("change_priority", operations, time);
+}
+
+/*
+ * Bulk inserts "n" elements into an empty queue, timed per element.
+ */
+template <typename T>
+Result benchInsertAll(int n) {
+  std::vector<std::pair<int, T> > pairs;
+  pairs.reserve(n);
+  for (int i = 0; i < n; i++) {
+    pairs.push_back(std::make_pair(std::rand() % n, makePayload<T>(i)));
+  }
+
+  PriorityQueue<T> pq;
+  Clock::time_point start = Clock::now();
+  pq.insert_all(std::move(pairs));
+  double time = perOperation(start, n);
+  checksum += pq.size();
+  return Result("insert_all", n, time);
+}
+
+/*
+ * Looks up elements by value. Each lookup is a full scan, so the number of
+ * lookups shrinks as N grows.
+ */
+template <typename T>
+Result benchContains(int n) {
+  PriorityQueue<T> pq;
+  fill(pq, n, nullptr);
+
+  int operations = 10000000 / n > 10 ? 10000000 / n : 10;
+  std::vector<T> wanted;
+  for (int i = 0; i < operations; i++) {
+    wanted.push_back(makePayload<T>(std::rand() % n));
+  }
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < operations; i++) {
+    checksum += pq.contains(wanted[i]);
+  }
+  return Result("contains", operations, perOperation(start, operations));
+}
+
+/*
+ * Runs a scheduler-like mix on a queue kept near "n" elements: half the
+ * operations are inserts, a third are pops and the rest change the
+ * priority of a random element.
+ */
+template <typename T>
+Result benchMixed(int n) {
+  PriorityQueue<T> pq;
+  std::vector<typename PriorityQueue<T>::Handle> handles;
+  fill(pq, n, &handles);
+
+  int operations = n < 1000000 ? n : 1000000;
+  std::vector<T> payloads;
+  for (int i = 0; i < operations; i++) {
+    payloads.push_back(makePayload<T>(i));
+  }
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < operations; i++) {
+    int choice = i % 6;
+    if (choice < 3) {
+      handles[std::rand() % n] = pq.insert(std::rand() % n, std::move(payloads[i]));
+    }
+    else if (choice < 5) {
+      T element = pq.pop();
+      checksum += sizeof(element);
+    }
+    else {
+      pq.change_priority(handles[std::rand() % n], std::rand() % n);
+    }
+  }
+  double time = perOperation(start, operations);
+  checksum += pq.size();
+  return Result("mixed", operations, time);
+}
+
+/*
+ * Runs every benchmark for payload type "T" at each N, adding the results
+ * to "results".
+ */
+template <typename T>
+void runAll(int maxN, std::vector<Result>& results) {
+  Result (*benchmarks[])(int) = {
+    benchInsert<T>, benchRemoveFront<T>, benchChangePriority<T>,
+    benchInsertAll<T>, benchContains<T>, benchMixed<T>
+  };
+
+  for (int b = 0; b < 6; b++) {
+    for (int n = 1000; n <= maxN; n *= 10) {
+      std::srand(42);
+      Result result = benchmarks[b](n);
+      result.name += std::string("/") + payloadName<T>() + "/" + std::to_string(n);
+      results.push_back(result);
+      std::cerr << "." << std::flush;
+    }
+  }
+}
+
+/*
+ * Prints "results" as a table.
+ */
+void printTable(const std::vector<Result>& results) {
+  std::cout << "benchmark\titerations\tns per op" << std::endl;
+  for (std::size_t i = 0; i < results.size(); i++) {
+    std::cout << results[i].name << "\t" << results[i].iterations << "\t" << results[i].nanoseconds << std::endl;
+  }
+}
+
+/*
+ * Prints "results" in Google Benchmark's JSON layout.
+ */
+void printJson(const std::vector<Result>& results) {
+  std::cout << "{\n  \"context\": {\n    \"library\": \"PriorityQueue\",\n    \"executable\": \"suite_benchmark\"\n  },\n";
+  std::cout << "  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    std::cout << "    {\n"
+              << "      \"name\": \"" << results[i].name << "\",\n"
+              << "      \"run_type\": \"iteration\",\n"
+              << "      \"iterations\": " << results[i].iterations << ",\n"
+              << "      \"real_time\": " << results[i].nanoseconds << ",\n"
+              << "      \"cpu_time\": " << results[i].nanoseconds << ",\n"
+              << "      \"time_unit\": \"ns\"\n"
+              << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  std::cout << "  ]\n}" << std::endl;
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  int maxN = 10000000;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      json = true;
+    }
+    else if (std::strcmp(argv[i], "--max-n") == 0 && i + 1 < argc) {
+      maxN = std::atoi(argv[++i]);
+    }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--json] [--max-n N]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  runAll<int>(maxN, results);
+  runAll<std::string>(maxN, results);
+  std::cerr << std::endl;
+
+  if (json) {
+    printJson(results);
+  }
+  else {
+    printTable(results);
+  }
+
+  if (checksum == -1) {
+    std::cout << checksum;
+  }
+  return 0;
+}